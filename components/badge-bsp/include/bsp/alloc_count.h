@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+
+
+// Count the heap allocations of a BSP task that handles input; see `bsp_alloc_count_input`.
+void bsp_alloc_count_add_input_task(TaskHandle_t task);
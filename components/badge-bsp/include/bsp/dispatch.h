@@ -0,0 +1,107 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "bsp_devtree.h"
+
+
+
+// With `CONFIG_BSP_STATIC_DISPATCH`, endpoint types for which the enabled drivers all share one implementation
+// call it directly instead of through the driver tables. Driver tables only contain drivers of this build,
+// so any endpoint with a driver installed uses that implementation.
+
+#if CONFIG_BSP_STATIC_DISPATCH && !CONFIG_BSP_SUPPORT_WHY2025_COPROC
+// The GPIO input driver is the only input driver.
+#define BSP_STATIC_INPUT_GPIO 1
+#include "bsp/input_gpio.h"
+#endif
+
+#if CONFIG_BSP_STATIC_DISPATCH && CONFIG_BSP_SUPPORT_WHY2025_COPROC
+// The WHY2025 CH32 coprocessor LED driver is the only LED driver.
+#define BSP_STATIC_LED_WHY2025CH32 1
+#include "bsp/why2025_coproc.h"
+#endif
+
+#if CONFIG_BSP_STATIC_DISPATCH && CONFIG_BSP_SUPPORT_MIPI_DSI
+// All display drivers are MIPI DSI drivers, which share their update functions.
+#define BSP_STATIC_DISP_DSI 1
+#include "bsp/disp_mipi_dsi.h"
+#endif
+
+
+
+// Get current input value by raw input number.
+static inline bool dispatch_input_get_raw(
+    bsp_input_driver_t const *driver, bsp_device_t *dev, uint8_t endpoint, uint16_t raw_input
+) {
+#if BSP_STATIC_INPUT_GPIO
+    (void)driver;
+    return bsp_input_gpio_get_raw(dev, endpoint, raw_input);
+#else
+    return driver->get_raw(dev, endpoint, raw_input);
+#endif
+}
+
+// Set the color of a single LED from raw data.
+static inline void dispatch_led_set_raw(
+    bsp_led_driver_t const *driver, bsp_device_t *dev, uint8_t endpoint, uint16_t led, uint64_t data
+) {
+#if BSP_STATIC_LED_WHY2025CH32
+    (void)driver;
+    bsp_led_why2025ch32_set_raw(dev, endpoint, led, data);
+#else
+    driver->set_raw(dev, endpoint, led, data);
+#endif
+}
+
+// Get the color of a single LED as raw data.
+static inline uint64_t
+    dispatch_led_get_raw(bsp_led_driver_t const *driver, bsp_device_t *dev, uint8_t endpoint, uint16_t led) {
+#if BSP_STATIC_LED_WHY2025CH32
+    (void)driver;
+    return bsp_led_why2025ch32_get_raw(dev, endpoint, led);
+#else
+    return driver->get_raw(dev, endpoint, led);
+#endif
+}
+
+// Send new color data to an LED array.
+static inline void dispatch_led_update(bsp_led_driver_t const *driver, bsp_device_t *dev, uint8_t endpoint) {
+#if BSP_STATIC_LED_WHY2025CH32
+    (void)driver;
+    bsp_led_why2025ch32_update(dev, endpoint);
+#else
+    driver->update(dev, endpoint);
+#endif
+}
+
+// Send new image data to a device's display.
+static inline void
+    dispatch_disp_update(bsp_disp_driver_t const *driver, bsp_device_t *dev, uint8_t endpoint, void const *framebuffer) {
+#if BSP_STATIC_DISP_DSI
+    (void)driver;
+    bsp_disp_dsi_update(dev, endpoint, framebuffer);
+#else
+    driver->update(dev, endpoint, framebuffer);
+#endif
+}
+
+// Send new image data to part of a device's display.
+static inline void dispatch_disp_update_part(
+    bsp_disp_driver_t const *driver,
+    bsp_device_t            *dev,
+    uint8_t                  endpoint,
+    void const              *framebuffer,
+    uint16_t                 x,
+    uint16_t                 y,
+    uint16_t                 w,
+    uint16_t                 h
+) {
+#if BSP_STATIC_DISP_DSI
+    (void)driver;
+    bsp_disp_dsi_update_part(dev, endpoint, framebuffer, x, y, w, h);
+#else
+    driver->update_part(dev, endpoint, framebuffer, x, y, w, h);
+#endif
+}
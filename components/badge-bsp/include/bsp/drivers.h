@@ -0,0 +1,19 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "bsp_devtree.h"
+
+
+
+// GPIO input driver.
+extern bsp_input_driver_t const bsp_drv_input_gpio;
+// WHY2025 CH32 coprocessor input driver.
+extern bsp_input_driver_t const bsp_drv_input_why2025ch32;
+// WHY2025 CH32 coprocessor LED driver.
+extern bsp_led_driver_t const   bsp_drv_led_why2025ch32;
+// ST7701 display driver.
+extern bsp_disp_driver_t const  bsp_drv_disp_st7701;
+// EK79007 display driver.
+extern bsp_disp_driver_t const  bsp_drv_disp_ek79007;
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Maximum number of background initialisation steps.
+#define BSP_INIT_STEPS_MAX 23
+
+// Background initialisation step.
+typedef struct {
+    // Name used in logs and `BSP_EVENT_INIT` events.
+    char const *name;
+    // Function that performs this step; returns whether it succeeded.
+    bool (*func)();
+    // Bitmask of the indices of the steps that must finish before this one starts.
+    uint32_t    deps;
+    // Core to run this step on, or -1 for any core.
+    int         core;
+} bsp_init_step_t;
+
+
+
+// Start running background initialisation steps in dependency order; does not wait for them to finish.
+// Each step gets its own task; steps whose dependencies have finished run in parallel.
+// Steps still running after `CONFIG_BSP_INIT_BUDGET_MS` are reported as failed.
+bool bsp_init_graph_run(bsp_init_step_t const *steps, size_t steps_len);
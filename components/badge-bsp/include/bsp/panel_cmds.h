@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <esp_err.h>
+#include <esp_lcd_types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Panel command in an init sequence; same layout as the vendor drivers' `*_lcd_init_cmd_t`.
+typedef struct {
+    // LCD command.
+    int          cmd;
+    // Command parameters.
+    void const  *data;
+    // Size of `data` in bytes.
+    size_t       data_bytes;
+    // Minimum time between this command and the next in milliseconds.
+    unsigned int delay_ms;
+} bsp_panel_cmd_t;
+
+// Panel command recorded by a panel IO recorder.
+typedef struct {
+    // LCD command.
+    int     cmd;
+    // Number of parameter bytes sent.
+    size_t  data_bytes;
+    // First parameter bytes sent.
+    uint8_t data[16];
+    // Time at which the command was sent in microseconds, as measured by `esp_timer_get_time` on the badge.
+    int64_t timestamp;
+} bsp_panel_record_t;
+
+
+
+// Send a panel command list.
+// Delays are waited for only right before the next command or at the end, and only for as long as is still needed.
+esp_err_t bsp_panel_send_cmds(esp_lcd_panel_io_handle_t io, bsp_panel_cmd_t const *cmds, size_t cmds_len);
+// Create a panel IO that records sent commands instead of sending them; for checking init sequences off-device.
+// Commands beyond `cap` are counted in `*len_out` but not stored.
+esp_err_t bsp_panel_io_new_recorder(
+    bsp_panel_record_t *buf, size_t cap, size_t *len_out, esp_lcd_panel_io_handle_t *ret_io
+);
+// Check that a command list is sent in order, with its parameters and at least its delays, using a recorder.
+// Takes as long as sending the list to a panel would.
+esp_err_t bsp_panel_check_cmds(bsp_panel_cmd_t const *cmds, size_t cmds_len);
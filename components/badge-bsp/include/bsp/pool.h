@@ -0,0 +1,48 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+
+
+
+// Fixed-capacity pool of equally sized blocks.
+typedef struct {
+    // Name used in logs.
+    char const  *name;
+    // Block storage.
+    void        *blocks;
+    // Size of one block.
+    size_t       block_size;
+    // Number of blocks.
+    size_t       capacity;
+    // Bitmap of blocks in use.
+    uint32_t    *used;
+    // Protects `used`.
+    portMUX_TYPE lock;
+} bsp_pool_t;
+
+// Define a static pool named `name` of `capacity` blocks of `type`.
+#define BSP_POOL_DEFINE(name, type, capacity)                                                                          \
+    static type       name##_blocks[capacity];                                                                         \
+    static uint32_t   name##_used[((capacity) + 31) / 32];                                                             \
+    static bsp_pool_t name = {                                                                                         \
+        #name,                                                                                                         \
+        name##_blocks,                                                                                                 \
+        sizeof(type),                                                                                                  \
+        (capacity),                                                                                                    \
+        name##_used,                                                                                                   \
+        portMUX_INITIALIZER_UNLOCKED,                                                                                  \
+    }
+
+
+
+// Take a zeroed block from a pool; returns NULL if the pool is exhausted.
+void *bsp_pool_alloc(bsp_pool_t *pool);
+// Return a block to its pool; does nothing if `block` is NULL.
+void  bsp_pool_free(bsp_pool_t *pool, void *block);
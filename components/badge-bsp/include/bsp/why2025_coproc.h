@@ -12,6 +12,51 @@
 
 
 
+// Internal I²C bus transaction classes, in order of priority.
+typedef enum {
+    // Input reads: the keyboard matrix and other inputs when the CH32 interrupts, and `bsp_input_get_raw`.
+    // While the CH32 interrupt line says input changes weren't read yet, these reads are queued before anything else.
+    BSP_I2C_CLASS_INPUT,
+    // Control writes.
+    BSP_I2C_CLASS_CONTROL,
+    // Bulk transfers and other reads.
+    BSP_I2C_CLASS_BULK,
+    // Number of transaction classes.
+    BSP_I2C_CLASS_COUNT,
+} bsp_i2c_class_t;
+
+// Internal I²C bus statistics of one transaction class.
+typedef struct {
+    // Number of transactions completed.
+    uint32_t completed;
+    // Number of writes merged into a later write to the same register.
+    uint32_t coalesced;
+    // Number of transactions currently queued.
+    uint32_t queued;
+    // Maximum number of transactions queued at once.
+    uint32_t max_queued;
+    // Sum of the times from request to completion in microseconds.
+    int64_t  total_latency_us;
+    // Maximum time from request to completion in microseconds.
+    int64_t  max_latency_us;
+} bsp_i2c_stats_t;
+
+
+
+// ESP32-C6 bring-up states.
+typedef enum {
+    // Not initialized or switched off.
+    BSP_C6_OFF,
+    // Bring-up in progress.
+    BSP_C6_STARTING,
+    // Found on the SDIO bus and ready to use.
+    BSP_C6_READY,
+    // Not found on the SDIO bus; retried by `bsp_c6_init`.
+    BSP_C6_FAILED,
+} bsp_c6_state_t;
+
+
+
 /* ==== platform-specific functions ==== */
 
 // Enable the WHY2025 badge internal I²C bus.
@@ -21,6 +66,8 @@ extern bool why2025_enable_i2cint;
 esp_err_t bsp_ch32_version(uint16_t *ver);
 // Initialise the co-processor drivers.
 esp_err_t bsp_why2025_coproc_init();
+// Get the internal I²C bus statistics for a transaction class.
+void      bsp_why2025_i2c_stats(bsp_i2c_class_t cls, bsp_i2c_stats_t *stats_out);
 
 // Set the display backlight value.
 esp_err_t ch32_set_display_backlight(uint8_t value);
@@ -33,9 +80,13 @@ esp_err_t ch32_get_keyboard_backlight(uint8_t *value);
 // Enable/disable the audio amplifier.
 esp_err_t bsp_amplifier_control(bool enable);
 // Enable/disable the ESP32-C6 via RESET and BOOT pins.
-esp_err_t bsp_c6_control(bool enable, bool boot);
-// Initialize the ESP32-C6 after it was (re-)enabled.
-esp_err_t bsp_c6_init();
+// Disabling the C6 stops its bring-up; enabling it again after `bsp_c6_init` re-initializes it.
+esp_err_t      bsp_c6_control(bool enable, bool boot);
+// Start initializing the ESP32-C6 in the background after it was (re-)enabled.
+// Sends a `BSP_EVENT_RADIO` event once it is ready or has failed.
+esp_err_t      bsp_c6_init();
+// Get the ESP32-C6 bring-up state.
+bsp_c6_state_t bsp_c6_get_state();
 
 
 
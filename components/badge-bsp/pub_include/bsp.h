@@ -5,6 +5,8 @@
 
 #include "bsp_event.h"
 #include "bsp_input.h"
+#include "bsp_keymap.h"
+#include "bsp_latency.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -16,7 +18,13 @@
 // Optional; called implicitly when `bsp_init()` is called.
 void bsp_preinit();
 // Initialise the BSP, should be called early on in `app_main`.
+// Displays and inputs are ready when this returns; storage and radio continue initialising in the background.
 void bsp_init();
+// Wait for background initialisation such as storage and radio to finish.
+// Returns true if it all finished successfully within both `wait_ms` and the time budget.
+bool bsp_init_wait(uint64_t wait_ms);
+// Whether background initialisation has finished or run out of time, successfully or not; doesn't wait.
+bool bsp_init_done();
 
 // Get current input value.
 bool bsp_input_get(uint32_t dev_id, uint8_t endpoint, bsp_input_t input);
@@ -25,6 +33,13 @@ bool bsp_input_get_raw(uint32_t dev_id, uint8_t endpoint, uint16_t raw_input);
 // Set a device's input backlight.
 void bsp_input_backlight(uint32_t dev_id, uint8_t endpoint, uint16_t pwm);
 
+// Set the keyboard layout used to translate a device's input.
+bool                bsp_input_set_keymap(uint32_t dev_id, uint8_t endpoint, bsp_keymap_t const *keymap);
+// Get the keyboard layout used to translate a device's input.
+bsp_keymap_t const *bsp_input_get_keymap(uint32_t dev_id, uint8_t endpoint);
+// Set a device's key repeat delay and period in milliseconds; a period of 0 disables key repeat.
+bool                bsp_input_set_repeat(uint32_t dev_id, uint8_t endpoint, uint16_t delay_ms, uint16_t period_ms);
+
 // Set the color of a single LED from 16-bit greyscale.
 void     bsp_led_set_grey16(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint16_t value);
 // Get the color of a single LED as 16-bit greyscale.
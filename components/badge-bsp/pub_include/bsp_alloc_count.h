@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// Start counting heap allocations made by the calling task; needs `CONFIG_BSP_ALLOC_COUNT`.
+// Allocations by other tasks, such as background jobs and drivers, are not counted.
+void     bsp_alloc_count_start();
+// Stop counting heap allocations and get how many were made since `bsp_alloc_count_start`.
+// Always 0 without `CONFIG_BSP_ALLOC_COUNT`.
+uint32_t bsp_alloc_count_stop();
+// Get the number of heap allocations made by the BSP's input tasks since the last call; needs `CONFIG_BSP_ALLOC_COUNT`.
+// These are the tasks that handle raw input, run event callbacks and key repeat, and read input over I2C;
+// key repeat runs in the FreeRTOS timer task, so allocations by other software timers are counted too.
+uint32_t bsp_alloc_count_input();
@@ -9,11 +9,52 @@
 
 #define bsp_dev_get_tree_raw(dev) ((bsp_devtree_t const *)(dev->tree->data))
 
+// Maximum number of button events translated at once by `bsp_raw_button_batch`.
+#define BSP_RAW_BUTTON_BATCH_MAX 16
+
+// Raw button event for use with `bsp_raw_button_batch`.
+typedef struct {
+    // Raw input value or keyboard scan code.
+    int     input;
+    // Button was pressed instead of released.
+    bool    pressed;
+    // Time at which the button changed as measured by `esp_timer_get_time`, or 0 for now.
+    int64_t timestamp;
+} bsp_raw_button_t;
+
+// Debouncing state of a raw button, for use with `bsp_raw_button_deferred_from_isr`.
+typedef struct bsp_raw_debounce bsp_raw_debounce_t;
+struct bsp_raw_debounce {
+    // Debounce time in microseconds, or 0 to disable debouncing.
+    int64_t             time_us;
+    // Time until which changes are not reported.
+    int64_t             lockout_until;
+    // Next input that needs to be checked once its lockout ends.
+    bsp_raw_debounce_t *next;
+    // Device ID of the last change.
+    uint32_t            dev_id;
+    // Raw input value of the last change.
+    int                 input;
+    // Device endpoint of the last change.
+    uint8_t             endpoint;
+    // Level last reported to the BSP.
+    bool                reported;
+    // Level of the last change.
+    bool                last;
+    // Time of the last change.
+    int64_t             last_timestamp;
+    // Whether this input needs to be checked once its lockout ends.
+    bool                check_pending;
+};
+
 
 
 // Register a new device and assign an ID to it.
 // If `is_rom` is true, the BSP will not attempt to free the tree.
 uint32_t bsp_dev_register(bsp_devtree_t const *tree, bool is_rom);
+// Register a device tree compiled by `tools/devtree_gen.py` and assign an ID to it.
+// The init order and drivers are taken from the compiled tree; the tree itself is never freed.
+uint32_t bsp_dev_register_compiled(bsp_devtree_compiled_t const *compiled);
 // Unregister an existing device.
 bool     bsp_dev_unregister(uint32_t dev_id);
 
@@ -22,10 +63,17 @@ void bsp_raw_button_pressed(uint32_t dev_id, uint8_t endpoint, int input);
 // Call to notify the BSP of a button release.
 void bsp_raw_button_released(uint32_t dev_id, uint8_t endpoint, int input);
 
+// Notify the BSP of multiple button presses and/or releases at once.
+// More efficient than calling `bsp_raw_button_pressed` / `bsp_raw_button_released` for every button.
+void bsp_raw_button_batch(uint32_t dev_id, uint8_t endpoint, bsp_raw_button_t const *buttons, size_t buttons_len);
+
 // Call to notify the BSP of a button press.
 void bsp_raw_button_pressed_from_isr(uint32_t dev_id, uint8_t endpoint, int input);
 // Call to notify the BSP of a button release.
 void bsp_raw_button_released_from_isr(uint32_t dev_id, uint8_t endpoint, int input);
+// Record a button press or release from an interrupt handler.
+// Translation and debouncing happen later in a task, so this takes constant time.
+void bsp_raw_button_deferred_from_isr(uint32_t dev_id, uint8_t endpoint, int input, bool pressed, bsp_raw_debounce_t *debounce);
 
 // Obtain a copy of a device's devtree that can be cleaned up with `free()`.
 bsp_devtree_t *bsp_dev_clone_devtree(uint32_t dev_id);
@@ -15,6 +15,9 @@
 
 
 
+// Value of `repeat_period` in an input device tree that disables key repeat.
+#define BSP_REPEAT_DISABLED UINT16_MAX
+
 // Display orientation settings.
 typedef enum {
     // No change in orientation.
@@ -121,8 +124,14 @@ typedef struct bsp_audio_driver  bsp_audio_driver_t;
 
 // Device address.
 typedef struct bsp_addr   bsp_addr_t;
+// Runtime state of an input endpoint.
+typedef struct bsp_input_state bsp_input_state_t;
+// Initialization order and timing of an endpoint.
+typedef struct bsp_ep_init     bsp_ep_init_t;
 // Registered device.
-typedef struct bsp_device bsp_device_t;
+typedef struct bsp_device      bsp_device_t;
+// Device tree compiled at build time.
+typedef struct bsp_devtree_compiled bsp_devtree_compiled_t;
 
 // Device init / deinit functions.
 typedef bool (*bsp_dev_initfun_t)(bsp_device_t *dev, uint8_t endpoint);
@@ -170,11 +179,13 @@ struct bsp_devtree_common {
 // GPIO pin mappings.
 struct bsp_pinmap {
     // Active-low logic.
-    bool           activelow;
+    bool            activelow;
     // Number of pins.
-    uint8_t        pins_len;
+    uint8_t         pins_len;
     // GPIO pins assigned to raw inputs/outputs.
-    uint8_t const *pins;
+    uint8_t const  *pins;
+    // Debounce time in milliseconds per pin, or NULL to disable debouncing.
+    uint16_t const *debounce_ms;
 };
 
 // Input device tree data.
@@ -191,6 +202,10 @@ struct bsp_input_devtree {
     uint8_t              backlight_endpoint;
     // Backlight index.
     uint16_t             backlight_index;
+    // Key repeat delay in milliseconds, or 0 for the default.
+    uint16_t             repeat_delay;
+    // Key repeat period in milliseconds, 0 for the default, or `BSP_REPEAT_DISABLED`.
+    uint16_t             repeat_period;
 };
 
 // Display / LED pixel format.
@@ -325,6 +340,34 @@ struct bsp_audio_driver {
     bsp_driver_common_t common;
 };
 
+// Runtime state of an input endpoint.
+struct bsp_input_state {
+    // Active keyboard layout.
+    bsp_keymap_t const *keymap;
+    // Key repeat delay in milliseconds.
+    uint16_t            repeat_delay;
+    // Key repeat period in milliseconds, or 0 if key repeat is disabled.
+    uint16_t            repeat_period;
+};
+
+// Initialization order and timing of an endpoint.
+struct bsp_ep_init {
+    // Endpoint type.
+    bsp_ep_type_t type;
+    // Endpoint index.
+    uint8_t       endpoint;
+    // Initialization priority.
+    int           init_prio;
+    // Whether the last init function succeeded.
+    bool          init_ok;
+    // Whether the last deinit function succeeded.
+    bool          deinit_ok;
+    // Time the init function took in microseconds.
+    int64_t       init_us;
+    // Time the deinit function took in microseconds.
+    int64_t       deinit_us;
+};
+
 // Registered device.
 struct bsp_device {
     // BSP device ID.
@@ -359,9 +402,34 @@ struct bsp_device {
         // Auxiliary driver data per endpoint type.
         void **ep_aux[BSP_EP_TYPE_COUNT];
     };
+    // Runtime state of input endpoints.
+    bsp_input_state_t *input_state;
+    // Endpoints in initialization order; deinitialization happens in reverse.
+    bsp_ep_init_t     *init_order;
+    // Number of endpoints in `init_order`.
+    uint16_t           init_order_len;
+};
+
+// Device tree compiled at build time by `tools/devtree_gen.py`.
+struct bsp_devtree_compiled {
+    // Device tree.
+    bsp_devtree_t const              *tree;
+    // Drivers per endpoint type, already bound to the endpoints.
+    bsp_driver_common_t const *const *drivers[BSP_EP_TYPE_COUNT];
+    // Endpoints in initialization order.
+    bsp_ep_init_t const              *init_order;
+    // Number of endpoints in `init_order`.
+    uint16_t                          init_order_len;
 };
 
 
 
 // Create a copy of the device tree that can be cleaned up with `free()`.
+// The copy is a single allocation; keymaps are shared with the original.
 bsp_devtree_t *bsp_devtree_clone(bsp_devtree_t const *devtree);
+// Serialize a device tree into a blob that can be cleaned up with `free()`; keymaps are stored by name.
+// Blobs can only be read by builds with the same device tree struct layout.
+void          *bsp_devtree_serialize(bsp_devtree_t const *devtree, size_t *size_out);
+// Deserialize a device tree blob into a single allocation that can be cleaned up with `free()`.
+// The result can be registered with `bsp_dev_register(tree, false)`.
+bsp_devtree_t *bsp_devtree_deserialize(void const *blob, size_t blob_size);
@@ -13,6 +13,8 @@
 
 // Maximum possible wait time for a BSP event.
 #define BSP_EVENT_MAX_WAIT INT64_MAX
+// Bit for an event type in the mask passed to `bsp_event_set_wait_filter`.
+#define BSP_EVENT_MASK(type) (1u << (type))
 
 
 // Possible types of BSP event.
@@ -21,16 +23,112 @@ typedef enum {
     BSP_EVENT_ANY = -1,
     // Input changed event.
     BSP_EVENT_INPUT,
+    // SD card inserted or removed.
+    BSP_EVENT_SDCARD,
+    // Headphone jack inserted or removed.
+    BSP_EVENT_AUDIO_JACK,
+    // Power or battery state changed.
+    BSP_EVENT_POWER,
+    // Background initialisation step finished.
+    BSP_EVENT_INIT,
+    // Radio became ready, failed to start or was switched off.
+    BSP_EVENT_RADIO,
+    // Number of event types.
+    BSP_EVENT_TYPE_COUNT,
 } bsp_event_type_t;
 
+// SD card or headphone jack event.
+typedef struct {
+    // Card or plug is now inserted.
+    bool    inserted;
+    // Time at which the change was detected in microseconds, as measured by `esp_timer_get_time`.
+    int64_t timestamp;
+} bsp_detect_event_t;
+
+// Power or battery event.
+typedef struct {
+    // External power is connected.
+    bool    external_power;
+    // Battery is charging.
+    bool    charging;
+    // Battery charge in percent, or -1 if unknown.
+    int8_t  battery_percent;
+    // Time at which the change was detected in microseconds, as measured by `esp_timer_get_time`.
+    int64_t timestamp;
+} bsp_power_event_t;
+
+// Background initialisation event.
+typedef struct {
+    // Name of the step that finished, or NULL if all background initialisation finished.
+    char const *name;
+    // Whether the step succeeded; for the final event, whether all steps succeeded within the time budget.
+    bool        success;
+    // Whether this is the final event, sent when all steps finished or the time budget ran out.
+    bool        done;
+    // Time at which the step finished in microseconds, as measured by `esp_timer_get_time`.
+    int64_t     timestamp;
+} bsp_init_event_t;
+
+// Radio event.
+typedef struct {
+    // Whether the radio is now ready to use.
+    bool    ready;
+    // Error code if the radio failed to start, or 0 if it is ready or was switched off.
+    int32_t error;
+    // Time at which the change happened in microseconds, as measured by `esp_timer_get_time`.
+    int64_t timestamp;
+} bsp_radio_event_t;
+
 // Events sent by the BSP to the application.
 typedef struct {
     // Event type.
-    bsp_event_type_t  type;
-    // Input event data.
-    bsp_input_event_t input;
+    bsp_event_type_t type;
+    union {
+        // Input event data, for `BSP_EVENT_INPUT`.
+        bsp_input_event_t  input;
+        // SD card event data, for `BSP_EVENT_SDCARD`.
+        bsp_detect_event_t sdcard;
+        // Headphone jack event data, for `BSP_EVENT_AUDIO_JACK`.
+        bsp_detect_event_t audio_jack;
+        // Power event data, for `BSP_EVENT_POWER`.
+        bsp_power_event_t  power;
+        // Initialisation event data, for `BSP_EVENT_INIT`.
+        bsp_init_event_t   init;
+        // Radio event data, for `BSP_EVENT_RADIO`.
+        bsp_radio_event_t  radio;
+    };
 } bsp_event_t;
 
+// What to do when an event is queued while the event queue is full.
+// Key releases are never dropped to make space: a key press is only queued if its release will fit too,
+// and other events can't use that space; at most half the queue depth of keys can be held down at once.
+// When a key press is dropped, its hold and release events are left out too.
+typedef enum {
+    // Drop the new event.
+    BSP_EVENT_OVERFLOW_DROP_NEWEST,
+    // Drop the oldest event not yet read by the application, unless it is a key release; drop the new event if so.
+    BSP_EVENT_OVERFLOW_DROP_OLDEST,
+    // Leave out key repeats and press/release pairs; drop the oldest event if that isn't possible.
+    BSP_EVENT_OVERFLOW_COALESCE,
+    // Wait a limited time for space; drop the oldest event if there still is none.
+    // Events queued from interrupt handlers never wait.
+    BSP_EVENT_OVERFLOW_BLOCK,
+} bsp_event_overflow_t;
+
+// Event queue statistics.
+typedef struct {
+    // Number of events added to the queue.
+    uint32_t enqueued;
+    // Number of events lost because the queue was full.
+    uint32_t dropped;
+    // Number of events left out because they were redundant.
+    uint32_t coalesced;
+    // Number of times a producer had to wait for space.
+    uint32_t blocked;
+    // Number of key releases lost despite the space kept for them; keys may appear stuck if this is not 0.
+    uint32_t lost_releases;
+} bsp_event_stats_t;
+
 // Event callback function for use with `bsp_event_add_callback`.
 typedef void (*bsp_event_cb_t)(bsp_event_t const *event, void *cookie);
 // Handle for event callbacks registered with `bsp_event_add_callback`.
@@ -40,12 +138,37 @@ typedef void *bsp_cb_handle_t;
 
 // Add an event to the BSP's event queue.
 bool            bsp_event_queue(bsp_event_t *event);
+// Add multiple events to the BSP's event queue.
+// Returns how many events were added, stopping at the first that does not fit.
+size_t          bsp_event_queue_many(bsp_event_t *events, size_t events_len);
 // Add an event to the BSP's event queue from interrupt handler.
 bool            bsp_event_queue_from_isr(bsp_event_t *event);
+// Add an event to the BSP's event queue, waiting for a limited time for space regardless of the overflow policy.
+// Never drops other events; returns false if there still is no space after `wait_ms`.
+bool            bsp_event_queue_wait(bsp_event_t *event, uint64_t wait_ms);
 // Wait for a limited time for a BSP event to happen.
 // If time is 0, only returns a valid event when there is one in the queue.
+// Only returns input events unless other types were selected with `bsp_event_set_wait_filter`.
 bool            bsp_event_wait(bsp_event_t *event_out, uint64_t wait_ms);
+// Wait for a limited time for at least one BSP event to happen, then take up to `max` pending events at once.
+// Returns the number of events read; if time is 0, only returns events already in the queue.
+size_t          bsp_event_wait_many(bsp_event_t *events_out, size_t max, uint64_t wait_ms);
+// Select which event types `bsp_event_wait` and `bsp_event_wait_many` return, as a mask of `BSP_EVENT_MASK` bits.
+// Events of other types are still passed to callbacks; only input events are returned by default.
+void            bsp_event_set_wait_filter(uint32_t type_mask);
+// Set what to do when an event is queued while the event queue is full.
+void            bsp_event_set_overflow(bsp_event_overflow_t policy);
+// Get the event queue statistics.
+void            bsp_event_get_stats(bsp_event_stats_t *stats_out);
+// Reset the event queue statistics to 0.
+void            bsp_event_reset_stats();
 // Add a new callback to be run immediately when an event happens.
 bsp_cb_handle_t bsp_event_add_callback(bsp_event_type_t filter, bsp_event_cb_t callback, void *cookie);
+// Add a new callback to be run immediately when an event happens.
+// Callbacks with a higher priority run first; callbacks with equal priority run in the order they were added.
+bsp_cb_handle_t bsp_event_add_callback_prio(bsp_event_type_t filter, bsp_event_cb_t callback, void *cookie, int prio);
 // Remove an event callback so it will no longer be called when an event happens.
-void            bsp_event_remove_callback(bsp_cb_handle_t handle);
+// Once this returns, the callback is not running and its cookie may be freed; when called from a callback,
+// this can't wait, so only the callback calling this may still be running.
+// Returns false if the callback was not registered.
+bool            bsp_event_remove_callback(bsp_cb_handle_t handle);
@@ -0,0 +1,30 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "bsp_event.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Replay speed that sends events as fast as the event queue accepts them.
+#define BSP_REPLAY_SPEED_MAX 0
+
+
+
+// Start recording all BSP events with their timing to a file.
+bool   bsp_event_record_start(char const *path);
+// Stop recording BSP events and close the file.
+// Returns false and deletes the file if any event could not be recorded, so incomplete recordings are never replayed.
+// While the file can't keep up, the event queue is held up for up to `CONFIG_BSP_EVENT_RECORD_WAIT_MS` per event.
+bool   bsp_event_record_stop();
+// Replay input events recorded with `bsp_event_record_start` through the event queue; blocks until done.
+// Other event types describe hardware state and are left out, so replays don't make apps act on a phantom SD card.
+// `speed_percent` of 100 keeps the original timing, 200 replays twice as fast; `BSP_REPLAY_SPEED_MAX` doesn't wait.
+// Events get their timestamp replaced by the time they are replayed.
+// Replayed events wait for space in the queue regardless of the overflow policy, so none are lost.
+bool   bsp_event_replay(char const *path, uint32_t speed_percent);
@@ -275,6 +275,8 @@ typedef struct {
     int                    raw_input;
     // Active modifier keys, if any.
     uint32_t               modkeys;
+    // Time at which the input physically happened in microseconds, as measured by `esp_timer_get_time`.
+    int64_t                timestamp;
 } bsp_input_event_t;
 
 /* ==== SDL2-compatible modifier keys ==== */
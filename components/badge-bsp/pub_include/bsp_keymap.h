@@ -3,17 +3,53 @@
 
 #pragma once
 
+#include "bsp_input.h"
+
+#include <stddef.h>
 #include <stdint.h>
 
 
 
+// Number of modifier classes in precompiled keymap tables.
+#define BSP_KEYMAP_CLASSES     8
+// Modifier class bit: any shift key pressed.
+#define BSP_KEYMAP_CLASS_SHIFT 1
+// Modifier class bit: caps lock active.
+#define BSP_KEYMAP_CLASS_CAPS  2
+// Modifier class bit: function key pressed.
+#define BSP_KEYMAP_CLASS_FN    4
+
 // Keyboard scancode to input map.
 typedef struct {
     // Maximum scan code.
     uint16_t        max_scancode;
     // Scan code to BSP input table.
     uint16_t const *keymap;
+    // Layout name, if any.
+    char const     *name;
+    // Precompiled text input indexed by `[class * max_scancode + scancode]`.
+    // If NULL, text, navigation and modifier keys are computed at runtime instead.
+    char const     *text;
+    // Precompiled navigation input indexed by `[shift * max_scancode + scancode]`.
+    uint16_t const *nav;
+    // Precompiled modifier key bit index per scan code, or -1 if not a modifier key.
+    int8_t const   *modkey;
 } bsp_keymap_t;
 
 // WHY2025 badge built-in keyboard.
-extern bsp_keymap_t const bsp_keymap_why2025;
+extern bsp_keymap_t const        bsp_keymap_why2025;
+// Precompiled keyboard layouts.
+extern bsp_keymap_t const *const bsp_keymaps[];
+// Number of precompiled keyboard layouts.
+extern size_t const              bsp_keymaps_len;
+
+
+
+// Get the modifier class used to index precompiled keymap tables.
+static inline int bsp_keymap_class(uint32_t modkeys) {
+    return (!!(modkeys & BSP_MODKEY_SHIFT) * BSP_KEYMAP_CLASS_SHIFT) |
+           (!!(modkeys & BSP_MODKEY_CAPS_LK) * BSP_KEYMAP_CLASS_CAPS) | (!!(modkeys & BSP_MODKEY_FN) * BSP_KEYMAP_CLASS_FN);
+}
+
+// Find a precompiled keyboard layout by name.
+bsp_keymap_t const *bsp_keymap_find(char const *name);
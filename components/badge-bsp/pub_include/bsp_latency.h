@@ -0,0 +1,50 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+
+
+// Stages of input latency, each measured from the time the input physically happened.
+typedef enum {
+    // Event read by the application through `bsp_event_wait`.
+    BSP_LATENCY_QUEUE,
+    // Event handled by the application.
+    BSP_LATENCY_HANDLE,
+    // Frame with the result of the event rendered.
+    BSP_LATENCY_RENDER,
+    // Frame with the result of the event sent to the display.
+    BSP_LATENCY_DISPLAY,
+    // Number of latency stages.
+    BSP_LATENCY_STAGE_COUNT,
+} bsp_latency_stage_t;
+
+// Latency statistics of one stage.
+typedef struct {
+    // Number of samples.
+    uint32_t count;
+    // Median latency in microseconds.
+    int64_t  p50_us;
+    // 99th percentile latency in microseconds.
+    int64_t  p99_us;
+    // Maximum latency in microseconds.
+    int64_t  max_us;
+} bsp_latency_stats_t;
+
+
+
+// Record the latency of a stage for an input that happened at `input_timestamp`.
+// Safe to use from interrupt handlers.
+void bsp_latency_record(bsp_latency_stage_t stage, int64_t input_timestamp);
+// Get the latency statistics of a stage.
+// Percentiles are accurate to within 25%.
+void bsp_latency_get(bsp_latency_stage_t stage, bsp_latency_stats_t *stats_out);
+// Reset the latency statistics of all stages.
+void bsp_latency_reset();
+// Set the input timestamp of the next frame sent to the display, or 0 if it does not show the result of an input.
+// The display driver records `BSP_LATENCY_DISPLAY` once the frame has been sent.
+void bsp_latency_set_frame_input(int64_t input_timestamp);
+// Take the input timestamp set by `bsp_latency_set_frame_input`; used by display drivers.
+int64_t bsp_latency_take_frame_input();
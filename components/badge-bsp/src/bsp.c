@@ -15,6 +15,12 @@ extern SemaphoreHandle_t bsp_dev_mtx;
 
 // Initialize the event queues.
 void bsp_event_queue_init();
+// Initialize the key repeat timer wheel.
+void bsp_repeat_init();
+// Initialize the deferred raw input handler.
+void bsp_raw_input_init();
+// Benchmark the event queue.
+void bsp_event_bench();
 
 // Pre-init function; initialize BSP but not external devices.
 void bsp_preinit() {
@@ -28,6 +34,12 @@ void bsp_preinit() {
     bsp_dev_mtx = xSemaphoreCreateBinary();
     xSemaphoreGive(bsp_dev_mtx);
     bsp_event_queue_init();
+#if CONFIG_BSP_EVENT_BENCH
+    // Before any devices exist, so only benchmark events are in the queue.
+    bsp_event_bench();
+#endif
+    bsp_repeat_init();
+    bsp_raw_input_init();
     bsp_platform_preinit();
 }
 
@@ -13,6 +13,9 @@
 #include "hardware/p4devkit.h"
 #endif
 
+#include "bsp/pool.h"
+#include "bsp_latency.h"
+
 #include <stdatomic.h>
 
 #include <esp_err.h>
@@ -35,8 +38,15 @@ typedef struct {
     esp_lcd_panel_handle_t    ctrl_handle;
     esp_lcd_panel_handle_t    disp_handle;
     SemaphoreHandle_t         disp_update_sem;
+    // Storage for `disp_update_sem`.
+    StaticSemaphore_t         disp_update_sem_buf;
+    // Input timestamp of the frame being sent, if any.
+    int64_t                   frame_input;
 } bsp_disp_dsi_t;
 
+// Pool of MIPI DSI driver data.
+BSP_POOL_DEFINE(dsi_pool, bsp_disp_dsi_t, CONFIG_BSP_DISP_MAX);
+
 
 
 // LDO regulator handle.
@@ -69,6 +79,10 @@ static esp_err_t dsi_phy_poweroff() {
 static bool
     bsp_disp_dsi_update_done(esp_lcd_panel_handle_t panel, esp_lcd_dpi_panel_event_data_t *edata, void *user_ctx) {
     bsp_disp_dsi_t *disp = user_ctx;
+    if (disp->frame_input) {
+        bsp_latency_record(BSP_LATENCY_DISPLAY, disp->frame_input);
+        disp->frame_input = 0;
+    }
     xSemaphoreGive(disp->disp_update_sem);
     return false;
 }
@@ -80,13 +94,13 @@ bool bsp_disp_dsi_init(bsp_device_t *dev, uint8_t endpoint, bsp_disp_dsi_new_t n
     esp_err_t res = 0;
 
     // Allocate data structures.
-    dev->disp_aux[endpoint] = malloc(sizeof(bsp_disp_dsi_t));
+    dev->disp_aux[endpoint] = bsp_pool_alloc(&dsi_pool);
     if (!dev->disp_aux[endpoint]) {
         ESP_LOGE(TAG, "Failed to initialize DSI display: %s", "out of memory");
         return false;
     }
     bsp_disp_dsi_t *disp  = dev->disp_aux[endpoint];
-    disp->disp_update_sem = xSemaphoreCreateBinary();
+    disp->disp_update_sem = xSemaphoreCreateBinaryStatic(&disp->disp_update_sem_buf);
     if (!disp->disp_update_sem) {
         goto error;
     }
@@ -195,7 +209,7 @@ error2:
 error:
     ESP_LOGI(TAG, "error1");
     vSemaphoreDelete(disp->disp_update_sem);
-    free(dev->disp_aux[endpoint]);
+    bsp_pool_free(&dsi_pool, dev->disp_aux[endpoint]);
     dev->disp_aux[endpoint] = NULL;
     ESP_LOGE(TAG, "Failed to initialize DSI display: %s", esp_err_to_name(res));
     return false;
@@ -209,7 +223,7 @@ bool bsp_disp_dsi_deinit(bsp_device_t *dev, uint8_t endpoint) {
     esp_lcd_panel_del(disp->ctrl_handle);
     esp_lcd_del_dsi_bus(disp->bus_handle);
     vSemaphoreDelete(disp->disp_update_sem);
-    free(disp);
+    bsp_pool_free(&dsi_pool, disp);
     dsi_phy_poweroff();
     return true;
 }
@@ -224,7 +238,8 @@ void bsp_disp_dsi_update(bsp_device_t *dev, uint8_t endpoint, void const *frameb
         return;
     }
     xSemaphoreTake(disp->disp_update_sem, portMAX_DELAY);
-    esp_err_t res = esp_lcd_panel_draw_bitmap(
+    disp->frame_input = bsp_latency_take_frame_input();
+    esp_err_t res     = esp_lcd_panel_draw_bitmap(
         disp->disp_handle,
         0,
         0,
@@ -247,7 +262,8 @@ void bsp_disp_dsi_update_part(
         return;
     }
     xSemaphoreTake(disp->disp_update_sem, portMAX_DELAY);
-    esp_err_t res = esp_lcd_panel_draw_bitmap(disp->disp_handle, x, y, w, h, framebuffer);
+    disp->frame_input = bsp_latency_take_frame_input();
+    esp_err_t res     = esp_lcd_panel_draw_bitmap(disp->disp_handle, x, y, w, h, framebuffer);
     if (res) {
         ESP_LOGE(TAG, "Display update part failed: %s", esp_err_to_name(res));
     }
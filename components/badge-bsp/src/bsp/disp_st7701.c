@@ -4,6 +4,8 @@
 #include "bsp/disp_st7701.h"
 
 #include "bsp/disp_mipi_dsi.h"
+#include "bsp/panel_cmds.h"
+#include "bsp/pool.h"
 
 #include <stdlib.h>
 
@@ -38,54 +40,53 @@ static esp_err_t bsp_st7701_set_gap(esp_lcd_panel_t *panel, int x_gap, int y_gap
 static esp_err_t bsp_st7701_disp_on_off(esp_lcd_panel_t *panel, bool off);
 static esp_err_t bsp_st7701_sleep(esp_lcd_panel_t *panel, bool sleep);
 
-typedef struct {
-    int         cmd;        /*<! The specific LCD command */
-    void const *data;       /*<! Buffer that holds the command specific data */
-    size_t      data_bytes; /*<! Size of `data` in memory, in bytes */
-} st7701_lcd_init_cmd_t;
-
 // clang-format off
-static const st7701_lcd_init_cmd_t init_sequence[] = {
-    // {cmd, { data }, data_size}
-    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x13}, 5},                                                                       // Bank 3
-    {0xEF, (uint8_t[]){0x08}, 1},                                                                                               //
-    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x10}, 5},                                                                       // Bank 0
-    {0xC0, (uint8_t[]){0x63, 0x00}, 2},                                                                                         // LNESET (Display Line Setting): (0x63+1)*8 = 800 lines
-    {0xC1, (uint8_t[]){0x10, 0x02}, 2},                                                                                         // PORCTRL (Porch Control): VBP = 16, VFP = 2
-    {0xC2, (uint8_t[]){0x37, 0x08}, 2},                                                                                         // INVSET (Inversion sel. & frame rate control): PCLK=512+(8*16) = 640
-    {0xCC, (uint8_t[]){0x30}, 1},                                                                                               //
-    {0xB0, (uint8_t[]){0x40, 0xC9, 0x8F, 0x0F, 0x17, 0x0B, 0x05, 0x0C, 0x0A, 0x23, 0x07, 0x5A, 0x17, 0xEA, 0x33, 0xDF}, 16},    // PVGAMCTRL
-    {0xB1, (uint8_t[]){0x40, 0xCB, 0xD3, 0x0C, 0x89, 0x00, 0x00, 0x02, 0x03, 0x1C, 0x02, 0x4B, 0x0A, 0x69, 0xF3, 0xDF}, 16},    // NVGAMCTRL
-    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x11}, 5},                                                                       // Bank 1
-    {0xB0, (uint8_t[]){0x65}, 1},                                                                                               // VRHS
-    {0xB1, (uint8_t[]){0x62}, 1},                                                                                               // VCOMS
-    {0xB2, (uint8_t[]){0x87}, 1},                                                                                               // VGH
-    {0xB3, (uint8_t[]){0x80}, 1},                                                                                               // TESTCMD
-    {0xB5, (uint8_t[]){0x42}, 1},                                                                                               // VGLS
-    {0xB7, (uint8_t[]){0x85}, 1},                                                                                               // PWCTRL1
-    {0xB8, (uint8_t[]){0x20}, 1},                                                                                               // PWCTRL2
-    {0xB9, (uint8_t[]){0x10}, 1},                                                                                               // DGMLUTR
-    {0xC1, (uint8_t[]){0x78}, 1},                                                                                               // SPD1
-    {0xC2, (uint8_t[]){0x78}, 1},                                                                                               // SPD2
-    {0xD0, (uint8_t[]){0x88}, 1},                                                                                               // MIPISET1
-    {0xE0, (uint8_t[]){0x00, 0x19, 0x02}, 3},                                                                                   //
-    {0xE1, (uint8_t[]){0x05, 0xA0, 0x07, 0xA0, 0x04, 0xA0, 0x06, 0xA0, 0x00, 0x44, 0x44}, 11},                                  //
-    {0xE2, (uint8_t[]){0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 13},                      //
-    {0xE3, (uint8_t[]){0x00, 0x00, 0x33, 0x33}, 5},                                                                             //
-    {0xE4, (uint8_t[]){0x44, 0x44}, 2},                                                                                         //
-    {0xE5, (uint8_t[]){0x0D, 0x31, 0xC8, 0xAF, 0x0F, 0x33, 0xC8, 0xAF, 0x09, 0x2D, 0xC8, 0xAF, 0x0B, 0x2F, 0xC8, 0xAF}, 16},    //
-    {0xE6, (uint8_t[]){0x00, 0x00, 0x33, 0x33}, 4},                                                                             //
-    {0xE7, (uint8_t[]){0x44, 0x44}, 2},                                                                                         //
-    {0xE8, (uint8_t[]){0x0C, 0x30, 0xC8, 0xAF, 0x0E, 0x32, 0xC8, 0xAF, 0x08, 0x2C, 0xC8, 0xAF, 0x0A, 0x2E, 0xC8, 0xAF}, 16},    //
-    {0xEB, (uint8_t[]){0x02, 0x00, 0xE4, 0xE4, 0x44, 0x00, 0x40}, 7},                                                           //
-    {0xEC, (uint8_t[]){0x3C, 0x00}, 2},                                                                                         //
-    {0xED, (uint8_t[]){0xAB, 0x89, 0x76, 0x54, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x10, 0x45, 0x67, 0x98, 0xBA}, 16},    //
-    {0xEF, (uint8_t[]){0x08, 0x08, 0x08, 0x45, 0x3F, 0x54}, 6},                                                                 //
-    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x00}, 5},                                                                       // Bank 0
-    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x13}, 5},                                                                       // Bank 3, enable BK function of command 2
-    {0xE8, (uint8_t[]){0x00, 0x0E}, 2},                                                                                         //
-    {0x3A, (uint8_t[]){0x50}, 1},                                                                                               // COLMOD (RGB 565)
-    {0x11, (uint8_t[]){0x00}, 0},                                                                                               // SLPOUT
+static const bsp_panel_cmd_t init_sequence[] = {
+    // {cmd, { data }, data_size, delay_ms}
+    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x13}, 5, 10},                                                                    // Bank 3
+    {0xEF, (uint8_t[]){0x08}, 1, 10},                                                                                            //
+    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x10}, 5, 10},                                                                    // Bank 0
+    {0xC0, (uint8_t[]){0x63, 0x00}, 2, 10},                                                                                      // LNESET (Display Line Setting): (0x63+1)*8 = 800 lines
+    {0xC1, (uint8_t[]){0x10, 0x02}, 2, 10},                                                                                      // PORCTRL (Porch Control): VBP = 16, VFP = 2
+    {0xC2, (uint8_t[]){0x37, 0x08}, 2, 10},                                                                                      // INVSET (Inversion sel. & frame rate control): PCLK=512+(8*16) = 640
+    {0xCC, (uint8_t[]){0x30}, 1, 10},                                                                                            //
+    {0xB0, (uint8_t[]){0x40, 0xC9, 0x8F, 0x0F, 0x17, 0x0B, 0x05, 0x0C, 0x0A, 0x23, 0x07, 0x5A, 0x17, 0xEA, 0x33, 0xDF}, 16, 10}, // PVGAMCTRL
+    {0xB1, (uint8_t[]){0x40, 0xCB, 0xD3, 0x0C, 0x89, 0x00, 0x00, 0x02, 0x03, 0x1C, 0x02, 0x4B, 0x0A, 0x69, 0xF3, 0xDF}, 16, 10}, // NVGAMCTRL
+    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x11}, 5, 10},                                                                    // Bank 1
+    {0xB0, (uint8_t[]){0x65}, 1, 10},                                                                                            // VRHS
+    {0xB1, (uint8_t[]){0x62}, 1, 10},                                                                                            // VCOMS
+    {0xB2, (uint8_t[]){0x87}, 1, 10},                                                                                            // VGH
+    {0xB3, (uint8_t[]){0x80}, 1, 10},                                                                                            // TESTCMD
+    {0xB5, (uint8_t[]){0x42}, 1, 10},                                                                                            // VGLS
+    {0xB7, (uint8_t[]){0x85}, 1, 10},                                                                                            // PWCTRL1
+    {0xB8, (uint8_t[]){0x20}, 1, 10},                                                                                            // PWCTRL2
+    {0xB9, (uint8_t[]){0x10}, 1, 10},                                                                                            // DGMLUTR
+    {0xC1, (uint8_t[]){0x78}, 1, 10},                                                                                            // SPD1
+    {0xC2, (uint8_t[]){0x78}, 1, 10},                                                                                            // SPD2
+    {0xD0, (uint8_t[]){0x88}, 1, 10},                                                                                            // MIPISET1
+    {0xE0, (uint8_t[]){0x00, 0x19, 0x02}, 3, 10},                                                                                //
+    {0xE1, (uint8_t[]){0x05, 0xA0, 0x07, 0xA0, 0x04, 0xA0, 0x06, 0xA0, 0x00, 0x44, 0x44}, 11, 10},                               //
+    {0xE2, (uint8_t[]){0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 13, 10},                   //
+    {0xE3, (uint8_t[]){0x00, 0x00, 0x33, 0x33}, 4, 10},                                                                          // 4 parameters, like E6
+    {0xE4, (uint8_t[]){0x44, 0x44}, 2, 10},                                                                                      //
+    {0xE5, (uint8_t[]){0x0D, 0x31, 0xC8, 0xAF, 0x0F, 0x33, 0xC8, 0xAF, 0x09, 0x2D, 0xC8, 0xAF, 0x0B, 0x2F, 0xC8, 0xAF}, 16, 10}, //
+    {0xE6, (uint8_t[]){0x00, 0x00, 0x33, 0x33}, 4, 10},                                                                          //
+    {0xE7, (uint8_t[]){0x44, 0x44}, 2, 10},                                                                                      //
+    {0xE8, (uint8_t[]){0x0C, 0x30, 0xC8, 0xAF, 0x0E, 0x32, 0xC8, 0xAF, 0x08, 0x2C, 0xC8, 0xAF, 0x0A, 0x2E, 0xC8, 0xAF}, 16, 10}, //
+    {0xEB, (uint8_t[]){0x02, 0x00, 0xE4, 0xE4, 0x44, 0x00, 0x40}, 7, 10},                                                        //
+    {0xEC, (uint8_t[]){0x3C, 0x00}, 2, 10},                                                                                      //
+    {0xED, (uint8_t[]){0xAB, 0x89, 0x76, 0x54, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x10, 0x45, 0x67, 0x98, 0xBA}, 16, 10}, //
+    {0xEF, (uint8_t[]){0x08, 0x08, 0x08, 0x45, 0x3F, 0x54}, 6, 10},                                                              //
+    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x00}, 5, 10},                                                                    // Bank 0
+    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x13}, 5, 10},                                                                    // Bank 3, enable BK function of command 2
+    {0xE8, (uint8_t[]){0x00, 0x0E}, 2, 10},                                                                                      //
+    {0x3A, (uint8_t[]){0x50}, 1, 10},                                                                                            // COLMOD (RGB 565)
+    {0x11, (uint8_t[]){0x00}, 0, 10},                                                                                            // SLPOUT
+    {0xE8, (uint8_t[]){0x00, 0x0C}, 2, 0},                                                                                       //
+    {0xE8, (uint8_t[]){0x00, 0x00}, 2, 0},                                                                                       //
+    {0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x00}, 5, 0},                                                                     // Bank 0
+    {0x29, NULL, 0, 0},                                                                                                          // DISPON
+    {0x13, NULL, 0, 0},                                                                                                          // NORON
 };
 // clang-format on
 
@@ -101,6 +102,9 @@ typedef struct {
     bool                      reset_level;
 } st7701_panel_t;
 
+// Pool of ST7701 panel data.
+BSP_POOL_DEFINE(st7701_pool, st7701_panel_t, CONFIG_BSP_DISP_MAX);
+
 static esp_err_t bsp_disp_st7701_new(
     esp_lcd_panel_io_handle_t         io,
     esp_lcd_panel_dev_config_t       *panel_dev_config,
@@ -110,7 +114,7 @@ static esp_err_t bsp_disp_st7701_new(
 ) {
     esp_err_t ret = ESP_OK;
     ESP_RETURN_ON_FALSE(io && panel_dev_config && ret_panel, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
-    st7701_panel_t *st7701 = (st7701_panel_t *)calloc(1, sizeof(st7701_panel_t));
+    st7701_panel_t *st7701 = bsp_pool_alloc(&st7701_pool);
     ESP_RETURN_ON_FALSE(st7701, ESP_ERR_NO_MEM, TAG, "no mem for st7701 panel");
 
     if (panel_dev_config->reset_gpio_num >= 0) {
@@ -174,7 +178,7 @@ static esp_err_t bsp_st7701_del(esp_lcd_panel_t *panel) {
     if (st7701->reset_gpio_num >= 0) {
         gpio_reset_pin(st7701->reset_gpio_num);
     }
-    free(st7701);
+    bsp_pool_free(&st7701_pool, st7701);
     return ESP_OK;
 }
 
@@ -196,41 +200,15 @@ static esp_err_t bsp_st7701_reset(esp_lcd_panel_t *panel) {
 }
 
 static esp_err_t bsp_st7701_init(esp_lcd_panel_t *panel) {
-    st7701_panel_t           *st7701 = __containerof(panel, st7701_panel_t, base);
-    esp_lcd_panel_io_handle_t io     = st7701->io;
-
-    st7701_lcd_init_cmd_t const *init_cmds      = init_sequence;
-    uint16_t                     init_cmds_size = sizeof(init_sequence) / sizeof(st7701_lcd_init_cmd_t);
-
-    // printf("Init sequence\n");
-    for (int i = 0; i < init_cmds_size; i++) {
-        // printf("Command #%u: %02x with %u params\n", i, init_cmds[i].cmd, init_cmds[i].data_bytes);
-        ESP_RETURN_ON_ERROR(
-            esp_lcd_panel_io_tx_param(io, init_cmds[i].cmd, init_cmds[i].data, init_cmds[i].data_bytes),
-            TAG,
-            "send command failed"
-        );
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-
-    // TODO: What are these?
-    // printf("Other commands ok\n");
-    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_param(io, 0xE8, (uint8_t[]){0x00, 0x0C}, 2), TAG, "send command failed");
-    // vTaskDelay(pdMS_TO_TICKS(10));
-    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_param(io, 0xE8, (uint8_t[]){0x00, 0x00}, 2), TAG, "send command failed");
-    // vTaskDelay(pdMS_TO_TICKS(10));
+    st7701_panel_t *st7701 = __containerof(panel, st7701_panel_t, base);
+#if CONFIG_BSP_PANEL_CMDS_CHECK
     ESP_RETURN_ON_ERROR(
-        esp_lcd_panel_io_tx_param(io, 0xFF, (uint8_t[]){0x77, 0x01, 0x00, 0x00, 0x00}, 5),
+        bsp_panel_check_cmds(init_sequence, sizeof(init_sequence) / sizeof(bsp_panel_cmd_t)),
         TAG,
-        "send command failed"
+        "init sequence check failed"
     );
-    // vTaskDelay(pdMS_TO_TICKS(10));
-    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_param(io, 0x29, (uint8_t[]){0x00}, 0), TAG, "send command failed");
-    // vTaskDelay(pdMS_TO_TICKS(10));
-    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_param(io, 0x13, (uint8_t[]){0x00}, 0), TAG, "send command failed");
-    // vTaskDelay(pdMS_TO_TICKS(10));
-
-    return ESP_OK;
+#endif
+    return bsp_panel_send_cmds(st7701->io, init_sequence, sizeof(init_sequence) / sizeof(bsp_panel_cmd_t));
 }
 
 static esp_err_t bsp_st7701_invert_color(esp_lcd_panel_t *panel, bool invert_color_data) {
@@ -21,26 +21,24 @@ static char const TAG[] = "bsp-gpio";
 // GPIO interrupt config.
 typedef struct {
     // Device ID.
-    uint32_t dev_id;
+    uint32_t           dev_id;
     // Device endpoint.
-    uint8_t  dev_ep;
+    uint8_t            dev_ep;
     // GPIO pin.
-    uint8_t  pin;
+    uint8_t            pin;
     // Active-low pin.
-    bool     activelow;
+    bool               activelow;
     // Raw input.
-    int      input;
+    int                input;
+    // Debouncing state.
+    bsp_raw_debounce_t debounce;
 } gpio_irq_cfg_t;
 
-// ISR for GPIO input devices.
+// ISR for GPIO input devices; only records the change, which is handled later.
 static void gpio_input_isr(void *arg) {
-    gpio_irq_cfg_t *cfg = arg;
-
-    if (gpio_get_level(cfg->pin) ^ cfg->activelow) {
-        bsp_raw_button_pressed_from_isr(cfg->dev_id, cfg->dev_ep, cfg->input);
-    } else {
-        bsp_raw_button_released_from_isr(cfg->dev_id, cfg->dev_ep, cfg->input);
-    }
+    gpio_irq_cfg_t *cfg     = arg;
+    bool            pressed = gpio_get_level(cfg->pin) ^ cfg->activelow;
+    bsp_raw_button_deferred_from_isr(cfg->dev_id, cfg->dev_ep, cfg->input, pressed, &cfg->debounce);
 }
 
 // GPIO input init function.
@@ -76,6 +74,9 @@ bool bsp_input_gpio_init(bsp_device_t *dev, uint8_t endpoint) {
             .pin       = pin,
             .activelow = tree->pinmap->activelow,
             .input     = i,
+            .debounce  = {
+                .time_us = tree->pinmap->debounce_ms ? tree->pinmap->debounce_ms[i] * 1000 : 0,
+            },
         };
 
         if ((res = gpio_set_direction(pin, GPIO_MODE_INPUT)) != ESP_OK) {
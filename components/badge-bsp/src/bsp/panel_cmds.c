@@ -0,0 +1,179 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp/panel_cmds.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <esp_check.h>
+#include <esp_lcd_panel_io.h>
+#include <esp_lcd_panel_io_interface.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/cdefs.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#endif
+
+static char const TAG[] = "bsp-panel";
+
+
+
+// Panel IO that records commands.
+typedef struct {
+    // Panel IO interface.
+    esp_lcd_panel_io_t  base;
+    // Record buffer.
+    bsp_panel_record_t *buf;
+    // Capacity of `buf`.
+    size_t              cap;
+    // Number of commands sent.
+    size_t             *len;
+} recorder_io_t;
+
+
+
+// Get monotonic time in microseconds; the same clock as `esp_timer_get_time` on the badge.
+static int64_t panel_now() {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+// Wait until a point in time as measured by `panel_now`.
+// Sleeps for whole ticks rounded up instead of spinning; panel delays are minimums, so a longer wait is fine.
+static void wait_until(int64_t deadline) {
+    int64_t now = panel_now();
+    if (deadline <= now) {
+        return;
+    }
+    int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    vTaskDelay((deadline - now + tick_us - 1) / tick_us);
+    // A tick boundary may come right after the delay starts, so make up for a short first tick.
+    while (panel_now() < deadline) {
+        vTaskDelay(1);
+    }
+}
+
+// Record a command.
+static esp_err_t recorder_tx_param(esp_lcd_panel_io_t *io, int cmd, void const *param, size_t param_size) {
+    recorder_io_t *rec = __containerof(io, recorder_io_t, base);
+    if (*rec->len < rec->cap) {
+        bsp_panel_record_t *record = &rec->buf[*rec->len];
+        memset(record, 0, sizeof(bsp_panel_record_t));
+        record->cmd        = cmd;
+        record->data_bytes = param_size;
+        record->timestamp  = panel_now();
+        if (param) {
+            memcpy(record->data, param, param_size < sizeof(record->data) ? param_size : sizeof(record->data));
+        }
+    }
+    (*rec->len)++;
+    return ESP_OK;
+}
+
+// Reading is not supported by the recorder.
+static esp_err_t recorder_rx_param(esp_lcd_panel_io_t *io, int cmd, void *param, size_t param_size) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+// Record a color data command without its data.
+static esp_err_t recorder_tx_color(esp_lcd_panel_io_t *io, int cmd, void const *color, size_t color_size) {
+    return recorder_tx_param(io, cmd, NULL, color_size);
+}
+
+// Delete the recorder.
+static esp_err_t recorder_del(esp_lcd_panel_io_t *io) {
+    free(__containerof(io, recorder_io_t, base));
+    return ESP_OK;
+}
+
+
+
+// Send a panel command list.
+// Delays are waited for only right before the next command or at the end, and only for as long as is still needed.
+esp_err_t bsp_panel_send_cmds(esp_lcd_panel_io_handle_t io, bsp_panel_cmd_t const *cmds, size_t cmds_len) {
+    // Earliest time at which the next command may be sent.
+    int64_t ready_at = 0;
+    for (size_t i = 0; i < cmds_len; i++) {
+        wait_until(ready_at);
+        ESP_RETURN_ON_ERROR(
+            esp_lcd_panel_io_tx_param(io, cmds[i].cmd, cmds[i].data, cmds[i].data_bytes),
+            TAG,
+            "send command 0x%02x failed",
+            cmds[i].cmd
+        );
+        if (cmds[i].delay_ms) {
+            ready_at = panel_now() + cmds[i].delay_ms * 1000LL;
+        }
+    }
+    wait_until(ready_at);
+    return ESP_OK;
+}
+
+// Create a panel IO that records sent commands instead of sending them; for checking init sequences off-device.
+// Commands beyond `cap` are counted in `*len_out` but not stored.
+esp_err_t bsp_panel_io_new_recorder(
+    bsp_panel_record_t *buf, size_t cap, size_t *len_out, esp_lcd_panel_io_handle_t *ret_io
+) {
+    recorder_io_t *rec = calloc(1, sizeof(recorder_io_t));
+    ESP_RETURN_ON_FALSE(rec, ESP_ERR_NO_MEM, TAG, "no mem for panel IO recorder");
+    rec->buf           = buf;
+    rec->cap           = cap;
+    rec->len           = len_out;
+    *len_out           = 0;
+    rec->base.rx_param = recorder_rx_param;
+    rec->base.tx_param = recorder_tx_param;
+    rec->base.tx_color = recorder_tx_color;
+    rec->base.del      = recorder_del;
+    *ret_io            = &rec->base;
+    return ESP_OK;
+}
+
+// Check that a command list is sent in order, with its parameters and at least its delays, using a recorder.
+// Takes as long as sending the list to a panel would.
+esp_err_t bsp_panel_check_cmds(bsp_panel_cmd_t const *cmds, size_t cmds_len) {
+    bsp_panel_record_t *records = calloc(cmds_len ?: 1, sizeof(bsp_panel_record_t));
+    ESP_RETURN_ON_FALSE(records, ESP_ERR_NO_MEM, TAG, "no mem for panel command records");
+    size_t                    records_len = 0;
+    esp_lcd_panel_io_handle_t io          = NULL;
+    esp_err_t                 res         = bsp_panel_io_new_recorder(records, cmds_len, &records_len, &io);
+    if (res == ESP_OK) {
+        res = bsp_panel_send_cmds(io, cmds, cmds_len);
+        esp_lcd_panel_io_del(io);
+    }
+    if (res == ESP_OK && records_len != cmds_len) {
+        ESP_LOGE(TAG, "%zu commands sent instead of %zu", records_len, cmds_len);
+        res = ESP_ERR_INVALID_STATE;
+    }
+
+    for (size_t i = 0; res == ESP_OK && i < cmds_len; i++) {
+        size_t cmp_len = cmds[i].data_bytes < sizeof(records[i].data) ? cmds[i].data_bytes : sizeof(records[i].data);
+        if (records[i].cmd != cmds[i].cmd || records[i].data_bytes != cmds[i].data_bytes ||
+            (cmp_len && memcmp(records[i].data, cmds[i].data, cmp_len))) {
+            ESP_LOGE(TAG, "Command %zu (0x%02x) sent as 0x%02x with other parameters", i, cmds[i].cmd, records[i].cmd);
+            res = ESP_ERR_INVALID_STATE;
+        } else if (i && records[i].timestamp - records[i - 1].timestamp < cmds[i - 1].delay_ms * 1000LL) {
+            ESP_LOGE(
+                TAG,
+                "Command %zu (0x%02x) sent %lld us after the previous; needs %u ms",
+                i,
+                cmds[i].cmd,
+                (long long)(records[i].timestamp - records[i - 1].timestamp),
+                cmds[i - 1].delay_ms
+            );
+            res = ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    free(records);
+    return res;
+}
@@ -4,6 +4,7 @@
 #include "bsp/why2025_coproc.h"
 
 #include "bsp.h"
+#include "bsp/alloc_count.h"
 #include "driver/i2c_master.h"
 #include "hardware/why2025.h"
 #include "tanmatsu_coprocessor.h"
@@ -11,8 +12,10 @@
 #include <driver/gpio.h>
 #include <driver/sdmmc_host.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <sdmmc_cmd.h>
 #include <string.h>
 
@@ -29,45 +32,472 @@ static sdmmc_host_t      sdmmc_host = SDMMC_HOST_DEFAULT();
 
 
 
-/* ==== platform-specific functions ==== */
-
-// Get the CH32 version.
-esp_err_t bsp_ch32_version(uint16_t *ver) {
-    return tanmatsu_coprocessor_get_firmware_version(coprocessor_handle, ver);
+/* ==== internal I²C bus scheduler ==== */
+
+// Number of operations whose writes can be coalesced.
+#define I2C_COALESCE_OPS 2
+// Number of reads the CH32 interrupt triggers.
+#define I2C_IRQ_READS    2
+
+// Internal I²C bus operations.
+typedef enum {
+    // Set display backlight; can be coalesced.
+    I2C_OP_SET_DISP_BACKLIGHT,
+    // Set keyboard backlight; can be coalesced.
+    I2C_OP_SET_KB_BACKLIGHT,
+    // Get display backlight.
+    I2C_OP_GET_DISP_BACKLIGHT,
+    // Get keyboard backlight.
+    I2C_OP_GET_KB_BACKLIGHT,
+    // Enable/disable the audio amplifier.
+    I2C_OP_AMPLIFIER,
+    // Set the ESP32-C6 RESET and BOOT pins.
+    I2C_OP_RADIO,
+    // Get the firmware version.
+    I2C_OP_VERSION,
+    // Get the keyboard matrix.
+    I2C_OP_KEYS,
+    // Get the SD card and headphone detect inputs.
+    I2C_OP_INPUTS,
+} i2c_op_t;
+
+// Internal I²C bus request.
+typedef struct i2c_req i2c_req_t;
+struct i2c_req {
+    // Next request in the same class.
+    i2c_req_t        *next;
+    // Operation to perform.
+    i2c_op_t          op;
+    // Transaction class.
+    bsp_i2c_class_t   cls;
+    // Value to write.
+    uint32_t          value;
+    // Where to store the value read.
+    void             *out;
+    // Result of the operation.
+    esp_err_t         res;
+    // Given when the result is ready, or NULL if asynchronous.
+    SemaphoreHandle_t done;
+    // Time at which the request was made.
+    int64_t           enqueued;
+};
+
+// Protects the request queues.
+static portMUX_TYPE    i2c_lock = portMUX_INITIALIZER_UNLOCKED;
+// Scheduler task.
+static TaskHandle_t    i2c_task;
+// First request per class.
+static i2c_req_t      *i2c_head[BSP_I2C_CLASS_COUNT];
+// Last request per class.
+static i2c_req_t      *i2c_tail[BSP_I2C_CLASS_COUNT];
+// Asynchronous writes per coalescable operation.
+static i2c_req_t       i2c_async[I2C_COALESCE_OPS];
+// Whether the asynchronous write for an operation is queued.
+static bool            i2c_async_queued[I2C_COALESCE_OPS];
+// Copy of the asynchronous write being performed.
+static i2c_req_t       i2c_async_current;
+// Statistics per class.
+static bsp_i2c_stats_t i2c_stats[BSP_I2C_CLASS_COUNT];
+
+// Set by the CH32 interrupt; the CH32 pulls its interrupt line low while it has input changes that weren't read yet.
+static volatile bool                 i2c_irq_pending;
+// Whether the reads triggered by the CH32 interrupt are queued or being performed.
+static bool                          i2c_irq_reading;
+// Keyboard matrix read after the CH32 interrupt, and the previous one.
+static tanmatsu_coprocessor_keys_t   irq_keys, irq_prev_keys;
+// Other inputs read after the CH32 interrupt, and the previous ones.
+static tanmatsu_coprocessor_inputs_t irq_inputs, irq_prev_inputs;
+// Reads triggered by the CH32 interrupt.
+static i2c_req_t                     i2c_irq_reqs[I2C_IRQ_READS] = {
+    {.op = I2C_OP_KEYS, .cls = BSP_I2C_CLASS_INPUT, .out = &irq_keys},
+    {.op = I2C_OP_INPUTS, .cls = BSP_I2C_CLASS_INPUT, .out = &irq_inputs},
+};
+
+// Perform an I²C operation.
+static esp_err_t i2c_execute(i2c_req_t const *req) {
+    switch (req->op) {
+        case I2C_OP_SET_DISP_BACKLIGHT:
+            return tanmatsu_coprocessor_set_display_backlight(coprocessor_handle, req->value);
+        case I2C_OP_SET_KB_BACKLIGHT:
+            return tanmatsu_coprocessor_set_keyboard_backlight(coprocessor_handle, req->value);
+        case I2C_OP_GET_DISP_BACKLIGHT:
+            return tanmatsu_coprocessor_get_display_backlight(coprocessor_handle, req->out);
+        case I2C_OP_GET_KB_BACKLIGHT:
+            return tanmatsu_coprocessor_get_keyboard_backlight(coprocessor_handle, req->out);
+        case I2C_OP_AMPLIFIER: return tanmatsu_coprocessor_set_amplifier_enable(coprocessor_handle, req->value);
+        case I2C_OP_RADIO: return tanmatsu_coprocessor_set_radio_state(coprocessor_handle, req->value);
+        case I2C_OP_VERSION: return tanmatsu_coprocessor_get_firmware_version(coprocessor_handle, req->out);
+        case I2C_OP_KEYS: return tanmatsu_coprocessor_get_keyboard_keys(coprocessor_handle, req->out);
+        case I2C_OP_INPUTS: return tanmatsu_coprocessor_get_inputs(coprocessor_handle, req->out);
+    }
+    return ESP_ERR_INVALID_ARG;
 }
 
-void coprocessor_keyboard_callback(
-    tanmatsu_coprocessor_handle_t handle, tanmatsu_coprocessor_keys_t *prev_keys, tanmatsu_coprocessor_keys_t *keys
-) {
-    uint8_t *buttons      = keys->raw;
-    uint8_t *prev_buttons = prev_keys->raw;
+// Add a request to the queue of its class; `i2c_lock` must be held.
+static void i2c_enqueue_locked(i2c_req_t *req) {
+    req->next = NULL;
+    if (i2c_tail[req->cls]) {
+        i2c_tail[req->cls]->next = req;
+    } else {
+        i2c_head[req->cls] = req;
+    }
+    i2c_tail[req->cls] = req;
+    bsp_i2c_stats_t *stats = &i2c_stats[req->cls];
+    stats->queued++;
+    if (stats->queued > stats->max_queued) {
+        stats->max_queued = stats->queued;
+    }
+}
 
-    // Fire button changed events.
-    for (int row = 0; row < 9; row++) {
-        for (int col = 0; col < 8; col++) {
-            if (((buttons[row] & ~prev_buttons[row]) >> col) & 1) {
-                bsp_raw_button_pressed(ch32_input_dev_id, ch32_input_dev_ep, row * 8 + col);
-            } else if (((~buttons[row] & prev_buttons[row]) >> col) & 1) {
-                bsp_raw_button_released(ch32_input_dev_id, ch32_input_dev_ep, row * 8 + col);
+// Take the highest priority request from the queues.
+static i2c_req_t *i2c_dequeue() {
+    i2c_req_t *req = NULL;
+    taskENTER_CRITICAL(&i2c_lock);
+    for (int cls = 0; cls < BSP_I2C_CLASS_COUNT && !req; cls++) {
+        req = i2c_head[cls];
+        if (req) {
+            i2c_head[cls] = req->next;
+            if (!i2c_head[cls]) {
+                i2c_tail[cls] = NULL;
             }
+            i2c_stats[cls].queued--;
+        }
+    }
+    if (req && req >= i2c_async && req < i2c_async + I2C_COALESCE_OPS) {
+        // Later writes to the same register need a new transaction.
+        i2c_async_queued[req - i2c_async] = false;
+        i2c_async_current                 = *req;
+        req                               = &i2c_async_current;
+    }
+    taskEXIT_CRITICAL(&i2c_lock);
+    return req;
+}
+
+// Send button events for the keys that changed in the keyboard matrix.
+static void ch32_keys_changed(tanmatsu_coprocessor_keys_t const *prev_keys, tanmatsu_coprocessor_keys_t const *keys) {
+    int64_t now = esp_timer_get_time();
+
+    // The 9x8 matrix is stored row-major, so when packed little-endian the bit index equals the scan code.
+    uint64_t cur_lo, prev_lo;
+    memcpy(&cur_lo, keys->raw, sizeof(uint64_t));
+    memcpy(&prev_lo, prev_keys->raw, sizeof(uint64_t));
+    uint64_t changed[2] = {
+        cur_lo ^ prev_lo,
+        keys->raw[8] ^ prev_keys->raw[8],
+    };
+    uint64_t current[2] = {
+        cur_lo,
+        keys->raw[8],
+    };
+
+    // Walk only the changed keys.
+    bsp_raw_button_t events[72];
+    size_t           events_len = 0;
+    for (int word = 0; word < 2; word++) {
+        uint64_t diff = changed[word];
+        while (diff) {
+            int bit  = __builtin_ctzll(diff);
+            diff    &= diff - 1;
+
+            events[events_len].input     = word * 64 + bit;
+            events[events_len].pressed   = (current[word] >> bit) & 1;
+            events[events_len].timestamp = now;
+            events_len++;
         }
     }
+
+    // Fire button changed events.
+    bsp_raw_button_batch(ch32_input_dev_id, ch32_input_dev_ep, events, events_len);
 }
 
-void coprocessor_input_callback(
-    tanmatsu_coprocessor_handle_t  handle,
-    tanmatsu_coprocessor_inputs_t *prev_inputs,
-    tanmatsu_coprocessor_inputs_t *inputs
+// Send events for the SD card and headphone detect inputs that changed.
+static void ch32_inputs_changed(
+    tanmatsu_coprocessor_inputs_t const *prev_inputs, tanmatsu_coprocessor_inputs_t const *inputs
 ) {
+    int64_t now = esp_timer_get_time();
+
     if ((inputs->sd_card_detect) != (prev_inputs->sd_card_detect)) {
         // SD card detect changed
         ESP_LOGW(TAG, "SD card %s", (inputs->sd_card_detect) ? "inserted" : "removed");
+        bsp_event_t event = {
+            .type   = BSP_EVENT_SDCARD,
+            .sdcard = {
+                .inserted  = inputs->sd_card_detect,
+                .timestamp = now,
+            },
+        };
+        bsp_event_queue(&event);
     }
 
     if ((inputs->headphone_detect) != (prev_inputs->headphone_detect)) {
         // Headphone detect changed
         ESP_LOGW(TAG, "Audio jack %s", (inputs->headphone_detect) ? "inserted" : "removed");
+        bsp_event_t event = {
+            .type       = BSP_EVENT_AUDIO_JACK,
+            .audio_jack = {
+                .inserted  = inputs->headphone_detect,
+                .timestamp = now,
+            },
+        };
+        bsp_event_queue(&event);
+    }
+}
+
+// CH32 interrupt; wakes up the scheduler to read the input changes.
+static void i2c_irq_isr(void *ignored) {
+    (void)ignored;
+    i2c_irq_pending  = true;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(i2c_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Queue the reads of the keyboard matrix and other inputs if the CH32 has input changes that weren't read yet.
+// The input class goes first, so these reads are never held up by other transactions.
+// Also checks the interrupt line itself, so changes made while the previous reads were running aren't missed.
+static void i2c_queue_irq_reads() {
+    if (i2c_irq_reading || (!i2c_irq_pending && gpio_get_level(BSP_CH32_IRQ_PIN))) {
+        return;
+    }
+    i2c_irq_pending = false;
+    i2c_irq_reading = true;
+    int64_t now     = esp_timer_get_time();
+    taskENTER_CRITICAL(&i2c_lock);
+    for (size_t i = 0; i < I2C_IRQ_READS; i++) {
+        i2c_irq_reqs[i].enqueued = now;
+        i2c_enqueue_locked(&i2c_irq_reqs[i]);
     }
+    taskEXIT_CRITICAL(&i2c_lock);
+}
+
+// Send events for the input changes read after the CH32 interrupt.
+static void i2c_irq_done(i2c_req_t const *req) {
+    if (req->op == I2C_OP_KEYS) {
+        if (req->res == ESP_OK && memcmp(&irq_keys, &irq_prev_keys, sizeof(irq_keys))) {
+            ch32_keys_changed(&irq_prev_keys, &irq_keys);
+            irq_prev_keys = irq_keys;
+        }
+    } else {
+        if (req->res == ESP_OK) {
+            ch32_inputs_changed(&irq_prev_inputs, &irq_inputs);
+            irq_prev_inputs = irq_inputs;
+        }
+        // This is the last read; the interrupt line says whether there are more changes.
+        i2c_irq_reading = false;
+    }
+}
+
+// Internal I²C bus scheduler thread function.
+static void i2c_sched_thread(void *ignored) {
+    (void)ignored;
+    while (1) {
+        i2c_queue_irq_reads();
+        i2c_req_t *req = i2c_dequeue();
+        if (!req) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        esp_err_t         res     = i2c_execute(req);
+        int64_t           latency = esp_timer_get_time() - req->enqueued;
+        SemaphoreHandle_t done    = req->done;
+        req->res                  = res;
+
+        taskENTER_CRITICAL(&i2c_lock);
+        bsp_i2c_stats_t *stats = &i2c_stats[req->cls];
+        stats->completed++;
+        stats->total_latency_us += latency;
+        if (latency > stats->max_latency_us) {
+            stats->max_latency_us = latency;
+        }
+        taskEXIT_CRITICAL(&i2c_lock);
+
+        if (req >= i2c_irq_reqs && req < i2c_irq_reqs + I2C_IRQ_READS) {
+            i2c_irq_done(req);
+        }
+        if (done) {
+            xSemaphoreGive(done);
+        }
+    }
+}
+
+// Perform an I²C operation through the scheduler and wait for the result.
+// Waits on a semaphore of its own so it doesn't take over any of the caller's task notifications.
+static esp_err_t i2c_submit(i2c_op_t op, bsp_i2c_class_t cls, uint32_t value, void *out) {
+    i2c_req_t req = {
+        .op       = op,
+        .cls      = cls,
+        .value    = value,
+        .out      = out,
+        .enqueued = esp_timer_get_time(),
+    };
+    if (!i2c_task) {
+        // Scheduler not running yet.
+        return i2c_execute(&req);
+    }
+    StaticSemaphore_t done_buf;
+    req.done = xSemaphoreCreateBinaryStatic(&done_buf);
+    taskENTER_CRITICAL(&i2c_lock);
+    i2c_enqueue_locked(&req);
+    taskEXIT_CRITICAL(&i2c_lock);
+    xTaskNotifyGive(i2c_task);
+    xSemaphoreTake(req.done, portMAX_DELAY);
+    vSemaphoreDelete(req.done);
+    return req.res;
+}
+
+// Queue a control write through the scheduler without waiting.
+// If a write to the same register is still queued, its value is replaced instead.
+// Writes of operations that can't be coalesced wait for the result.
+static esp_err_t i2c_submit_write(i2c_op_t op, uint32_t value) {
+    if (!i2c_task || op >= I2C_COALESCE_OPS) {
+        return i2c_submit(op, BSP_I2C_CLASS_CONTROL, value, NULL);
+    }
+    taskENTER_CRITICAL(&i2c_lock);
+    i2c_req_t *req = &i2c_async[op];
+    req->value     = value;
+    if (i2c_async_queued[op]) {
+        i2c_stats[BSP_I2C_CLASS_CONTROL].coalesced++;
+    } else {
+        req->op              = op;
+        req->cls             = BSP_I2C_CLASS_CONTROL;
+        req->done            = NULL;
+        req->enqueued        = esp_timer_get_time();
+        i2c_async_queued[op] = true;
+        i2c_enqueue_locked(req);
+    }
+    taskEXIT_CRITICAL(&i2c_lock);
+    xTaskNotifyGive(i2c_task);
+    return ESP_OK;
+}
+
+// Get the internal I²C bus statistics for a transaction class.
+void bsp_why2025_i2c_stats(bsp_i2c_class_t cls, bsp_i2c_stats_t *stats_out) {
+    taskENTER_CRITICAL(&i2c_lock);
+    *stats_out = i2c_stats[cls];
+    taskEXIT_CRITICAL(&i2c_lock);
+}
+
+
+
+/* ==== ESP32-C6 bring-up ==== */
+
+// Command to (re)start the C6 bring-up.
+#define C6_CMD_START      (1 << 0)
+// Command to stop the C6 bring-up because it was switched off.
+#define C6_CMD_STOP       (1 << 1)
+// Number of attempts at finding the C6 on the SDIO bus.
+#define C6_ATTEMPTS       8
+// Delay before the first retry of finding the C6; doubles with every retry.
+#define C6_BACKOFF_MIN_MS 50
+// Maximum delay between retries of finding the C6.
+#define C6_BACKOFF_MAX_MS 2000
+
+// C6 bring-up task.
+static TaskHandle_t            c6_task;
+// Current C6 bring-up state.
+static volatile bsp_c6_state_t c6_state;
+// Whether the C6 is currently enabled through `bsp_c6_control`.
+static volatile bool           c6_enabled;
+
+// Update the C6 state and send a `BSP_EVENT_RADIO` event if it became ready or failed, or stopped being ready.
+static void c6_set_state(bsp_c6_state_t state, esp_err_t error) {
+    bsp_c6_state_t prev = c6_state;
+    c6_state            = state;
+    if (state == prev || (state != BSP_C6_READY && state != BSP_C6_FAILED && prev != BSP_C6_READY)) {
+        return;
+    }
+    bsp_event_t event = {
+        .type  = BSP_EVENT_RADIO,
+        .radio = {
+            .ready     = state == BSP_C6_READY,
+            .error     = error,
+            .timestamp = esp_timer_get_time(),
+        },
+    };
+    bsp_event_queue(&event);
+}
+
+// Try to bring up the C6; returns commands that interrupted it, or 0 when done.
+static uint32_t c6_bringup() {
+    c6_set_state(BSP_C6_STARTING, ESP_OK);
+
+    // Make sure the C6 is powered.
+    if (!c6_enabled) {
+        esp_err_t res = bsp_c6_control(true, true);
+        if (res != ESP_OK) {
+            ESP_LOGE(TAG, "Unable to enable C6: %s", esp_err_to_name(res));
+            c6_set_state(BSP_C6_FAILED, res);
+            return 0;
+        }
+        // `bsp_c6_control` notified this task; that's not a restart.
+        ulTaskNotifyValueClear(NULL, C6_CMD_START);
+    }
+
+    // Find ESP32-C6 on SDIO bus.
+    uint32_t  backoff = C6_BACKOFF_MIN_MS;
+    esp_err_t res;
+    for (int attempt = 1;; attempt++) {
+        res = sdmmc_card_init(&sdmmc_host, &c6_card);
+        if (res == ESP_OK) {
+            break;
+        }
+        ESP_LOGW(TAG, "SDIO error: %s (attempt %d of %d)", esp_err_to_name(res), attempt, C6_ATTEMPTS);
+        if (attempt >= C6_ATTEMPTS) {
+            ESP_LOGE(TAG, "C6 not found");
+            c6_set_state(BSP_C6_FAILED, res);
+            return 0;
+        }
+        // Wait before retrying, unless the C6 gets switched off or restarted meanwhile.
+        uint32_t cmd = 0;
+        if (xTaskNotifyWait(0, UINT32_MAX, &cmd, pdMS_TO_TICKS(backoff)) == pdTRUE) {
+            return cmd;
+        }
+        backoff = backoff * 2 > C6_BACKOFF_MAX_MS ? C6_BACKOFF_MAX_MS : backoff * 2;
+    }
+
+    // Print card info.
+    sdmmc_card_print_info(stdout, &c6_card);
+    size_t cis_size = 0;
+    res             = sdmmc_io_get_cis_data(&c6_card, c6_cis_buf, sizeof(c6_cis_buf), &cis_size);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to read C6 CIS: %s", esp_err_to_name(res));
+        c6_set_state(BSP_C6_FAILED, res);
+        return 0;
+    }
+    sdmmc_io_print_cis_info(c6_cis_buf, cis_size, NULL);
+
+    c6_set_state(BSP_C6_READY, ESP_OK);
+    return 0;
+}
+
+// C6 bring-up thread function.
+static void c6_thread(void *ignored) {
+    (void)ignored;
+    uint32_t cmd = 0;
+    while (1) {
+        if (!cmd) {
+            xTaskNotifyWait(0, UINT32_MAX, &cmd, portMAX_DELAY);
+        }
+        if (!c6_enabled && (cmd & C6_CMD_STOP)) {
+            // Switched off; needs a full bring-up once switched back on.
+            c6_set_state(BSP_C6_OFF, ESP_OK);
+            cmd = 0;
+        } else if (cmd & C6_CMD_START) {
+            cmd = c6_bringup();
+        } else {
+            cmd = 0;
+        }
+    }
+}
+
+
+
+/* ==== platform-specific functions ==== */
+
+// Get the CH32 version.
+esp_err_t bsp_ch32_version(uint16_t *ver) {
+    return i2c_submit(I2C_OP_VERSION, BSP_I2C_CLASS_BULK, 0, ver);
 }
 
 // Initialise the co-processor drivers.
@@ -94,12 +524,11 @@ esp_err_t bsp_why2025_coproc_init() {
     }
 
     tanmatsu_coprocessor_config_t coprocessor_config = {
-        .int_io_num            = BSP_CH32_IRQ_PIN,
+        // The scheduler reads input when the CH32 interrupts, so the driver doesn't need a task of its own.
+        .int_io_num            = -1,
         .i2c_bus               = i2c_bus_handle,
         .i2c_address           = BSP_CH32_ADDR,
         .concurrency_semaphore = i2c_concurrency_semaphore,
-        .on_keyboard_change    = coprocessor_keyboard_callback,
-        .on_input_change       = coprocessor_input_callback,
     };
 
     res = tanmatsu_coprocessor_initialize(&coprocessor_config, &coprocessor_handle);
@@ -107,64 +536,89 @@ esp_err_t bsp_why2025_coproc_init() {
         return res;
     }
 
+    if (xTaskCreate(i2c_sched_thread, "bsp_i2cint", 3072, NULL, CONFIG_BSP_EVENT_TASK_PRIORITY, &i2c_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    bsp_alloc_count_add_input_task(i2c_task);
+
+    // The scheduler reads the initial input state once it runs; after that, whenever the CH32 interrupts.
+    i2c_irq_pending = true;
+    xTaskNotifyGive(i2c_task);
+    if ((res = gpio_set_direction(BSP_CH32_IRQ_PIN, GPIO_MODE_INPUT)) != ESP_OK) {
+        return res;
+    }
+    if ((res = gpio_set_pull_mode(BSP_CH32_IRQ_PIN, GPIO_PULLUP_ONLY)) != ESP_OK) {
+        return res;
+    }
+    if ((res = gpio_set_intr_type(BSP_CH32_IRQ_PIN, GPIO_INTR_NEGEDGE)) != ESP_OK) {
+        return res;
+    }
+    if ((res = gpio_isr_handler_add(BSP_CH32_IRQ_PIN, i2c_irq_isr, NULL)) != ESP_OK) {
+        return res;
+    }
+    res = gpio_intr_enable(BSP_CH32_IRQ_PIN);
+
     return res;
 }
 
 // Set the display backlight value.
 esp_err_t ch32_set_display_backlight(uint8_t value) {
-    return tanmatsu_coprocessor_set_display_backlight(coprocessor_handle, value);
+    return i2c_submit_write(I2C_OP_SET_DISP_BACKLIGHT, value);
 }
 
 // Set the keyboard backlight value.
 esp_err_t ch32_set_keyboard_backlight(uint8_t value) {
-    return tanmatsu_coprocessor_set_keyboard_backlight(coprocessor_handle, value);
+    return i2c_submit_write(I2C_OP_SET_KB_BACKLIGHT, value);
 }
 
 // Get the display backlight value.
 esp_err_t ch32_get_display_backlight(uint8_t *value) {
-    return tanmatsu_coprocessor_get_display_backlight(coprocessor_handle, value);
+    return i2c_submit(I2C_OP_GET_DISP_BACKLIGHT, BSP_I2C_CLASS_BULK, 0, value);
 }
 
 // Get the keyboard backlight value.
 esp_err_t ch32_get_keyboard_backlight(uint8_t *value) {
-    return tanmatsu_coprocessor_get_keyboard_backlight(coprocessor_handle, value);
+    return i2c_submit(I2C_OP_GET_KB_BACKLIGHT, BSP_I2C_CLASS_BULK, 0, value);
 }
 
 // Enable/disable the audio amplifier.
 esp_err_t bsp_amplifier_control(bool enable) {
-    return tanmatsu_coprocessor_set_amplifier_enable(coprocessor_handle, enable);
+    return i2c_submit(I2C_OP_AMPLIFIER, BSP_I2C_CLASS_CONTROL, enable, NULL);
 }
 
 // Enable/disable the ESP32-C6 via RESET and BOOT pins.
+// Disabling the C6 stops its bring-up; enabling it again after `bsp_c6_init` re-initializes it.
 esp_err_t bsp_c6_control(bool enable, bool boot) {
-    return tanmatsu_coprocessor_set_radio_state(coprocessor_handle, (enable & 1) | ((boot & 1) << 1));
+    esp_err_t res = i2c_submit(I2C_OP_RADIO, BSP_I2C_CLASS_CONTROL, (enable & 1) | ((boot & 1) << 1), NULL);
+    if (res == ESP_OK && enable != c6_enabled) {
+        c6_enabled = enable;
+        if (c6_task) {
+            xTaskNotify(c6_task, enable ? C6_CMD_START : C6_CMD_STOP, eSetBits);
+        }
+    }
+    return res;
 }
 
-// Initialize the ESP32-C6 after it was (re-)enabled.
+// Start initializing the ESP32-C6 in the background after it was (re-)enabled.
+// Sends a `BSP_EVENT_RADIO` event once it is ready or has failed.
 esp_err_t bsp_c6_init() {
-    // Find ESP32-C6 on SDIO bus.
-    sdmmc_host.flags         = SDMMC_HOST_FLAG_4BIT;
-    sdmmc_host.max_freq_khz  = SDMMC_FREQ_HIGHSPEED;
-    sdmmc_host.flags        |= SDMMC_HOST_FLAG_ALLOC_ALIGNED_BUF;
-    esp_err_t res;
-    while (1) {
-        res = sdmmc_card_init(&sdmmc_host, &c6_card);
-        if (!res) {
-            break;
+    if (!c6_task) {
+        sdmmc_host.flags        = SDMMC_HOST_FLAG_4BIT;
+        sdmmc_host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+        sdmmc_host.flags       |= SDMMC_HOST_FLAG_ALLOC_ALIGNED_BUF;
+        if (xTaskCreate(c6_thread, "bsp_c6", 3072, NULL, 5, &c6_task) != pdPASS) {
+            return ESP_ERR_NO_MEM;
         }
-        ESP_LOGE(TAG, "SDIO error: %s", esp_err_to_name(res));
-        vTaskDelay(pdMS_TO_TICKS(500));
     }
-
-    // Print card info.
-    sdmmc_card_print_info(stdout, &c6_card);
-    size_t cis_size = 0;
-    sdmmc_io_get_cis_data(&c6_card, c6_cis_buf, sizeof(c6_cis_buf), &cis_size);
-    sdmmc_io_print_cis_info(c6_cis_buf, cis_size, NULL);
-
+    xTaskNotify(c6_task, C6_CMD_START, eSetBits);
     return ESP_OK;
 }
 
+// Get the ESP32-C6 bring-up state.
+bsp_c6_state_t bsp_c6_get_state() {
+    return c6_state;
+}
+
 
 
 /* ==== device driver functions ==== */
@@ -179,10 +633,12 @@ bool bsp_input_why2025ch32_init(bsp_device_t *dev, uint8_t endpoint) {
 // Get current input value by raw input number.
 bool bsp_input_why2025ch32_get_raw(bsp_device_t *dev, uint8_t endpoint, uint16_t raw_input) {
     tanmatsu_coprocessor_keys_t keys;
-    tanmatsu_coprocessor_get_keyboard_keys(coprocessor_handle, &keys);
+    if (raw_input >= sizeof(keys.raw) * 8 || i2c_submit(I2C_OP_KEYS, BSP_I2C_CLASS_INPUT, 0, &keys) != ESP_OK) {
+        return false;
+    }
 
-		uint16_t row = raw_input / 8;
-		uint16_t col = raw_input % 8;
+    uint16_t row = raw_input / 8;
+    uint16_t col = raw_input % 8;
 
     return (keys.raw[row] >> col) & 1;
 }
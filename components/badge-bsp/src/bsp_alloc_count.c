@@ -0,0 +1,90 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp_alloc_count.h"
+
+#include "bsp/alloc_count.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+
+
+// Maximum number of BSP tasks that handle input.
+#define INPUT_TASKS_MAX 8
+
+// Task whose allocations are being counted, or NULL if not counting.
+static TaskHandle_t _Atomic counting;
+// Number of allocations since counting started.
+static atomic_uint          count;
+// BSP tasks that handle input; the used entries come first.
+static TaskHandle_t _Atomic input_tasks[INPUT_TASKS_MAX];
+// Number of allocations by `input_tasks` since `bsp_alloc_count_input` was last called.
+static atomic_uint          input_count;
+
+
+
+#if CONFIG_BSP_ALLOC_COUNT
+// Heap hook called on every allocation.
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    (void)ptr;
+    (void)size;
+    (void)caps;
+    TaskHandle_t cur  = xTaskGetCurrentTaskHandle();
+    TaskHandle_t task = atomic_load_explicit(&counting, memory_order_relaxed);
+    if (task && task == cur) {
+        atomic_fetch_add_explicit(&count, 1, memory_order_relaxed);
+    }
+    for (size_t i = 0; i < INPUT_TASKS_MAX; i++) {
+        task = atomic_load_explicit(&input_tasks[i], memory_order_relaxed);
+        if (!task) {
+            break;
+        } else if (task == cur) {
+            atomic_fetch_add_explicit(&input_count, 1, memory_order_relaxed);
+            break;
+        }
+    }
+}
+
+// Heap hook called on every free.
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+    (void)ptr;
+}
+#endif
+
+
+
+// Start counting heap allocations made by the calling task; needs `CONFIG_BSP_ALLOC_COUNT`.
+// Allocations by other tasks, such as background jobs and drivers, are not counted.
+void bsp_alloc_count_start() {
+    atomic_store(&count, 0);
+    atomic_store(&counting, xTaskGetCurrentTaskHandle());
+}
+
+// Stop counting heap allocations and get how many were made since `bsp_alloc_count_start`.
+// Always 0 without `CONFIG_BSP_ALLOC_COUNT`.
+uint32_t bsp_alloc_count_stop() {
+    atomic_store(&counting, NULL);
+    return atomic_load(&count);
+}
+
+// Count the heap allocations of a BSP task that handles input; see `bsp_alloc_count_input`.
+void bsp_alloc_count_add_input_task(TaskHandle_t task) {
+    for (size_t i = 0; task && i < INPUT_TASKS_MAX; i++) {
+        TaskHandle_t expected = NULL;
+        if (atomic_compare_exchange_strong(&input_tasks[i], &expected, task) || expected == task) {
+            return;
+        }
+    }
+}
+
+// Get the number of heap allocations made by the BSP's input tasks since the last call; needs `CONFIG_BSP_ALLOC_COUNT`.
+// Unlike `bsp_alloc_count_start`, this counts all the time, as these tasks run whenever input arrives.
+uint32_t bsp_alloc_count_input() {
+    return atomic_exchange(&input_count, 0);
+}
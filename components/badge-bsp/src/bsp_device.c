@@ -7,36 +7,92 @@
 #include "bsp/disp_ek79007.h"
 #include "bsp/disp_mipi_dsi.h"
 #include "bsp/disp_st7701.h"
+#include "bsp/dispatch.h"
+#include "bsp/drivers.h"
+#include "bsp/pool.h"
 #include "bsp/input_gpio.h"
 #include "bsp/why2025_coproc.h"
 #include "bsp_color.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdatomic.h>
 #include <string.h>
 
 static char const TAG[] = "bsp-device";
 
+// Start repeating a key that was just pressed.
+void bsp_repeat_start(bsp_event_t const *event, uint16_t delay_ms, uint16_t period_ms);
+// Stop repeating a key that was just released.
+void bsp_repeat_stop(uint32_t dev_id, uint8_t endpoint, int raw_input);
+// Stop repeating all keys.
+void bsp_repeat_stop_all();
 
 
-// Input driver table.
-static bsp_input_driver_t const *input_tab[] = {
-    [BSP_EP_INPUT_GPIO] = &(bsp_input_driver_t const){
-        .common = {
-            .init    = bsp_input_gpio_init,
-            .deinit  = bsp_input_gpio_deinit,
-        },
-        .get_raw = bsp_input_gpio_get_raw,
+
+// GPIO input driver.
+bsp_input_driver_t const bsp_drv_input_gpio = {
+    .common = {
+        .init    = bsp_input_gpio_init,
+        .deinit  = bsp_input_gpio_deinit,
     },
+    .get_raw = bsp_input_gpio_get_raw,
+};
+
 #if CONFIG_BSP_SUPPORT_WHY2025_COPROC
-    [BSP_EP_INPUT_WHY2025_CH32] = &(bsp_input_driver_t const){
-        .common = {
-            .init    = bsp_input_why2025ch32_init,
-            .deinit  = NULL,
-        },
-        .get_raw = bsp_input_why2025ch32_get_raw,
+// WHY2025 CH32 coprocessor input driver.
+bsp_input_driver_t const bsp_drv_input_why2025ch32 = {
+    .common = {
+        .init    = bsp_input_why2025ch32_init,
+        .deinit  = NULL,
+    },
+    .get_raw = bsp_input_why2025ch32_get_raw,
+};
+
+// WHY2025 CH32 coprocessor LED driver.
+bsp_led_driver_t const bsp_drv_led_why2025ch32 = {
+    .common = {
+        .init = NULL,
+        .deinit = NULL,
     },
+    .set_raw = bsp_led_why2025ch32_set_raw,
+    .get_raw = bsp_led_why2025ch32_get_raw,
+    .update  = bsp_led_why2025ch32_update,
+};
+#endif
+
+#if CONFIG_BSP_SUPPORT_ST7701
+// ST7701 display driver.
+bsp_disp_driver_t const bsp_drv_disp_st7701 = {
+    .common = {
+        .init    = bsp_disp_st7701_init,
+        .deinit  = bsp_disp_dsi_deinit,
+    },
+    .update      = bsp_disp_dsi_update,
+    .update_part = bsp_disp_dsi_update_part,
+};
+#endif
+
+#if CONFIG_BSP_SUPPORT_EK79007
+// EK79007 display driver.
+bsp_disp_driver_t const bsp_drv_disp_ek79007 = {
+    .common = {
+        .init    = bsp_disp_ek79007_init,
+        .deinit  = bsp_disp_dsi_deinit,
+    },
+    .update      = bsp_disp_dsi_update,
+    .update_part = bsp_disp_dsi_update_part,
+};
+#endif
+
+// Input driver table.
+static bsp_input_driver_t const *input_tab[] = {
+    [BSP_EP_INPUT_GPIO] = &bsp_drv_input_gpio,
+#if CONFIG_BSP_SUPPORT_WHY2025_COPROC
+    [BSP_EP_INPUT_WHY2025_CH32] = &bsp_drv_input_why2025ch32,
 #endif
 };
 static size_t const input_tab_len = sizeof(input_tab) / sizeof(bsp_input_driver_t const *);
@@ -44,15 +100,7 @@ static size_t const input_tab_len = sizeof(input_tab) / sizeof(bsp_input_driver_
 // LED driver table.
 static bsp_led_driver_t const *led_tab[] = {
 #if CONFIG_BSP_SUPPORT_WHY2025_COPROC
-    [BSP_EP_LED_WHY2025_CH32] = &(bsp_led_driver_t const) {
-        .common = {
-            .init = NULL,
-            .deinit = NULL,
-        },
-        .set_raw = bsp_led_why2025ch32_set_raw,
-        .get_raw = bsp_led_why2025ch32_get_raw,
-        .update  = bsp_led_why2025ch32_update,
-    }
+    [BSP_EP_LED_WHY2025_CH32] = &bsp_drv_led_why2025ch32,
 #endif
 };
 static size_t const led_tab_len = sizeof(led_tab) / sizeof(bsp_led_driver_t const *);
@@ -60,24 +108,10 @@ static size_t const led_tab_len = sizeof(led_tab) / sizeof(bsp_led_driver_t cons
 // Display driver table.
 static bsp_disp_driver_t const *const disp_tab[] = {
 #if CONFIG_BSP_SUPPORT_ST7701
-    [BSP_EP_DISP_ST7701] = &(bsp_disp_driver_t const){
-        .common = {
-            .init    = bsp_disp_st7701_init,
-            .deinit  = bsp_disp_dsi_deinit,
-        },
-        .update      = bsp_disp_dsi_update,
-        .update_part = bsp_disp_dsi_update_part,
-    },
+    [BSP_EP_DISP_ST7701] = &bsp_drv_disp_st7701,
 #endif
 #if CONFIG_BSP_SUPPORT_EK79007
-    [BSP_EP_DISP_EK79007] = &(bsp_disp_driver_t const){
-        .common = {
-            .init    = bsp_disp_ek79007_init,
-            .deinit  = bsp_disp_dsi_deinit,
-        },
-        .update      = bsp_disp_dsi_update,
-        .update_part = bsp_disp_dsi_update_part,
-    },
+    [BSP_EP_DISP_EK79007] = &bsp_drv_disp_ek79007,
 #endif
 };
 static size_t const disp_tab_len = sizeof(disp_tab) / sizeof(bsp_disp_driver_t const *);
@@ -96,6 +130,26 @@ static size_t const driver_len[] = {
     disp_tab_len,
 };
 
+// Maximum number of endpoints per device.
+#define DEV_MAX_EPS CONFIG_BSP_DEVICE_MAX_ENDPOINTS
+
+// Device with storage for all of its per-endpoint arrays.
+typedef struct {
+    // Device.
+    bsp_device_t               dev;
+    // Endpoints in initialization order.
+    bsp_ep_init_t              init_order[DEV_MAX_EPS];
+    // Runtime state of input endpoints.
+    bsp_input_state_t          input_state[DEV_MAX_EPS];
+    // Auxiliary driver data of all endpoints.
+    void                      *aux[DEV_MAX_EPS];
+    // Drivers of all endpoints.
+    bsp_driver_common_t const *drivers[DEV_MAX_EPS];
+} dev_block_t;
+
+// Pool of devices.
+BSP_POOL_DEFINE(dev_pool, dev_block_t, CONFIG_BSP_DEVICE_MAX);
+
 
 
 // Device table mutex.
@@ -107,7 +161,7 @@ static uint32_t       next_dev_id      = 1;
 // Number of registered devices.
 static size_t         devices_len      = 0;
 // Registered devices.
-static bsp_device_t **devices          = NULL;
+static bsp_device_t  *devices[CONFIG_BSP_DEVICE_MAX];
 // Per-modkey counter.
 static uint16_t       modkey_count[16] = {0};
 // Current modkey value.
@@ -160,69 +214,166 @@ static void rel_excl() {
 // Names for endpoint types.
 char const *const ep_type_str[] = {"input", "LED", "display"};
 
-// Run device init functions.
-static void run_init_funcs(bsp_device_t *dev, bool is_deinit) {
-    // Count number of endpoints.
-    uint16_t ep_count = 0;
+// Maximum number of tasks that help run init functions of the same priority in parallel.
+#define INIT_WORKERS      2
+// Stack size of the init helper tasks; display drivers need a fair amount.
+#define INIT_WORKER_STACK CONFIG_BSP_INIT_WORKER_STACK
+
+// Init functions of one priority level being run in parallel.
+typedef struct {
+    // Device being (de)initialized.
+    bsp_device_t     *dev;
+    // Endpoints at this level.
+    bsp_ep_init_t    *eps;
+    // Number of endpoints at this level.
+    size_t            eps_len;
+    // Index of the next endpoint to (de)initialize.
+    atomic_size_t     next;
+    // Whether to run deinit functions instead of init functions.
+    bool              is_deinit;
+    // Given by each helper when it is done with this level.
+    SemaphoreHandle_t done;
+} init_job_t;
+
+// Run the init or deinit function of a single endpoint.
+static void run_init_func(bsp_device_t *dev, bsp_ep_init_t *ep, bool is_deinit) {
+    bsp_driver_common_t const *driver = dev->ep_drivers[ep->type][ep->endpoint];
+    bsp_dev_initfun_t          func   = !driver ? NULL : is_deinit ? driver->deinit : driver->init;
+    if (!func) {
+        return;
+    }
+    char const *what = is_deinit ? "deinit" : "init";
+    ESP_LOGD(TAG, "Device %" PRIu32 " %s endpoint %" PRId8 " %s", dev->id, ep_type_str[ep->type], ep->endpoint, what);
+
+    int64_t start   = esp_timer_get_time();
+    bool    success = func(dev, ep->endpoint);
+    int64_t time    = esp_timer_get_time() - start;
+    if (is_deinit) {
+        ep->deinit_ok = success;
+        ep->deinit_us = time;
+    } else {
+        ep->init_ok = success;
+        ep->init_us = time;
+    }
+
+    if (!success) {
+        ESP_LOGE(
+            TAG,
+            "Device %" PRIu32 " %s endpoint %" PRId8 " %s failed",
+            dev->id,
+            ep_type_str[ep->type],
+            ep->endpoint,
+            what
+        );
+    } else {
+        ESP_LOGD(
+            TAG,
+            "Device %" PRIu32 " %s endpoint %" PRId8 " %s took %" PRId64 " us",
+            dev->id,
+            ep_type_str[ep->type],
+            ep->endpoint,
+            what,
+            time
+        );
+    }
+}
+
+// Run init functions of a level until there are none left.
+static void init_job_run(init_job_t *job) {
+    size_t i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->eps_len) {
+        run_init_func(job->dev, &job->eps[i], job->is_deinit);
+    }
+}
+
+// Init helper thread function; helps with one level, then exits.
+static void init_worker_thread(void *arg) {
+    init_job_t *job = arg;
+    init_job_run(job);
+    xSemaphoreGive(job->done);
+    vTaskDelete(NULL);
+}
+
+// Run the init functions of a level with help from temporary tasks.
+// The helpers run on the same core as the caller, so drivers allocate their interrupts where they would without them.
+static void init_job_run_parallel(bsp_device_t *dev, bsp_ep_init_t *eps, uint16_t count, bool is_deinit) {
+    init_job_t job = {
+        .dev       = dev,
+        .eps       = eps,
+        .eps_len   = count,
+        .next      = 0,
+        .is_deinit = is_deinit,
+        .done      = xSemaphoreCreateCounting(INIT_WORKERS, 0),
+    };
+    int helpers = 0;
+    if (job.done) {
+        BaseType_t  core = xPortGetCoreID();
+        UBaseType_t prio = uxTaskPriorityGet(NULL);
+        while (helpers < INIT_WORKERS && helpers < count - 1 &&
+               xTaskCreatePinnedToCore(init_worker_thread, "bsp_ep_init", INIT_WORKER_STACK, &job, prio, NULL, core) ==
+                   pdPASS) {
+            helpers++;
+        }
+    }
+    // Whatever the helpers don't get to, or all of it if they couldn't be started, runs here.
+    init_job_run(&job);
+    for (int i = 0; i < helpers; i++) {
+        xSemaphoreTake(job.done, portMAX_DELAY);
+    }
+    if (job.done) {
+        vSemaphoreDelete(job.done);
+    }
+}
+
+// Compute the order in which to initialize the endpoints of a device.
+// Endpoints with the same priority keep the order of their type and index.
+static void compute_init_order(bsp_device_t *dev, bsp_devtree_t const *tree) {
+    // Insertion sort; devices have few endpoints.
     for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
-        ep_count += bsp_dev_get_tree_raw(dev)->ep_counts[i];
-    }
-
-    int thr_prio = is_deinit ? INT_MAX : INT_MIN;
-    while (ep_count) {
-        int cur_prio = is_deinit ? INT_MIN : INT_MAX;
-        // Get minimum priority.
-        for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
-            for (int j = 0; j < bsp_dev_get_tree_raw(dev)->ep_counts[i]; j++) {
-                int prio = bsp_dev_get_tree_raw(dev)->ep_trees[i][j]->init_prio;
-                if (is_deinit && prio <= thr_prio && prio > cur_prio) {
-                    cur_prio = prio;
-                } else if (!is_deinit && prio >= thr_prio && prio < cur_prio) {
-                    cur_prio = prio;
-                }
+        for (uint8_t j = 0; j < tree->ep_counts[i]; j++) {
+            bsp_ep_init_t ep = {
+                .type      = i,
+                .endpoint  = j,
+                .init_prio = tree->ep_trees[i][j]->init_prio,
+            };
+            uint16_t pos = dev->init_order_len++;
+            while (pos && dev->init_order[pos - 1].init_prio > ep.init_prio) {
+                dev->init_order[pos] = dev->init_order[pos - 1];
+                pos--;
             }
+            dev->init_order[pos] = ep;
         }
-        ESP_LOGD(TAG, "cur=%d, thr=%d, ep_count=%" PRIu16, cur_prio, thr_prio, ep_count);
-
-        // Run all matching init functions.
-        for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
-            for (int j = 0; j < bsp_dev_get_tree_raw(dev)->ep_counts[i]; j++) {
-                int prio = bsp_dev_get_tree_raw(dev)->ep_trees[i][j]->init_prio;
-                if (prio != cur_prio) {
-                    continue;
-                }
-                ep_count--;
-                if (!dev->ep_drivers[i][j]) {
-                    continue;
-                }
-                if (is_deinit && dev->ep_drivers[i][j]->deinit) {
-                    ESP_LOGD(TAG, "Device %" PRIu32 " %s endpoint %" PRId8 " deinit", dev->id, ep_type_str[i], j);
-                    if (!dev->ep_drivers[i][j]->deinit(dev, j)) {
-                        ESP_LOGE(
-                            TAG,
-                            "Device %" PRIu32 " %s endpoint %" PRId8 " deinit failed",
-                            dev->id,
-                            ep_type_str[i],
-                            j
-                        );
-                    }
-                } else if (!is_deinit && dev->ep_drivers[i][j]->init) {
-                    ESP_LOGD(TAG, "Device %" PRIu32 " %s endpoint %" PRId8 " init", dev->id, ep_type_str[i], j);
-                    if (!dev->ep_drivers[i][j]->init(dev, j)) {
-                        ESP_LOGE(
-                            TAG,
-                            "Device %" PRIu32 " %s endpoint %" PRId8 " init failed",
-                            dev->id,
-                            ep_type_str[i],
-                            j
-                        );
-                    }
-                }
+    }
+}
+
+// Run device init functions.
+// Endpoints with the same priority are initialized in parallel; deinitialization happens in reverse order.
+static void run_init_funcs(bsp_device_t *dev, bool is_deinit) {
+    uint16_t len = dev->init_order_len;
+    uint16_t pos = 0;
+    while (pos < len) {
+        // Find the range of endpoints with the same priority.
+        uint16_t start = is_deinit ? len - 1 - pos : pos;
+        int      prio  = dev->init_order[start].init_prio;
+        uint16_t count = 1;
+        while (pos + count < len) {
+            uint16_t idx = is_deinit ? start - count : start + count;
+            if (dev->init_order[idx].init_prio != prio) {
+                break;
             }
+            count++;
+        }
+        bsp_ep_init_t *eps = &dev->init_order[is_deinit ? start + 1 - count : start];
+        ESP_LOGD(TAG, "prio=%d, count=%" PRIu16, prio, count);
+
+        if (count == 1) {
+            // A level of its own runs on the caller's stack; slow endpoints like displays get one.
+            run_init_func(dev, eps, is_deinit);
+        } else {
+            init_job_run_parallel(dev, eps, count, is_deinit);
         }
 
-        // Increment priority threshold.
-        thr_prio = cur_prio + (is_deinit ? -1 : 1);
+        pos += count;
     }
 }
 
@@ -238,14 +389,57 @@ static ptrdiff_t bsp_find_device(uint32_t dev_id) {
     return -1;
 }
 
+// Set the initial runtime state of input endpoints.
+static void init_input_state(bsp_device_t *dev, bsp_devtree_t const *tree) {
+    for (uint8_t i = 0; i < tree->input_count; i++) {
+        bsp_input_devtree_t const *input_tree = tree->input_dev[i];
+        uint16_t                   period     = input_tree->repeat_period ?: CONFIG_BSP_INPUT_REPEAT_PERIOD;
+        dev->input_state[i]                   = (bsp_input_state_t){
+                              .keymap        = input_tree->keymap,
+                              .repeat_delay  = input_tree->repeat_delay ?: CONFIG_BSP_INPUT_REPEAT_DELAY,
+                              .repeat_period = period == BSP_REPEAT_DISABLED ? 0 : period,
+        };
+    }
+}
+
 // Free all the BSP-managed memory from a device.
 static void bsp_dev_free(bsp_device_t *dev) {
+    rc_delete(dev->tree);
+    bsp_pool_free(&dev_pool, __containerof(dev, dev_block_t, dev));
+}
+
+// Take a device from the pool and point its per-endpoint arrays into it.
+// If `drivers` is true, the device gets its own driver arrays too.
+static bsp_device_t *bsp_dev_alloc(bsp_devtree_t const *tree, bool drivers) {
+    size_t ep_count = 0;
     for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
-        free(dev->ep_aux[i]);
-        free(dev->ep_drivers[i]);
+        ep_count += tree->ep_counts[i];
     }
-    rc_delete(dev->tree);
-    free(dev);
+    if (ep_count > DEV_MAX_EPS) {
+        ESP_LOGE(TAG, "Device has %zu endpoints; increase CONFIG_BSP_DEVICE_MAX_ENDPOINTS", ep_count);
+        return NULL;
+    }
+    dev_block_t *block = bsp_pool_alloc(&dev_pool);
+    if (!block) {
+        return NULL;
+    }
+
+    bsp_device_t *dev = &block->dev;
+    dev->init_order   = block->init_order;
+    dev->input_state  = block->input_state;
+    size_t offset     = 0;
+    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
+        if (!tree->ep_counts[i]) {
+            continue;
+        }
+        dev->ep_aux[i] = block->aux + offset;
+        if (drivers) {
+            dev->ep_drivers[i] = block->drivers + offset;
+        }
+        offset += tree->ep_counts[i];
+    }
+    init_input_state(dev, tree);
+    return dev;
 }
 
 // Unregister an existing device.
@@ -255,7 +449,8 @@ static bool bsp_dev_unregister_int(uint32_t dev_id, bool show_msg) {
     }
 
     ptrdiff_t idx = bsp_find_device(dev_id);
-    if (idx <= 0) {
+    if (idx < 0) {
+        rel_excl();
         return false;
     }
     bsp_device_t *dev = devices[idx];
@@ -266,7 +461,8 @@ static bool bsp_dev_unregister_int(uint32_t dev_id, bool show_msg) {
     // Remove device from the list.
     for (size_t i = 0; i < devices_len; i++) {
         if (devices[i]->id == dev_id) {
-            memcpy(devices + i, devices + i + 1, (devices_len - i - 1) * sizeof(bsp_device_t *));
+            memmove(devices + i, devices + i + 1, (devices_len - i - 1) * sizeof(bsp_device_t *));
+            devices_len--;
             break;
         }
     }
@@ -281,37 +477,15 @@ static bool bsp_dev_unregister_int(uint32_t dev_id, bool show_msg) {
     return true;
 }
 
-// Register a new device and assign an ID to it.
-uint32_t bsp_dev_register(bsp_devtree_t const *tree, bool is_rom) {
-    if (!acq_excl()) {
-        return 0;
-    }
-
-    // Allocate device structure.
-    bsp_device_t *dev = calloc(1, sizeof(bsp_device_t));
-    if (!dev) {
-        return 0;
-    }
-    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
-        if (!tree->ep_counts[i]) {
-            continue;
-        }
-        dev->ep_aux[i]     = calloc(tree->ep_counts[i], sizeof(void *));
-        dev->ep_drivers[i] = calloc(tree->ep_counts[i], sizeof(bsp_driver_common_t const *));
-        if (!dev->ep_aux[i] || !dev->ep_drivers[i]) {
-            bsp_dev_free(dev);
-            return 0;
-        }
-    }
-
-    // Add it to the device list.
-    void *mem = realloc(devices, (devices_len + 1) * sizeof(bsp_device_t *));
-    if (!mem) {
+// Add a device with its drivers installed to the device list, assign an ID and run its init functions.
+// Must be called with the device table held exclusively; frees the device on failure.
+static uint32_t add_device(bsp_device_t *dev, bsp_devtree_t const *tree, bool is_rom) {
+    if (devices_len >= CONFIG_BSP_DEVICE_MAX) {
+        ESP_LOGE(TAG, "Too many devices; increase CONFIG_BSP_DEVICE_MAX");
         bsp_dev_free(dev);
         rel_excl();
         return 0;
     }
-    devices              = mem;
     devices[devices_len] = dev;
     devices_len++;
     dev->id = next_dev_id;
@@ -322,6 +496,26 @@ uint32_t bsp_dev_register(bsp_devtree_t const *tree, bool is_rom) {
     }
     next_dev_id++;
 
+    // Run init functions.
+    run_init_funcs(dev, false);
+    ESP_LOGI(TAG, "Device %" PRId32 " registered", dev->id);
+    rel_excl();
+    return dev->id;
+}
+
+// Register a new device and assign an ID to it.
+uint32_t bsp_dev_register(bsp_devtree_t const *tree, bool is_rom) {
+    if (!acq_excl()) {
+        return 0;
+    }
+
+    bsp_device_t *dev = bsp_dev_alloc(tree, true);
+    if (!dev) {
+        rel_excl();
+        return 0;
+    }
+    compute_init_order(dev, tree);
+
     // Install drivers.
     for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
         for (uint8_t j = 0; j < tree->ep_counts[i]; j++) {
@@ -334,11 +528,30 @@ uint32_t bsp_dev_register(bsp_devtree_t const *tree, bool is_rom) {
         }
     }
 
-    // Run init functions.
-    run_init_funcs(dev, false);
-    ESP_LOGI(TAG, "Device %" PRId32 " registered", dev->id);
-    rel_excl();
-    return dev->id;
+    return add_device(dev, tree, is_rom);
+}
+
+// Register a device tree compiled by `tools/devtree_gen.py` and assign an ID to it.
+// The init order and drivers are taken from the compiled tree; the tree itself is never freed.
+uint32_t bsp_dev_register_compiled(bsp_devtree_compiled_t const *compiled) {
+    bsp_devtree_t const *tree = compiled->tree;
+    if (!acq_excl()) {
+        return 0;
+    }
+
+    bsp_device_t *dev = bsp_dev_alloc(tree, false);
+    if (!dev) {
+        rel_excl();
+        return 0;
+    }
+    memcpy(dev->init_order, compiled->init_order, compiled->init_order_len * sizeof(bsp_ep_init_t));
+    dev->init_order_len = compiled->init_order_len;
+    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
+        // Compiled driver tables are never written to after registration.
+        dev->ep_drivers[i] = (bsp_driver_common_t const **)compiled->drivers[i];
+    }
+
+    return add_device(dev, tree, true);
 }
 
 // Unregister an existing device.
@@ -372,7 +585,7 @@ bool bsp_input_get_raw(uint32_t dev_id, uint8_t endpoint, uint16_t raw_input) {
     bsp_device_t *dev = devices[idx];
     bool          ret = false;
     if (idx >= 0 && endpoint < bsp_dev_get_tree_raw(dev)->input_count && dev->input_drivers[endpoint]) {
-        ret = dev->input_drivers[endpoint]->get_raw(dev, endpoint, raw_input);
+        ret = dispatch_input_get_raw(dev->input_drivers[endpoint], dev, endpoint, raw_input);
     }
     rel_shared();
     return ret;
@@ -397,13 +610,62 @@ void bsp_input_backlight(uint32_t dev_id, uint8_t endpoint, uint16_t pwm) {
     }
     if (dev->led_drivers[endpoint]) {
         uint64_t value = bsp_grey16_to_col(bsp_dev_get_tree_raw(dev)->led_dev[endpoint]->ledfmt.color, pwm);
-        dev->led_drivers[endpoint]->set_raw(dev, endpoint, idx, value);
-        dev->led_drivers[endpoint]->update(dev, endpoint);
+        dispatch_led_set_raw(dev->led_drivers[endpoint], dev, endpoint, idx, value);
+        dispatch_led_update(dev->led_drivers[endpoint], dev, endpoint);
     }
     rel_shared();
 }
 
 
+// Set the keyboard layout used to translate a device's input.
+bool bsp_input_set_keymap(uint32_t dev_id, uint8_t endpoint, bsp_keymap_t const *keymap) {
+    if (!acq_excl()) {
+        return false;
+    }
+    ptrdiff_t idx = bsp_find_device(dev_id);
+    bool      ret = false;
+    if (idx >= 0 && endpoint < bsp_dev_get_tree_raw(devices[idx])->input_count) {
+        devices[idx]->input_state[endpoint].keymap = keymap;
+        ret                                        = true;
+    }
+    rel_excl();
+    return ret;
+}
+
+// Get the keyboard layout used to translate a device's input.
+bsp_keymap_t const *bsp_input_get_keymap(uint32_t dev_id, uint8_t endpoint) {
+    if (!acq_shared()) {
+        return NULL;
+    }
+    ptrdiff_t           idx = bsp_find_device(dev_id);
+    bsp_keymap_t const *ret = NULL;
+    if (idx >= 0 && endpoint < bsp_dev_get_tree_raw(devices[idx])->input_count) {
+        ret = devices[idx]->input_state[endpoint].keymap;
+    }
+    rel_shared();
+    return ret;
+}
+
+// Set a device's key repeat delay and period in milliseconds; a period of 0 disables key repeat.
+bool bsp_input_set_repeat(uint32_t dev_id, uint8_t endpoint, uint16_t delay_ms, uint16_t period_ms) {
+    if (!acq_excl()) {
+        return false;
+    }
+    ptrdiff_t idx = bsp_find_device(dev_id);
+    bool      ret = false;
+    if (idx >= 0 && endpoint < bsp_dev_get_tree_raw(devices[idx])->input_count) {
+        devices[idx]->input_state[endpoint].repeat_delay  = delay_ms;
+        devices[idx]->input_state[endpoint].repeat_period = period_ms;
+        ret                                               = true;
+    }
+    rel_excl();
+    if (ret && !period_ms) {
+        bsp_repeat_stop_all();
+    }
+    return ret;
+}
+
+
 // Set the color of a single LED from 16-bit greyscale.
 void bsp_led_set_grey16(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint16_t value) {
     if (!acq_shared()) {
@@ -417,7 +679,7 @@ void bsp_led_set_grey16(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint16_
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    driver->set_raw(dev, endpoint, led, bsp_grey16_to_col(tree->ledfmt.color, value));
+    dispatch_led_set_raw(driver, dev, endpoint, led, bsp_grey16_to_col(tree->ledfmt.color, value));
     rel_shared();
 }
 
@@ -434,7 +696,7 @@ uint16_t bsp_led_get_grey16(uint32_t dev_id, uint8_t endpoint, uint16_t led) {
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    uint64_t                 raw    = driver->get_raw(dev, endpoint, led);
+    uint64_t                 raw    = dispatch_led_get_raw(driver, dev, endpoint, led);
     rel_shared();
     return bsp_col_to_grey16(tree->ledfmt.color, raw);
 }
@@ -452,7 +714,7 @@ void bsp_led_set_grey8(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint16_t
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    driver->set_raw(dev, endpoint, led, bsp_grey8_to_col(tree->ledfmt.color, value));
+    dispatch_led_set_raw(driver, dev, endpoint, led, bsp_grey8_to_col(tree->ledfmt.color, value));
     rel_shared();
 }
 
@@ -469,7 +731,7 @@ uint16_t bsp_led_get_grey8(uint32_t dev_id, uint8_t endpoint, uint16_t led) {
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    uint64_t                 raw    = driver->get_raw(dev, endpoint, led);
+    uint64_t                 raw    = dispatch_led_get_raw(driver, dev, endpoint, led);
     rel_shared();
     return bsp_col_to_grey8(tree->ledfmt.color, raw);
 }
@@ -487,7 +749,7 @@ void bsp_led_set_rgb48(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint64_t
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    driver->set_raw(dev, endpoint, led, bsp_rgb48_to_col(tree->ledfmt.color, rgb));
+    dispatch_led_set_raw(driver, dev, endpoint, led, bsp_rgb48_to_col(tree->ledfmt.color, rgb));
     rel_shared();
 }
 
@@ -504,7 +766,7 @@ uint64_t bsp_led_get_rgb48(uint32_t dev_id, uint8_t endpoint, uint16_t led) {
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    uint64_t                 raw    = driver->get_raw(dev, endpoint, led);
+    uint64_t                 raw    = dispatch_led_get_raw(driver, dev, endpoint, led);
     rel_shared();
     return bsp_col_to_rgb48(tree->ledfmt.color, raw);
 }
@@ -522,7 +784,7 @@ void bsp_led_set_rgb(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint32_t r
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    driver->set_raw(dev, endpoint, led, bsp_rgb_to_col(tree->ledfmt.color, rgb));
+    dispatch_led_set_raw(driver, dev, endpoint, led, bsp_rgb_to_col(tree->ledfmt.color, rgb));
     rel_shared();
 }
 
@@ -539,7 +801,7 @@ uint32_t bsp_led_get_rgb(uint32_t dev_id, uint8_t endpoint, uint16_t led) {
     }
     bsp_led_devtree_t const *tree   = bsp_dev_get_tree_raw(dev)->led_dev[endpoint];
     bsp_led_driver_t const  *driver = dev->led_drivers[endpoint];
-    uint64_t                 raw    = driver->get_raw(dev, endpoint, led);
+    uint64_t                 raw    = dispatch_led_get_raw(driver, dev, endpoint, led);
     rel_shared();
     return bsp_col_to_rgb(tree->ledfmt.color, raw);
 }
@@ -557,7 +819,7 @@ void bsp_led_set_raw(uint32_t dev_id, uint8_t endpoint, uint16_t led, uint64_t d
         return;
     }
     bsp_led_driver_t const *driver = dev->led_drivers[endpoint];
-    driver->set_raw(dev, endpoint, led, data);
+    dispatch_led_set_raw(driver, dev, endpoint, led, data);
     rel_shared();
 }
 
@@ -573,7 +835,7 @@ uint64_t bsp_led_get_raw(uint32_t dev_id, uint8_t endpoint, uint16_t led) {
         return 0;
     }
     bsp_led_driver_t const *driver = dev->led_drivers[endpoint];
-    uint64_t                raw    = driver->get_raw(dev, endpoint, led);
+    uint64_t                raw    = dispatch_led_get_raw(driver, dev, endpoint, led);
     rel_shared();
     return raw;
 }
@@ -590,7 +852,7 @@ void bsp_led_update(uint32_t dev_id, uint8_t endpoint) {
         return;
     }
     bsp_led_driver_t const *driver = dev->led_drivers[endpoint];
-    driver->update(dev, endpoint);
+    dispatch_led_update(driver, dev, endpoint);
     rel_shared();
 }
 
@@ -603,7 +865,7 @@ void bsp_disp_update(uint32_t dev_id, uint8_t endpoint, void const *framebuffer)
     ptrdiff_t     idx = bsp_find_device(dev_id);
     bsp_device_t *dev = devices[idx];
     if (idx >= 0 && endpoint < bsp_dev_get_tree_raw(dev)->disp_count && dev->disp_drivers[endpoint]) {
-        dev->disp_drivers[endpoint]->update(dev, endpoint, framebuffer);
+        dispatch_disp_update(dev->disp_drivers[endpoint], dev, endpoint, framebuffer);
     }
     rel_shared();
 }
@@ -618,7 +880,7 @@ void bsp_disp_update_part(
     ptrdiff_t     idx = bsp_find_device(dev_id);
     bsp_device_t *dev = devices[idx];
     if (idx >= 0 && endpoint < bsp_dev_get_tree_raw(dev)->disp_count && dev->disp_drivers[endpoint]) {
-        dev->disp_drivers[endpoint]->update_part(dev, endpoint, framebuffer, x, y, w, h);
+        dispatch_disp_update_part(dev->disp_drivers[endpoint], dev, endpoint, framebuffer, x, y, w, h);
     }
     rel_shared();
 }
@@ -642,40 +904,46 @@ void bsp_disp_backlight(uint32_t dev_id, uint8_t endpoint, uint16_t pwm) {
     }
     if (dev->led_drivers[endpoint]) {
         uint64_t value = bsp_grey16_to_col(bsp_dev_get_tree_raw(dev)->led_dev[endpoint]->ledfmt.color, pwm);
-        dev->led_drivers[endpoint]->set_raw(dev, endpoint, idx, value);
-        dev->led_drivers[endpoint]->update(dev, endpoint);
+        dispatch_led_set_raw(dev->led_drivers[endpoint], dev, endpoint, idx, value);
+        dispatch_led_update(dev->led_drivers[endpoint], dev, endpoint);
     }
     rel_shared();
 }
 
 
 
-// Update modifier keys.
-static void update_modkeys(bsp_input_t input, bool pressed) {
-    int index;
+// Get the modifier key bit index for an input, or -1 if it is not a modifier key.
+static int modkey_index_impl(bsp_input_t input) {
     switch (input) {
-        default: return;
-        case BSP_INPUT_L_SHIFT: index = 0; break;
-        case BSP_INPUT_R_SHIFT: index = 1; break;
-        case BSP_INPUT_L_CTRL: index = 6; break;
-        case BSP_INPUT_R_CTRL: index = 7; break;
-        case BSP_INPUT_L_ALT: index = 8; break;
-        case BSP_INPUT_R_ALT: index = 9; break;
-        case BSP_INPUT_FUNCTION: index = 11; break;
-        case BSP_INPUT_NUM_LK: index = 12; break;
-        case BSP_INPUT_CAPS_LK: index = 13; break;
-        case BSP_INPUT_SCROLL_LK: index = 15; break;
+        default: return -1;
+        case BSP_INPUT_L_SHIFT: return 0;
+        case BSP_INPUT_R_SHIFT: return 1;
+        case BSP_INPUT_L_CTRL: return 6;
+        case BSP_INPUT_R_CTRL: return 7;
+        case BSP_INPUT_L_ALT: return 8;
+        case BSP_INPUT_R_ALT: return 9;
+        case BSP_INPUT_FUNCTION: return 11;
+        case BSP_INPUT_NUM_LK: return 12;
+        case BSP_INPUT_CAPS_LK: return 13;
+        case BSP_INPUT_SCROLL_LK: return 15;
+    }
+}
+
+// Update modifier keys.
+static void update_modkeys(int index, bool pressed) {
+    if (index < 0) {
+        return;
     }
     if (pressed && modkey_count[index] < 65535) {
         modkey_count[index]++;
     } else if (!pressed && modkey_count[index]) {
         modkey_count[index]--;
     }
-    uint16_t tmp = 0;
-    for (int i = 0; i < 16; i++) {
-        tmp |= (modkey_count[i] > 0) << i;
+    if (modkey_count[index]) {
+        modkeys |= 1 << index;
+    } else {
+        modkeys &= ~(1 << index);
     }
-    modkeys = tmp;
 }
 
 // Button event to ASCII value.
@@ -744,46 +1012,94 @@ static char input_ascii_impl(bsp_input_t input, uint16_t modkeys) {
     }
 }
 
+// Button event to navigation input.
+static bsp_input_t input_nav_impl(bsp_input_t input, uint16_t modkeys) {
+    switch (input) {
+        default: return input;
+        case BSP_INPUT_ENTER:
+        case BSP_INPUT_NP_ENTER: return BSP_INPUT_ACCEPT;
+        case BSP_INPUT_BACKSPACE:
+        case BSP_INPUT_ESCAPE: return BSP_INPUT_BACK;
+        case BSP_INPUT_TAB: return modkeys & BSP_MODKEY_SHIFT ? BSP_INPUT_PREV : BSP_INPUT_NEXT;
+    }
+}
+
+// Translate a raw button event into a BSP event.
+// Must be called with the device mutex held or from an ISR.
+static void button_event_translate(
+    bsp_device_t *dev, uint8_t endpoint, int input, bool pressed, int64_t timestamp, bsp_event_t *event
+) {
+    bsp_input_state_t const *state  = &dev->input_state[endpoint];
+    bsp_keymap_t const      *keymap = state->keymap;
+    uint16_t                 prev   = modkeys;
+    event->type                     = BSP_EVENT_INPUT;
+    event->input.type               = pressed ? BSP_INPUT_EVENT_PRESS : BSP_INPUT_EVENT_RELEASE;
+    event->input.dev_id             = dev->id;
+    event->input.endpoint           = endpoint;
+    event->input.raw_input          = input;
+    event->input.timestamp          = timestamp;
+    if (!keymap || input < 0 || input >= keymap->max_scancode) {
+        // No keymap; raw input only.
+        event->input.input      = BSP_INPUT_NONE;
+        event->input.nav_input  = BSP_INPUT_NONE;
+        event->input.text_input = 0;
+    } else if (keymap->text) {
+        // Precompiled keymap; translation is a couple of table lookups.
+        update_modkeys(keymap->modkey[input], pressed);
+        int cls                 = bsp_keymap_class(modkeys);
+        int shift               = !!(cls & BSP_KEYMAP_CLASS_SHIFT);
+        event->input.input      = keymap->keymap[input];
+        event->input.nav_input  = keymap->nav[shift * keymap->max_scancode + input];
+        event->input.text_input = keymap->text[cls * keymap->max_scancode + input];
+    } else {
+        // Plain keymap; translate at runtime.
+        event->input.input = keymap->keymap[input];
+        update_modkeys(modkey_index_impl(event->input.input), pressed);
+        event->input.nav_input  = input_nav_impl(event->input.input, modkeys);
+        event->input.text_input = input_ascii_impl(event->input.input, modkeys);
+    }
+    event->input.modkeys = modkeys;
+
+    // Modifier changes cancel key repeat; only other keys start it.
+    if (modkeys != prev) {
+        bsp_repeat_stop_all();
+    } else if (!pressed) {
+        bsp_repeat_stop(dev->id, endpoint, input);
+    } else if (state->repeat_period) {
+        bsp_repeat_start(event, state->repeat_delay, state->repeat_period);
+    }
+}
+
+// Get an input endpoint's device, or NULL if it does not exist or has no driver.
+static bsp_device_t *button_event_device(uint32_t dev_id, uint8_t endpoint) {
+    ptrdiff_t idx = bsp_find_device(dev_id);
+    if (idx < 0) {
+        return NULL;
+    }
+    bsp_device_t *dev = devices[idx];
+    if (endpoint >= bsp_dev_get_tree_raw(dev)->input_count || !dev->input_drivers[endpoint]) {
+        return NULL;
+    }
+    return dev;
+}
+
 // Button event implementation.
 static void button_event_impl(uint32_t dev_id, uint8_t endpoint, int input, bool pressed, bool from_isr) {
+    int64_t timestamp = esp_timer_get_time();
     if (!from_isr && !acq_shared()) {
         return;
     }
-    ptrdiff_t     idx = bsp_find_device(dev_id);
-    bsp_device_t *dev = devices[idx];
-    if (idx < 0 || endpoint >= bsp_dev_get_tree_raw(dev)->input_count || !dev->input_drivers[endpoint]) {
-        if (!from_isr) {
-            rel_shared();
+    bsp_device_t *dev = button_event_device(dev_id, endpoint);
+    if (dev) {
+        bsp_event_t event;
+        button_event_translate(dev, endpoint, input, pressed, timestamp, &event);
+        if (from_isr) {
+            bsp_event_queue_from_isr(&event);
+        } else {
+            bsp_event_queue(&event);
         }
-        return;
     }
-    bsp_input_devtree_t const *tree = bsp_dev_get_tree_raw(dev)->input_dev[endpoint];
-    bsp_event_t                event;
-    event.type            = BSP_EVENT_INPUT;
-    event.input.type      = pressed ? BSP_INPUT_EVENT_PRESS : BSP_INPUT_EVENT_RELEASE;
-    event.input.dev_id    = dev_id;
-    event.input.endpoint  = endpoint;
-    event.input.raw_input = input;
-    if (tree->keymap && input < tree->keymap->max_scancode) {
-        event.input.input = tree->keymap->keymap[input];
-        update_modkeys(event.input.input, pressed);
-        event.input.text_input = input_ascii_impl(event.input.input, modkeys);
-    } else {
-        event.input.input = BSP_INPUT_NONE;
-    }
-    event.input.modkeys = modkeys;
-    switch (event.input.input) {
-        default: event.input.nav_input = event.input.input; break;
-        case BSP_INPUT_ENTER:
-        case BSP_INPUT_NP_ENTER: event.input.nav_input = BSP_INPUT_ACCEPT; break;
-        case BSP_INPUT_BACKSPACE:
-        case BSP_INPUT_ESCAPE: event.input.nav_input = BSP_INPUT_BACK; break;
-        case BSP_INPUT_TAB: event.input.nav_input = modkeys & BSP_MODKEY_SHIFT ? BSP_INPUT_PREV : BSP_INPUT_NEXT; break;
-    }
-    if (from_isr) {
-        bsp_event_queue(&event);
-    } else {
-        bsp_event_queue_from_isr(&event);
+    if (!from_isr) {
         rel_shared();
     }
 }
@@ -810,6 +1126,47 @@ void bsp_raw_button_released_from_isr(uint32_t dev_id, uint8_t endpoint, int inp
 
 
 
+// Notify the BSP of multiple button presses and/or releases at once.
+// More efficient than calling `bsp_raw_button_pressed` / `bsp_raw_button_released` for every button.
+void bsp_raw_button_batch(uint32_t dev_id, uint8_t endpoint, bsp_raw_button_t const *buttons, size_t buttons_len) {
+    if (!buttons_len || !acq_shared()) {
+        return;
+    }
+    bsp_device_t *dev = button_event_device(dev_id, endpoint);
+    if (!dev) {
+        rel_shared();
+        return;
+    }
+    int64_t     now = esp_timer_get_time();
+    bsp_event_t events[BSP_RAW_BUTTON_BATCH_MAX];
+    while (buttons_len) {
+        size_t count = buttons_len < BSP_RAW_BUTTON_BATCH_MAX ? buttons_len : BSP_RAW_BUTTON_BATCH_MAX;
+        for (size_t i = 0; i < count; i++) {
+            int64_t timestamp = buttons[i].timestamp ?: now;
+            button_event_translate(dev, endpoint, buttons[i].input, buttons[i].pressed, timestamp, &events[i]);
+        }
+        bsp_event_queue_many(events, count);
+        buttons     += count;
+        buttons_len -= count;
+    }
+    rel_shared();
+}
+
+
+// Obtain a copy of a device's devtree that can be cleaned up with `free()`.
+bsp_devtree_t *bsp_dev_clone_devtree(uint32_t dev_id) {
+    if (!acq_shared()) {
+        return NULL;
+    }
+    bsp_devtree_t *clone = NULL;
+    ptrdiff_t      idx   = bsp_find_device(dev_id);
+    if (idx >= 0) {
+        clone = bsp_devtree_clone(bsp_dev_get_tree_raw(devices[idx]));
+    }
+    rel_shared();
+    return clone;
+}
+
 // Obtain a share of the device tree shared pointer that can be cleaned up with `rc_delete()`.
 rc_t bsp_dev_get_devtree(uint32_t dev_id) {
     if (!acq_shared()) {
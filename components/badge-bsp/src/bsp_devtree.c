@@ -0,0 +1,318 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp_devtree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+static char const TAG[] = "bsp-devtree";
+
+
+
+// Round `x` up to a multiple of `align`, which must be a power of two.
+#define ALIGN_UP(x, align) (((x) + (align) - 1) & ~((size_t)(align) - 1))
+
+// Device tree blob magic.
+#define BLOB_MAGIC   "BSPDTREE"
+// Device tree blob format version.
+#define BLOB_VERSION 1
+
+// Device tree blob header; followed by the flattened tree with pointers stored as offsets from the tree.
+typedef struct {
+    // Magic; `BLOB_MAGIC`.
+    char     magic[8];
+    // Blob format version.
+    uint32_t version;
+    // Size of the flattened tree after the header.
+    uint32_t size;
+    // Size of a pointer, to detect blobs made for a different machine.
+    uint16_t ptr_size;
+    // Size of the endpoint trees per type, to detect blobs of a different build.
+    uint16_t ep_size[BSP_EP_TYPE_COUNT];
+} blob_header_t;
+
+// State of copying a device tree into a single block.
+typedef struct {
+    // Output block, or NULL when only measuring the tree.
+    char  *base;
+    // Number of bytes used so far.
+    size_t size;
+    // Store pointers as offsets from `base` instead of addresses.
+    bool   offsets;
+} flat_t;
+
+// State of turning offsets in a flattened tree back into pointers.
+typedef struct {
+    // Flattened tree.
+    char  *base;
+    // Size of the flattened tree.
+    size_t size;
+} unflat_t;
+
+// Size of the endpoint trees per type.
+static size_t const ep_size[] = {
+    sizeof(bsp_input_devtree_t),
+    sizeof(bsp_led_devtree_t),
+    sizeof(bsp_display_devtree_t),
+    sizeof(bsp_audio_devtree_t),
+};
+
+// Alignment of the endpoint trees per type.
+static size_t const ep_align[] = {
+    _Alignof(bsp_input_devtree_t),
+    _Alignof(bsp_led_devtree_t),
+    _Alignof(bsp_display_devtree_t),
+    _Alignof(bsp_audio_devtree_t),
+};
+
+
+
+// Reserve space in the block and copy `src` into it if not NULL.
+// Returns NULL while measuring.
+static void *flat_alloc(flat_t *flat, void const *src, size_t size, size_t align) {
+    flat->size = ALIGN_UP(flat->size, align);
+    void *ptr  = NULL;
+    if (flat->base) {
+        ptr = flat->base + flat->size;
+        if (src) {
+            memcpy(ptr, src, size);
+        }
+    }
+    flat->size += size;
+    return ptr;
+}
+
+// Get the value to store for a pointer into the block.
+static void const *flat_ref(flat_t const *flat, void const *ptr) {
+    if (!ptr || !flat->offsets) {
+        return ptr;
+    }
+    return (void const *)((char const *)ptr - flat->base);
+}
+
+// Copy an array into the block if it isn't NULL and get the value to store for it.
+static void const *flat_array(flat_t *flat, void const *src, size_t size, size_t align) {
+    if (!src) {
+        return NULL;
+    }
+    return flat_ref(flat, flat_alloc(flat, src, size, align));
+}
+
+// Copy the data referenced by an input endpoint tree into the block.
+static bool flatten_input(flat_t *flat, bsp_input_devtree_t *out, bsp_input_devtree_t const *in) {
+    if (in->pinmap) {
+        bsp_pinmap_t const *pinmap = in->pinmap;
+        bsp_pinmap_t       *copy   = flat_alloc(flat, pinmap, sizeof(bsp_pinmap_t), _Alignof(bsp_pinmap_t));
+        void const         *pins   = flat_array(flat, pinmap->pins, pinmap->pins_len, 1);
+        void const         *debounce =
+            flat_array(flat, pinmap->debounce_ms, pinmap->pins_len * sizeof(uint16_t), _Alignof(uint16_t));
+        if (copy) {
+            copy->pins        = pins;
+            copy->debounce_ms = debounce;
+            out->pinmap       = flat_ref(flat, copy);
+        }
+    }
+    if (in->keymap && flat->offsets) {
+        // Keymaps live in the firmware, so blobs refer to them by name.
+        if (!in->keymap->name) {
+            ESP_LOGE(TAG, "Cannot serialize a keymap without a name");
+            return false;
+        }
+        void const *name = flat_array(flat, in->keymap->name, strlen(in->keymap->name) + 1, 1);
+        if (out) {
+            out->keymap = name;
+        }
+    }
+    return true;
+}
+
+// Copy a device tree into the block, or measure its size if `flat->base` is NULL.
+static bool flatten(flat_t *flat, bsp_devtree_t const *tree) {
+    bsp_devtree_t *out = flat_alloc(flat, tree, sizeof(bsp_devtree_t), _Alignof(bsp_devtree_t));
+    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
+        uint8_t count = tree->ep_counts[i];
+        if (!count) {
+            if (out) {
+                out->ep_trees[i] = NULL;
+            }
+            continue;
+        }
+        void const **eps = flat_alloc(flat, NULL, count * sizeof(void *), _Alignof(void *));
+        if (out) {
+            out->ep_trees[i] = flat_ref(flat, eps);
+        }
+        for (uint8_t j = 0; j < count; j++) {
+            void *ep = flat_alloc(flat, tree->ep_trees[i][j], ep_size[i], ep_align[i]);
+            if (eps) {
+                eps[j] = flat_ref(flat, ep);
+            }
+            if (i == BSP_EP_INPUT && !flatten_input(flat, ep, tree->input_dev[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Turn an offset into a pointer after checking that `size` bytes at it are within the tree.
+// Offset 0 is the tree itself, so it is used for NULL.
+static bool unflat_ref(unflat_t const *unflat, void const **ptr, size_t size, size_t align) {
+    uintptr_t off = (uintptr_t)*ptr;
+    if (!off) {
+        return true;
+    } else if (off > unflat->size || size > unflat->size - off || off % align) {
+        return false;
+    }
+    *ptr = unflat->base + off;
+    return true;
+}
+
+// Turn the offsets of an input endpoint tree into pointers and look up its keymap.
+static bool unflatten_input(unflat_t const *unflat, bsp_input_devtree_t *ep) {
+    void const *ref = ep->pinmap;
+    if (!unflat_ref(unflat, &ref, sizeof(bsp_pinmap_t), _Alignof(bsp_pinmap_t))) {
+        return false;
+    }
+    ep->pinmap = ref;
+    if (ep->pinmap) {
+        bsp_pinmap_t *pinmap = (bsp_pinmap_t *)ep->pinmap;
+        ref                  = pinmap->pins;
+        if (!unflat_ref(unflat, &ref, pinmap->pins_len, 1) || (pinmap->pins_len && !ref)) {
+            return false;
+        }
+        pinmap->pins = ref;
+        ref          = pinmap->debounce_ms;
+        if (!unflat_ref(unflat, &ref, pinmap->pins_len * sizeof(uint16_t), _Alignof(uint16_t))) {
+            return false;
+        }
+        pinmap->debounce_ms = ref;
+    }
+
+    ref = ep->keymap;
+    if (!unflat_ref(unflat, &ref, 1, 1)) {
+        return false;
+    }
+    if (ref) {
+        char const *name = ref;
+        if (!memchr(name, 0, unflat->base + unflat->size - name)) {
+            return false;
+        }
+        ep->keymap = bsp_keymap_find(name);
+        if (!ep->keymap) {
+            ESP_LOGE(TAG, "Keymap %s not found", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Turn the offsets of a flattened tree into pointers.
+static bool unflatten(unflat_t const *unflat) {
+    bsp_devtree_t *tree = (bsp_devtree_t *)unflat->base;
+    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
+        uint8_t     count = tree->ep_counts[i];
+        void const *ref   = tree->ep_trees[i];
+        if (!unflat_ref(unflat, &ref, count * sizeof(void *), _Alignof(void *)) || (count && !ref)) {
+            return false;
+        }
+        tree->ep_trees[i] = ref;
+        void const **eps  = (void const **)ref;
+        for (uint8_t j = 0; j < count; j++) {
+            if (!unflat_ref(unflat, &eps[j], ep_size[i], ep_align[i]) || !eps[j]) {
+                return false;
+            }
+            if (i == BSP_EP_INPUT && !unflatten_input(unflat, (bsp_input_devtree_t *)eps[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+
+// Create a copy of the device tree that can be cleaned up with `free()`.
+bsp_devtree_t *bsp_devtree_clone(bsp_devtree_t const *devtree) {
+    flat_t flat = {0};
+    flatten(&flat, devtree);
+    flat.base = malloc(flat.size);
+    if (!flat.base) {
+        return NULL;
+    }
+    flat.size = 0;
+    flatten(&flat, devtree);
+    return (bsp_devtree_t *)flat.base;
+}
+
+// Serialize a device tree into a blob that can be cleaned up with `free()`.
+void *bsp_devtree_serialize(bsp_devtree_t const *devtree, size_t *size_out) {
+    flat_t flat = {.offsets = true};
+    if (!flatten(&flat, devtree)) {
+        return NULL;
+    }
+    size_t size = flat.size;
+    char  *blob = malloc(sizeof(blob_header_t) + size);
+    // Flatten into a separate block so the tree is aligned regardless of the header size.
+    flat.base   = calloc(1, size);
+    if (!blob || !flat.base) {
+        free(blob);
+        free(flat.base);
+        return NULL;
+    }
+    flat.size = 0;
+    flatten(&flat, devtree);
+
+    blob_header_t header = {
+        .magic    = BLOB_MAGIC,
+        .version  = BLOB_VERSION,
+        .size     = size,
+        .ptr_size = sizeof(void *),
+    };
+    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
+        header.ep_size[i] = ep_size[i];
+    }
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), flat.base, size);
+    free(flat.base);
+    *size_out = sizeof(header) + size;
+    return blob;
+}
+
+// Deserialize a device tree blob into a copy that can be cleaned up with `free()`.
+bsp_devtree_t *bsp_devtree_deserialize(void const *blob, size_t blob_size) {
+    blob_header_t header;
+    if (blob_size < sizeof(header)) {
+        return NULL;
+    }
+    memcpy(&header, blob, sizeof(header));
+    if (memcmp(header.magic, BLOB_MAGIC, sizeof(header.magic)) || header.version != BLOB_VERSION ||
+        header.ptr_size != sizeof(void *) || header.size < sizeof(bsp_devtree_t) ||
+        header.size > blob_size - sizeof(header)) {
+        ESP_LOGE(TAG, "Invalid device tree blob");
+        return NULL;
+    }
+    for (int i = 0; i < BSP_EP_TYPE_COUNT; i++) {
+        if (header.ep_size[i] != ep_size[i]) {
+            ESP_LOGE(TAG, "Device tree blob is from a different build");
+            return NULL;
+        }
+    }
+
+    unflat_t unflat = {
+        .base = malloc(header.size),
+        .size = header.size,
+    };
+    if (!unflat.base) {
+        return NULL;
+    }
+    memcpy(unflat.base, (char const *)blob + sizeof(header), header.size);
+    if (!unflatten(&unflat)) {
+        ESP_LOGE(TAG, "Corrupt device tree blob");
+        free(unflat.base);
+        return NULL;
+    }
+    return (bsp_devtree_t *)unflat.base;
+}
@@ -2,65 +2,734 @@
 // SPDX-License-Identifier: MIT
 
 #include "bsp.h"
+#include "bsp_latency.h"
+#include "bsp/alloc_count.h"
+#include "bsp/pool.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
-#include "list.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
+#include <stdatomic.h>
+#include <string.h>
 
 
+
+// Number of callback buckets; one per event type plus one for `BSP_EVENT_ANY`.
+#define CB_BUCKETS (BSP_EVENT_TYPE_COUNT + 1)
+
 // Callback list entry.
 typedef struct {
-    dlist_node_t     node;
-    bsp_event_type_t filter;
-    bsp_event_cb_t   func;
-    void            *cookie;
+    // Unique ID, also used as handle.
+    uint32_t       id;
+    // Priority; higher priority callbacks run first.
+    int            prio;
+    bsp_event_cb_t func;
+    void          *cookie;
+    // Removed; skipped by the event thread and left out of the next list if this one couldn't be replaced yet.
+    atomic_bool    dead;
 } cb_ent_t;
 
-static dlist_t       callbacks;
-static QueueHandle_t incoming_queue;
-static QueueHandle_t outgoing_queue;
-static TaskHandle_t  event_thread_handle;
+// List of callbacks sorted by priority.
+// Lists are never changed once published except for marking entries dead; they are replaced as a whole and freed
+// when no longer in use.
+typedef struct cb_list cb_list_t;
+struct cb_list {
+    // Next retired list waiting to be freed.
+    cb_list_t *next_retired;
+    // Dispatch epoch at which this list was retired.
+    uint32_t   retire_epoch;
+    // Number of callbacks.
+    size_t     len;
+    // Callbacks.
+    cb_ent_t   ents[CONFIG_BSP_EVENT_CALLBACK_MAX];
+};
+
+// Number of callback lists; one in use per bucket, plus as many retired ones.
+// Adding a callback waits for retired lists to become reusable if that isn't enough, see `cb_wait_dispatch`.
+#define CB_POOL_LEN (CB_BUCKETS * 2)
+// Pool of callback lists.
+BSP_POOL_DEFINE(cb_pool, cb_list_t, CB_POOL_LEN);
+
+// Number of events in the event ring; must be a power of 2.
+#define EVENT_RING_LEN CONFIG_BSP_EVENT_QUEUE_DEPTH
+_Static_assert((EVENT_RING_LEN & (EVENT_RING_LEN - 1)) == 0, "CONFIG_BSP_EVENT_QUEUE_DEPTH must be a power of 2");
+// Maximum number of key presses whose release is being coalesced away.
+#define SUPPRESS_MAX   8
+// Maximum number of held keys; the ring keeps a slot free for the release of each.
+#define HELD_MAX       (EVENT_RING_LEN / 2)
+// Maximum number of key releases waiting for a consumer to finish freeing their slot.
+#define PENDING_MAX    8
+
+#if CONFIG_BSP_EVENT_OVERFLOW_DROP_NEWEST
+#define DEFAULT_OVERFLOW BSP_EVENT_OVERFLOW_DROP_NEWEST
+#elif CONFIG_BSP_EVENT_OVERFLOW_COALESCE
+#define DEFAULT_OVERFLOW BSP_EVENT_OVERFLOW_COALESCE
+#elif CONFIG_BSP_EVENT_OVERFLOW_BLOCK
+#define DEFAULT_OVERFLOW BSP_EVENT_OVERFLOW_BLOCK
+#else
+#define DEFAULT_OVERFLOW BSP_EVENT_OVERFLOW_DROP_OLDEST
+#endif
+
+// Event ring slot.
+// The sequence number tells which stage the slot is in; for position `pos`:
+// `pos` means free, `pos + 1` means written by a producer, `pos + 2` means dispatched to the callbacks.
+// After a consumer reads it, the sequence number becomes `pos + EVENT_RING_LEN` for the next lap.
+typedef struct {
+    // Sequence number.
+    atomic_uint seq;
+    // Event stored in this slot.
+    bsp_event_t event;
+} ring_slot_t;
+
+static TaskHandle_t      event_thread_handle;
+// Given by the event thread when new events are ready for consumers.
+static SemaphoreHandle_t ready_sem;
+
+// Event ring.
+static ring_slot_t ring[EVENT_RING_LEN];
+// Next position producers will write to.
+static atomic_uint ring_head;
+// Next position the event thread will dispatch; only accessed by the event thread.
+static uint32_t    ring_dispatch;
+// Next position consumers will read from.
+static atomic_uint ring_tail;
+
+// Protects callback registration.
+static SemaphoreHandle_t  cb_mtx;
+// Callback lists per event type; index 0 is for `BSP_EVENT_ANY`.
+static cb_list_t *_Atomic cb_buckets[CB_BUCKETS];
+// Incremented by the event thread before and after running callbacks; odd while running them.
+static atomic_uint        dispatch_epoch;
+// Callback lists that were replaced but may still be in use by the event thread.
+static cb_list_t         *cb_retired;
+// Whether `cb_retired` is not empty.
+static atomic_bool        cb_retired_pending;
+// Next callback ID to be handed out.
+static uint32_t           next_cb_id = 1;
+
+// Current overflow policy.
+static bsp_event_overflow_t overflow_policy = DEFAULT_OVERFLOW;
+// Given by consumers when space frees up while producers are waiting for it.
+static SemaphoreHandle_t    space_sem;
+// Number of producers waiting for space.
+static atomic_int           space_waiters;
+
+// Event types returned by `bsp_event_wait`; other types only go to callbacks.
+static atomic_uint wait_filter = BSP_EVENT_MASK(BSP_EVENT_INPUT);
+
+// Spinlock that protects adding events to the ring and the suppressed, held and pending keys.
+static portMUX_TYPE      suppress_lock = portMUX_INITIALIZER_UNLOCKED;
+// Number of keys of which the press was coalesced away.
+static atomic_size_t     suppress_len;
+// Keys of which the press was coalesced away; their hold and release events will be too.
+static bsp_input_event_t suppress[SUPPRESS_MAX];
+// Number of keys of which the press is in the ring and the release is yet to come; protected by `suppress_lock`.
+static size_t            held_len;
+// Keys of which the press is in the ring; the ring always has space left for their releases.
+static bsp_input_event_t held[HELD_MAX];
+// Number of key releases waiting for space in the ring; protected by `suppress_lock`.
+static atomic_size_t     pending_len;
+// Key releases waiting for space in the ring, oldest first; other events of their keys are left out meanwhile.
+static bsp_input_event_t pending[PENDING_MAX];
+
+// Number of events added to the queue.
+static atomic_uint stat_enqueued;
+// Number of events lost because the queue was full.
+static atomic_uint stat_dropped;
+// Number of events left out because they were redundant.
+static atomic_uint stat_coalesced;
+// Number of times a producer had to wait for space.
+static atomic_uint stat_blocked;
+// Number of key releases lost despite the space kept for them.
+static atomic_uint stat_lost_releases;
+
+
+
+// Claim the slot at a ring index if its sequence number matches `stage` steps after the index.
+// Returns the slot if claimed, NULL if the ring has no slots in the required stage.
+static ring_slot_t *ring_claim(atomic_uint *index, uint32_t stage, uint32_t *pos_out) {
+    uint32_t pos = atomic_load_explicit(index, memory_order_relaxed);
+    while (1) {
+        ring_slot_t *slot = &ring[pos % EVENT_RING_LEN];
+        uint32_t     seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t      diff = (int32_t)(seq - (pos + stage));
+        if (diff < 0) {
+            return NULL;
+        } else if (diff > 0) {
+            // Another producer or consumer got here first.
+            pos = atomic_load_explicit(index, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(
+                       index, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed
+                   )) {
+            *pos_out = pos;
+            return slot;
+        }
+    }
+}
+
+// Whether an event is a key release, which must never be dropped or keys would appear stuck.
+static bool is_release(bsp_event_t const *event) {
+    return event->type == BSP_EVENT_INPUT && event->input.type == BSP_INPUT_EVENT_RELEASE;
+}
+
+// Discard the oldest dispatched event to make space, unless it is a key release.
+// Returns false if the oldest event is a release or hasn't been dispatched yet.
+static bool ring_drop_oldest() {
+    uint32_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    while (1) {
+        ring_slot_t *slot = &ring[pos % EVENT_RING_LEN];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 2) {
+            return false;
+        } else if (is_release(&slot->event)) {
+            // If another consumer took the slot in the meantime, the check is repeated for the next one.
+            uint32_t now = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+            if (now == pos) {
+                return false;
+            }
+            pos = now;
+        } else if (atomic_compare_exchange_weak_explicit(
+                       &ring_tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed
+                   )) {
+            // The slot can't have been rewritten since its type was checked, as only claiming it frees it.
+            break;
+        }
+    }
+    atomic_store_explicit(&ring[pos % EVENT_RING_LEN].seq, pos + EVENT_RING_LEN, memory_order_release);
+    return true;
+}
+
+// Write an event into the ring; safe to use from interrupt handlers.
+static bool ring_push(bsp_event_t const *event) {
+    uint32_t     pos;
+    ring_slot_t *slot = ring_claim(&ring_head, 0, &pos);
+    if (!slot) {
+        return false;
+    }
+    slot->event = *event;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+// Whether two input events are about the same key.
+static bool same_key(bsp_input_event_t const *a, bsp_input_event_t const *b) {
+    return a->dev_id == b->dev_id && a->endpoint == b->endpoint && a->raw_input == b->raw_input;
+}
+
+// Whether `len` more events fit in the ring besides the releases of the held keys; `suppress_lock` must be held.
+static bool ring_fits(size_t len) {
+    // Read the tail first so a concurrent consumer can only make the ring look fuller than it is.
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    return head - tail + held_len + len <= EVENT_RING_LEN;
+}
+
+// Add an event to the ring, keeping space for the releases of the held keys so they can't be lost.
+// A press only fits if its release will too; `*reserved` tells whether a release had space kept for it.
+static bool ring_admit(bsp_event_t const *event, bool *reserved) {
+    *reserved = false;
+    bool   success;
+    size_t i = 0;
+    taskENTER_CRITICAL_SAFE(&suppress_lock);
+    if (event->type == BSP_EVENT_INPUT) {
+        while (i < held_len && !same_key(&held[i], &event->input)) i++;
+    }
+    if (i < held_len && event->input.type == BSP_INPUT_EVENT_RELEASE) {
+        // The space kept for this release is certainly free, unless a consumer is still copying out of it.
+        held[i]   = held[--held_len];
+        *reserved = true;
+        success   = ring_push(event);
+    } else if (event->type == BSP_EVENT_INPUT && event->input.type == BSP_INPUT_EVENT_PRESS && i == held_len) {
+        success = held_len < HELD_MAX && ring_fits(2) && ring_push(event);
+        if (success) {
+            held[held_len++] = event->input;
+        }
+    } else {
+        success = ring_fits(1) && ring_push(event);
+    }
+    taskEXIT_CRITICAL_SAFE(&suppress_lock);
+    return success;
+}
+
+// Check whether an event belongs to a key of which the press was coalesced away.
+// A release event also ends the suppression.
+static bool suppress_check(bsp_event_t const *event) {
+    if (event->type != BSP_EVENT_INPUT || event->input.type == BSP_INPUT_EVENT_PRESS) {
+        return false;
+    }
+    bool found = false;
+    taskENTER_CRITICAL_SAFE(&suppress_lock);
+    size_t len = atomic_load_explicit(&suppress_len, memory_order_relaxed);
+    for (size_t i = 0; i < len; i++) {
+        if (same_key(&suppress[i], &event->input)) {
+            if (event->input.type == BSP_INPUT_EVENT_RELEASE) {
+                suppress[i] = suppress[len - 1];
+                atomic_store_explicit(&suppress_len, len - 1, memory_order_relaxed);
+            }
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL_SAFE(&suppress_lock);
+    return found;
+}
+
+// Try to coalesce away an event that doesn't fit in the queue.
+// Returns true for key repeats and for presses of which the hold and release events will be left out too.
+static bool coalesce(bsp_event_t const *event) {
+    if (event->type != BSP_EVENT_INPUT || event->input.type == BSP_INPUT_EVENT_RELEASE) {
+        // Releases must not be lost or keys would get stuck.
+        return false;
+    } else if (event->input.type == BSP_INPUT_EVENT_HOLD) {
+        // Key repeats are redundant.
+        return true;
+    }
+    // Leave out the press and remember to also leave out the matching release.
+    bool added = false;
+    taskENTER_CRITICAL_SAFE(&suppress_lock);
+    size_t len = atomic_load_explicit(&suppress_len, memory_order_relaxed);
+    if (len < SUPPRESS_MAX) {
+        suppress[len] = event->input;
+        atomic_store_explicit(&suppress_len, len + 1, memory_order_relaxed);
+        added = true;
+    }
+    taskEXIT_CRITICAL_SAFE(&suppress_lock);
+    return added;
+}
+
+// Drop the oldest dispatched event other than a key release and add an event in its place.
+static bool drop_oldest_push(bsp_event_t const *event) {
+    if (!ring_drop_oldest()) {
+        return false;
+    }
+    atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+    bool reserved;
+    return ring_admit(event, &reserved);
+}
+
+// Keep a key release that didn't fit in its kept space until the consumer using it is done; see `pending_flush`.
+static bool pending_add(bsp_event_t const *event) {
+    bool added = false;
+    taskENTER_CRITICAL_SAFE(&suppress_lock);
+    size_t len = atomic_load_explicit(&pending_len, memory_order_relaxed);
+    if (len < PENDING_MAX) {
+        pending[len] = event->input;
+        atomic_store_explicit(&pending_len, len + 1, memory_order_relaxed);
+        added = true;
+    }
+    taskEXIT_CRITICAL_SAFE(&suppress_lock);
+    return added;
+}
+
+// Check whether an event belongs to a key of which the release is waiting for space.
+// Such events are left out so they can't overtake the release; a press also has its hold and release left out.
+static bool pending_check(bsp_event_t const *event) {
+    if (event->type != BSP_EVENT_INPUT) {
+        return false;
+    }
+    bool found = false;
+    taskENTER_CRITICAL_SAFE(&suppress_lock);
+    size_t len = atomic_load_explicit(&pending_len, memory_order_relaxed);
+    for (size_t i = 0; i < len && !found; i++) {
+        found = same_key(&pending[i], &event->input);
+    }
+    taskEXIT_CRITICAL_SAFE(&suppress_lock);
+    if (found && event->input.type == BSP_INPUT_EVENT_PRESS) {
+        coalesce(event);
+    }
+    return found;
+}
+
+// Move key releases waiting for space into the ring, oldest first; returns whether any were moved.
+// Their space was kept when their presses were added, so this doesn't check `ring_fits`.
+static bool pending_flush() {
+    size_t moved = 0;
+    taskENTER_CRITICAL_SAFE(&suppress_lock);
+    size_t len = atomic_load_explicit(&pending_len, memory_order_relaxed);
+    while (moved < len) {
+        bsp_event_t event = {.type = BSP_EVENT_INPUT, .input = pending[moved]};
+        if (!ring_push(&event)) {
+            break;
+        }
+        moved++;
+    }
+    memmove(pending, pending + moved, (len - moved) * sizeof(*pending));
+    atomic_store_explicit(&pending_len, len - moved, memory_order_relaxed);
+    taskEXIT_CRITICAL_SAFE(&suppress_lock);
+    return moved != 0;
+}
+
+// Read up to `max` dispatched events from the ring, claiming them all at once.
+// Key releases waiting for space are moved into the space this frees.
+static size_t ring_pop_many(bsp_event_t *events_out, size_t max) {
+    uint32_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    size_t   count;
+    while (1) {
+        count = 0;
+        while (count < max) {
+            uint32_t seq = atomic_load_explicit(&ring[(pos + count) % EVENT_RING_LEN].seq, memory_order_acquire);
+            if (seq != pos + count + 2) {
+                break;
+            }
+            count++;
+        }
+        if (count == 0) {
+            uint32_t seq = atomic_load_explicit(&ring[pos % EVENT_RING_LEN].seq, memory_order_acquire);
+            if ((int32_t)(seq - (pos + 2)) <= 0) {
+                return 0;
+            }
+            // Another consumer got here first.
+            pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(
+                       &ring_tail, &pos, pos + count, memory_order_relaxed, memory_order_relaxed
+                   )) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ring_slot_t *slot = &ring[(pos + i) % EVENT_RING_LEN];
+        events_out[i]     = slot->event;
+        atomic_store_explicit(&slot->seq, pos + i + EVENT_RING_LEN, memory_order_release);
+    }
+    if (atomic_load_explicit(&pending_len, memory_order_relaxed) && pending_flush()) {
+        xTaskNotifyGive(event_thread_handle);
+    }
+    if (atomic_load_explicit(&space_waiters, memory_order_relaxed)) {
+        xSemaphoreGive(space_sem);
+    }
+    return count;
+}
+
+// Whether an event is left out because it belongs to a coalesced press or a key with a release waiting for space.
+static bool left_out(bsp_event_t const *event) {
+    if (atomic_load_explicit(&suppress_len, memory_order_relaxed) && suppress_check(event)) {
+        return true;
+    }
+    return atomic_load_explicit(&pending_len, memory_order_relaxed) && pending_check(event);
+}
+
+// Wait for a limited time until an event fits in the ring.
+static bool block_push(bsp_event_t const *event, TickType_t ticks) {
+    atomic_fetch_add_explicit(&stat_blocked, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&space_waiters, 1, memory_order_relaxed);
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    bool success, reserved;
+    while (!(success = ring_admit(event, &reserved)) && xTaskCheckForTimeOut(&timeout, &ticks) == pdFALSE) {
+        xSemaphoreTake(space_sem, ticks);
+    }
+    atomic_fetch_sub_explicit(&space_waiters, 1, memory_order_relaxed);
+    return success;
+}
+
+// Add a key release that didn't fit, regardless of the overflow policy.
+// If space was kept for it, it is only taken by a consumer that is still copying out of it,
+// so the release waits for that consumer; otherwise its press never made it into the ring and it can be dropped.
+static bool release_push(bsp_event_t const *event, bool reserved) {
+    if (!reserved) {
+        return drop_oldest_push(event);
+    } else if (pending_add(event)) {
+        return true;
+    }
+    atomic_fetch_add_explicit(&stat_lost_releases, 1, memory_order_relaxed);
+    return false;
+}
+
+// Add an event to the ring, applying the overflow policy if it is full.
+// Key releases are never dropped to make space, see `release_push`.
+static bool event_push(bsp_event_t const *event, bool from_isr) {
+    if (left_out(event)) {
+        atomic_fetch_add_explicit(&stat_coalesced, 1, memory_order_relaxed);
+        return true;
+    }
+    bool reserved;
+    if (ring_admit(event, &reserved)) {
+        atomic_fetch_add_explicit(&stat_enqueued, 1, memory_order_relaxed);
+        return true;
+    }
+
+    bool success = false;
+    if (is_release(event)) {
+        success = release_push(event, reserved);
+        goto done;
+    }
+    switch (overflow_policy) {
+        case BSP_EVENT_OVERFLOW_COALESCE:
+            if (coalesce(event)) {
+                atomic_fetch_add_explicit(&stat_coalesced, 1, memory_order_relaxed);
+                return true;
+            }
+            // Could not coalesce; drop the oldest event instead.
+            goto drop_oldest;
+
+        case BSP_EVENT_OVERFLOW_BLOCK:
+            if (!from_isr) {
+                success = block_push(event, pdMS_TO_TICKS(CONFIG_BSP_EVENT_BLOCK_TIMEOUT_MS));
+                if (success) {
+                    break;
+                }
+            }
+            // Interrupt handlers cannot wait; drop the oldest event instead.
+            goto drop_oldest;
+
+        case BSP_EVENT_OVERFLOW_DROP_OLDEST:
+        drop_oldest:
+            // Only events already seen by the callbacks can be dropped, and never releases.
+            success = drop_oldest_push(event);
+            if (!success) {
+                // Drop this event instead, and with it the hold and release events of a press.
+                coalesce(event);
+            }
+            break;
+
+        case BSP_EVENT_OVERFLOW_DROP_NEWEST:
+            // Consumers shouldn't get the hold and release events of a press they never got.
+            coalesce(event);
+            break;
+    }
+
+done:
+    if (success) {
+        atomic_fetch_add_explicit(&stat_enqueued, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+    }
+    return success;
+}
+
+// Add an event to the ring without applying the overflow policy or waking the event thread.
+// Doesn't block or call into FreeRTOS, so it can be used in critical sections; call `bsp_event_wake` afterwards.
+bool bsp_event_queue_nowake(bsp_event_t const *event) {
+    bool reserved;
+    if (left_out(event)) {
+        atomic_fetch_add_explicit(&stat_coalesced, 1, memory_order_relaxed);
+        return true;
+    } else if (ring_admit(event, &reserved)) {
+        atomic_fetch_add_explicit(&stat_enqueued, 1, memory_order_relaxed);
+        return true;
+    } else if (is_release(event)) {
+        bool success = release_push(event, reserved);
+        atomic_fetch_add_explicit(success ? &stat_enqueued : &stat_dropped, 1, memory_order_relaxed);
+        return success;
+    }
+    atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+    return false;
+}
+
+// Wake the event thread after `bsp_event_queue_nowake`; may be called from interrupt context.
+void bsp_event_wake() {
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(event_thread_handle, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotifyGive(event_thread_handle);
+    }
+}
+
+// Whether there are dispatched events waiting for consumers.
+static bool ring_ready() {
+    uint32_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    uint32_t seq = atomic_load_explicit(&ring[pos % EVENT_RING_LEN].seq, memory_order_acquire);
+    return seq == pos + 2;
+}
+
+// Whether callback entry `a` runs before `b`.
+static bool cb_before(cb_ent_t const *a, cb_ent_t const *b) {
+    return a->prio > b->prio || (a->prio == b->prio && a->id < b->id);
+}
+
+// Run the callbacks interested in an event.
+// The callbacks for this specific type and for `BSP_EVENT_ANY` are merged in order of priority.
+static void cb_dispatch(bsp_event_t const *event) {
+    atomic_fetch_add(&dispatch_epoch, 1);
+    cb_list_t const *any   = atomic_load(&cb_buckets[0]);
+    cb_list_t const *typed = NULL;
+    if (event->type >= 0 && event->type < BSP_EVENT_TYPE_COUNT) {
+        typed = atomic_load(&cb_buckets[event->type + 1]);
+    }
+    size_t any_len   = any ? any->len : 0;
+    size_t typed_len = typed ? typed->len : 0;
+    size_t a = 0, t = 0;
+    while (a < any_len || t < typed_len) {
+        cb_ent_t const *ent;
+        if (t >= typed_len || (a < any_len && cb_before(&any->ents[a], &typed->ents[t]))) {
+            ent = &any->ents[a++];
+        } else {
+            ent = &typed->ents[t++];
+        }
+        // Ordered with the store in `bsp_event_remove_callback` so it either sees the callback removed or waits.
+        if (!atomic_load(&ent->dead)) {
+            ent->func(event, ent->cookie);
+        }
+    }
+    atomic_fetch_add(&dispatch_epoch, 1);
+}
+
+// Free retired callback lists that the event thread can no longer be using; `cb_mtx` must be held.
+static void cb_reclaim() {
+    uint32_t    epoch = atomic_load(&dispatch_epoch);
+    cb_list_t **cur   = &cb_retired;
+    while (*cur) {
+        cb_list_t *list = *cur;
+        if (!(list->retire_epoch & 1) || list->retire_epoch != epoch) {
+            // The event thread was not running callbacks when this list was retired, or has finished since.
+            *cur = list->next_retired;
+            bsp_pool_free(&cb_pool, list);
+        } else {
+            cur = &list->next_retired;
+        }
+    }
+    atomic_store(&cb_retired_pending, cb_retired != NULL);
+}
 
+// Allocate a callback list; `cb_mtx` must be held.
+// Returns NULL if every list is in use or retired; see `cb_wait_dispatch`.
+static cb_list_t *cb_alloc() {
+    cb_reclaim();
+    return bsp_pool_alloc(&cb_pool);
+}
 
+// Wait until the event thread is done running the callbacks it was running at dispatch epoch `epoch`, if any.
+// Must not be called with `cb_mtx` held, as callbacks may need it to add or remove callbacks.
+// Returns false without waiting on the event thread itself, as it would wait for itself.
+static bool cb_wait_dispatch(uint32_t epoch) {
+    if (xTaskGetCurrentTaskHandle() == event_thread_handle) {
+        return false;
+    }
+    while ((epoch & 1) && atomic_load(&dispatch_epoch) == epoch) {
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+// Replace the callback list of a bucket and retire the old one; `cb_mtx` must be held.
+static void cb_publish(int bucket, cb_list_t *list) {
+    cb_list_t *old = atomic_exchange(&cb_buckets[bucket], list);
+    if (old) {
+        old->retire_epoch = atomic_load(&dispatch_epoch);
+        old->next_retired = cb_retired;
+        cb_retired        = old;
+    }
+    cb_reclaim();
+}
 
 // Event handler thread function.
+// Runs the callbacks on events in place in the ring, then makes them available to consumers.
 static void event_thread(void *ignored) {
     (void)ignored;
     while (1) {
-        bsp_event_t event;
-        xQueueReceive(incoming_queue, &event, portMAX_DELAY);
-        cb_ent_t *node = (cb_ent_t *)callbacks.head;
-        while (node) {
-            if (node->filter == BSP_EVENT_ANY || node->filter == event.type) {
-                node->func(&event, node->cookie);
-            }
-            node = (cb_ent_t *)node->node.next;
+        ring_slot_t *slot = &ring[ring_dispatch % EVENT_RING_LEN];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != ring_dispatch + 1) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        cb_dispatch(&slot->event);
+        atomic_store_explicit(&slot->seq, ring_dispatch + 2, memory_order_release);
+        ring_dispatch++;
+        xSemaphoreGive(ready_sem);
+        if (atomic_load(&cb_retired_pending) && xSemaphoreTake(cb_mtx, 0) == pdTRUE) {
+            cb_reclaim();
+            xSemaphoreGive(cb_mtx);
         }
-        xQueueSend(outgoing_queue, &event, 0);
     }
 }
 
 // Initialize the event queues.
 void bsp_event_queue_init() {
-    incoming_queue = xQueueCreate(8, sizeof(bsp_event_t));
-    outgoing_queue = xQueueCreate(32, sizeof(bsp_event_t));
-    xTaskCreate(event_thread, "bsp_event_worker", 8192, NULL, tskIDLE_PRIORITY, &event_thread_handle);
+    for (uint32_t i = 0; i < EVENT_RING_LEN; i++) {
+        atomic_init(&ring[i].seq, i);
+    }
+    cb_mtx    = xSemaphoreCreateMutex();
+    ready_sem = xSemaphoreCreateBinary();
+    space_sem = xSemaphoreCreateBinary();
+    xTaskCreate(event_thread, "bsp_event_worker", 8192, NULL, CONFIG_BSP_EVENT_TASK_PRIORITY, &event_thread_handle);
+    bsp_alloc_count_add_input_task(event_thread_handle);
 }
 
 
 // Add an event to the BSP's event queue.
 bool bsp_event_queue(bsp_event_t *event) {
-    return xQueueSend(incoming_queue, event, 0) == pdTRUE;
+    if (!event_push(event, false)) {
+        return false;
+    }
+    xTaskNotifyGive(event_thread_handle);
+    return true;
+}
+
+// Add multiple events to the BSP's event queue.
+// Returns how many events were added, stopping at the first that does not fit.
+size_t bsp_event_queue_many(bsp_event_t *events, size_t events_len) {
+    size_t i;
+    for (i = 0; i < events_len; i++) {
+        if (!event_push(&events[i], false)) {
+            break;
+        }
+    }
+    if (i) {
+        xTaskNotifyGive(event_thread_handle);
+    }
+    return i;
 }
 
 // Add an event to the BSP's event queue from interrupt handler.
 bool bsp_event_queue_from_isr(bsp_event_t *event) {
-    return xQueueSendFromISR(incoming_queue, event, 0) == pdTRUE;
+    if (!event_push(event, true)) {
+        return false;
+    }
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(event_thread_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+    return true;
+}
+
+// Add an event to the BSP's event queue, waiting for a limited time for space regardless of the overflow policy.
+bool bsp_event_queue_wait(bsp_event_t *event, uint64_t wait_ms) {
+    TickType_t ticks;
+    if (wait_ms > pdTICKS_TO_MS(portMAX_DELAY)) {
+        ticks = portMAX_DELAY;
+    } else {
+        ticks = pdMS_TO_TICKS(wait_ms);
+    }
+    bool reserved;
+    if (left_out(event)) {
+        atomic_fetch_add_explicit(&stat_coalesced, 1, memory_order_relaxed);
+        return true;
+    } else if (!ring_admit(event, &reserved) && !(reserved && release_push(event, true)) && !block_push(event, ticks)) {
+        // Never drop other events to make space; the caller decides what to do.
+        atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    atomic_fetch_add_explicit(&stat_enqueued, 1, memory_order_relaxed);
+    xTaskNotifyGive(event_thread_handle);
+    return true;
+}
+
+// Leave out events of types not selected with `bsp_event_set_wait_filter`; returns how many are left.
+static size_t wait_filter_events(bsp_event_t *events, size_t count) {
+    uint32_t filter = atomic_load_explicit(&wait_filter, memory_order_relaxed);
+    size_t   kept   = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (filter & BSP_EVENT_MASK(events[i].type)) {
+            events[kept++] = events[i];
+        }
+    }
+    return kept;
 }
 
 // Wait for a limited time for a BSP event to happen.
 // If time is 0, only returns a valid event when there is one in the queue.
 bool bsp_event_wait(bsp_event_t *event_out, uint64_t wait_ms) {
+    return bsp_event_wait_many(event_out, 1, wait_ms);
+}
+
+// Wait for a limited time for at least one BSP event to happen, then take up to `max` pending events at once.
+// Returns the number of events read; if time is 0, only returns events already in the queue.
+size_t bsp_event_wait_many(bsp_event_t *events_out, size_t max, uint64_t wait_ms) {
+    if (!max) {
+        return 0;
+    }
+
     // Clamp max wait time.
     TickType_t ticks;
     if (wait_ms > pdTICKS_TO_MS(portMAX_DELAY)) {
@@ -68,23 +737,174 @@ bool bsp_event_wait(bsp_event_t *event_out, uint64_t wait_ms) {
     } else {
         ticks = pdMS_TO_TICKS(wait_ms);
     }
-    return xQueueReceive(outgoing_queue, event_out, ticks) == pdTRUE;
+
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    size_t count;
+    while (!(count = wait_filter_events(events_out, ring_pop_many(events_out, max)))) {
+        if (ring_ready()) {
+            // Only events this consumer didn't ask for were taken; there are more.
+            continue;
+        } else if (xTaskCheckForTimeOut(&timeout, &ticks) == pdTRUE) {
+            return 0;
+        }
+        xSemaphoreTake(ready_sem, ticks);
+    }
+    if (ring_ready()) {
+        // Pass the wakeup on to other consumers.
+        xSemaphoreGive(ready_sem);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (events_out[i].type == BSP_EVENT_INPUT) {
+            bsp_latency_record(BSP_LATENCY_QUEUE, events_out[i].input.timestamp);
+        }
+    }
+    return count;
+}
+
+
+// Set what to do when an event is queued while the event queue is full.
+void bsp_event_set_overflow(bsp_event_overflow_t policy) {
+    overflow_policy = policy;
+}
+
+// Select which event types `bsp_event_wait` and `bsp_event_wait_many` return, as a mask of `BSP_EVENT_MASK` bits.
+// Events of other types are still passed to callbacks; only input events are returned by default.
+void bsp_event_set_wait_filter(uint32_t type_mask) {
+    atomic_store_explicit(&wait_filter, type_mask, memory_order_relaxed);
+}
+
+// Get the event queue statistics.
+void bsp_event_get_stats(bsp_event_stats_t *stats_out) {
+    stats_out->enqueued      = atomic_load_explicit(&stat_enqueued, memory_order_relaxed);
+    stats_out->dropped       = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    stats_out->coalesced     = atomic_load_explicit(&stat_coalesced, memory_order_relaxed);
+    stats_out->blocked       = atomic_load_explicit(&stat_blocked, memory_order_relaxed);
+    stats_out->lost_releases = atomic_load_explicit(&stat_lost_releases, memory_order_relaxed);
+}
+
+// Reset the event queue statistics to 0.
+void bsp_event_reset_stats() {
+    atomic_store_explicit(&stat_enqueued, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_coalesced, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_blocked, 0, memory_order_relaxed);
+    atomic_store_explicit(&stat_lost_releases, 0, memory_order_relaxed);
 }
 
 
 // Add a new callback to be run immediately when an event happens.
 bsp_cb_handle_t bsp_event_add_callback(bsp_event_type_t filter, bsp_event_cb_t callback, void *cookie) {
-    cb_ent_t *ent = malloc(sizeof(cb_ent_t));
-    if (!ent)
+    return bsp_event_add_callback_prio(filter, callback, cookie, 0);
+}
+
+// Add a new callback to be run immediately when an event happens.
+// Callbacks with a higher priority run first; callbacks with equal priority run in the order they were added.
+bsp_cb_handle_t bsp_event_add_callback_prio(bsp_event_type_t filter, bsp_event_cb_t callback, void *cookie, int prio) {
+    if (filter < BSP_EVENT_ANY || filter >= BSP_EVENT_TYPE_COUNT) {
         return NULL;
-    ent->filter = filter;
-    ent->func   = callback;
-    ent->cookie = cookie;
-    dlist_append(&callbacks, &ent->node);
-    return ent;
+    }
+    int              bucket = filter + 1;
+    cb_list_t const *old;
+    size_t           old_len;
+    cb_list_t       *list;
+    while (1) {
+        xSemaphoreTake(cb_mtx, portMAX_DELAY);
+        old         = atomic_load(&cb_buckets[bucket]);
+        old_len     = old ? old->len : 0;
+        size_t live = 0;
+        for (size_t i = 0; i < old_len; i++) {
+            live += !atomic_load_explicit(&old->ents[i].dead, memory_order_relaxed);
+        }
+        if (live >= CONFIG_BSP_EVENT_CALLBACK_MAX) {
+            xSemaphoreGive(cb_mtx);
+            return NULL;
+        }
+        list = cb_alloc();
+        if (list) {
+            break;
+        }
+        // Every list is in use or retired while the event thread runs callbacks; retry once they're done.
+        bool     retired = cb_retired != NULL;
+        uint32_t epoch   = atomic_load(&dispatch_epoch);
+        xSemaphoreGive(cb_mtx);
+        if (!retired || !cb_wait_dispatch(epoch)) {
+            return NULL;
+        }
+    }
+
+    // Insert after all callbacks with equal or higher priority, leaving out dead ones.
+    cb_ent_t ent = {
+        .id     = next_cb_id++,
+        .prio   = prio,
+        .func   = callback,
+        .cookie = cookie,
+    };
+    size_t len      = 0;
+    bool   inserted = false;
+    for (size_t i = 0; i < old_len; i++) {
+        if (atomic_load_explicit(&old->ents[i].dead, memory_order_relaxed)) {
+            continue;
+        } else if (!inserted && old->ents[i].prio < prio) {
+            list->ents[len++] = ent;
+            inserted          = true;
+        }
+        list->ents[len++] = old->ents[i];
+    }
+    if (!inserted) {
+        list->ents[len++] = ent;
+    }
+    list->len = len;
+
+    cb_publish(bucket, list);
+    xSemaphoreGive(cb_mtx);
+    return (bsp_cb_handle_t)(uintptr_t)ent.id;
 }
 
 // Remove an event callback so it will no longer be called when an event happens.
-void bsp_event_remove_callback(bsp_cb_handle_t handle) {
-    dlist_remove(&callbacks, (dlist_node_t *)handle);
+// Waits for the callback to finish if it is running, unless called from a callback.
+// Returns false if the callback was not registered.
+bool bsp_event_remove_callback(bsp_cb_handle_t handle) {
+    uint32_t id    = (uintptr_t)handle;
+    bool     found = false;
+    xSemaphoreTake(cb_mtx, portMAX_DELAY);
+    for (int bucket = 0; bucket < CB_BUCKETS && !found; bucket++) {
+        cb_list_t *old = atomic_load(&cb_buckets[bucket]);
+        size_t     i;
+        for (i = 0; old && i < old->len; i++) {
+            if (old->ents[i].id == id && !atomic_load_explicit(&old->ents[i].dead, memory_order_relaxed)) {
+                break;
+            }
+        }
+        if (!old || i == old->len) {
+            continue;
+        }
+        found = true;
+        // The event thread skips the callback from now on, even if no list is free to replace this one with.
+        atomic_store(&old->ents[i].dead, true);
+
+        cb_list_t *list = NULL;
+        if (old->len > 1) {
+            list = cb_alloc();
+            if (!list) {
+                // The next list built for this bucket leaves the callback out.
+                break;
+            }
+            size_t len = 0;
+            for (size_t j = 0; j < old->len; j++) {
+                if (j != i && !atomic_load_explicit(&old->ents[j].dead, memory_order_relaxed)) {
+                    list->ents[len++] = old->ents[j];
+                }
+            }
+            list->len = len;
+        }
+        cb_publish(bucket, list);
+    }
+    uint32_t epoch = atomic_load(&dispatch_epoch);
+    xSemaphoreGive(cb_mtx);
+    if (found) {
+        // The callback may have been picked up by the event thread before it was marked dead.
+        cb_wait_dispatch(epoch);
+    }
+    return found;
 }
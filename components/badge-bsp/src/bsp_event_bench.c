@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: MIT
+
+#include "bsp_event.h"
+#include "bsp_latency.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static char const TAG[] = "bsp-event-bench";
+
+
+
+// Number of events sent per benchmark.
+#define BENCH_ITERATIONS CONFIG_BSP_EVENT_BENCH_ITERATIONS
+// Number of events sent at once in the burst benchmark.
+#define BENCH_BURST      (CONFIG_BSP_EVENT_QUEUE_DEPTH / 2)
+// Maximum time to wait for a benchmark event in milliseconds.
+#define BENCH_TIMEOUT_MS 100
+
+#if CONFIG_BSP_EVENT_BENCH_BASELINE
+// Number of event paths compared.
+#define BENCH_PATHS 2
+#else
+#define BENCH_PATHS 1
+#endif
+
+// Event path being benchmarked.
+typedef struct {
+    // Name used in the report.
+    char const *name;
+    // Add an event to the queue.
+    bool (*queue)(bsp_event_t *event);
+    // Add multiple events to the queue; returns how many were added.
+    size_t (*queue_many)(bsp_event_t *events, size_t events_len);
+    // Wait for events; returns how many were read.
+    size_t (*wait_many)(bsp_event_t *events_out, size_t max, uint64_t wait_ms);
+} bench_path_t;
+
+// Kinds of latency measured.
+typedef enum {
+    // Cost of queueing an event.
+    SAMPLE_PUSH,
+    // Push-to-dispatch latency, one event at a time; measured in a callback.
+    SAMPLE_DISPATCH,
+    // Push-to-consumer latency, one event at a time.
+    SAMPLE_CONSUME,
+    // Push-to-dispatch latency in bursts; measured in a callback.
+    SAMPLE_BURST_DISPATCH,
+    // Push-to-consumer latency in bursts.
+    SAMPLE_BURST_CONSUME,
+    // Number of kinds of latency.
+    SAMPLE_KINDS,
+} sample_kind_t;
+
+// Latency samples in microseconds.
+typedef struct {
+    // Samples.
+    uint32_t *us;
+    // Number of valid samples.
+    size_t    len;
+} samples_t;
+
+// Results of one event path.
+typedef struct {
+    // Samples per kind of latency.
+    samples_t  samples[SAMPLE_KINDS];
+    // Dispatch samples currently written by the callback.
+    samples_t *cb_samples;
+    // Number of events queued.
+    size_t     sent;
+    // Number of events that were sent but never read.
+    size_t     lost;
+} bench_t;
+
+// Summary of a set of latencies.
+typedef struct {
+    size_t   len;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} summary_t;
+
+// Report names of the kinds of latency.
+static char const *const sample_names[SAMPLE_KINDS] = {
+    [SAMPLE_PUSH]           = "Queue",
+    [SAMPLE_DISPATCH]       = "Push to dispatch",
+    [SAMPLE_CONSUME]        = "Push to consumer",
+    [SAMPLE_BURST_DISPATCH] = "Burst push to dispatch",
+    [SAMPLE_BURST_CONSUME]  = "Burst push to consumer",
+};
+
+
+
+// Compare two latencies for `qsort`.
+static int cmp_u32(void const *a, void const *b) {
+    uint32_t x = *(uint32_t const *)a;
+    uint32_t y = *(uint32_t const *)b;
+    return (x > y) - (x < y);
+}
+
+// Compute the median, 99th percentile and maximum of a set of latencies; sorts them.
+static summary_t summarize(samples_t *samples) {
+    if (!samples->len) {
+        return (summary_t){0};
+    }
+    qsort(samples->us, samples->len, sizeof(uint32_t), cmp_u32);
+    return (summary_t){
+        .len = samples->len,
+        .p50 = samples->us[samples->len / 2],
+        .p99 = samples->us[(samples->len * 99 + 99) / 100 - 1],
+        .max = samples->us[samples->len - 1],
+    };
+}
+
+// Log a summary per event path on one line so they can be compared.
+static void report(sample_kind_t kind, bench_path_t const *paths, bench_t *benches) {
+    char   line[160];
+    size_t len = 0;
+    for (size_t i = 0; i < BENCH_PATHS && len < sizeof(line); i++) {
+        summary_t sum = summarize(&benches[i].samples[kind]);
+        len += snprintf(
+            line + len,
+            sizeof(line) - len,
+            "%s%s n=%zu p50=%" PRIu32 "us p99=%" PRIu32 "us max=%" PRIu32 "us",
+            i ? " | " : "",
+            paths[i].name,
+            sum.len,
+            sum.p50,
+            sum.p99,
+            sum.max
+        );
+    }
+    ESP_LOGI(TAG, "%s: %s", sample_names[kind], line);
+}
+
+// Add a sample.
+static void sample_add(samples_t *samples, int64_t since) {
+    if (samples->len < BENCH_ITERATIONS) {
+        samples->us[samples->len++] = esp_timer_get_time() - since;
+    }
+}
+
+// Record the push-to-dispatch latency of an event.
+static void bench_cb(bsp_event_t const *event, void *cookie) {
+    bench_t *bench = cookie;
+    sample_add(bench->cb_samples, event->input.timestamp);
+}
+
+// Make a benchmark event.
+static bsp_event_t bench_event() {
+    return (bsp_event_t){
+        .type  = BSP_EVENT_INPUT,
+        .input = {
+            .type      = BSP_INPUT_EVENT_PRESS,
+            .timestamp = esp_timer_get_time(),
+        },
+    };
+}
+
+
+
+#if CONFIG_BSP_EVENT_BENCH_BASELINE
+// The event path before the lock-free ring, for comparison: producers send to an 8-deep queue, a worker at idle
+// priority runs the callbacks and forwards each event to a 32-deep queue that consumers read from.
+static QueueHandle_t base_incoming;
+static QueueHandle_t base_outgoing;
+// Results the baseline worker records dispatch latencies in.
+static bench_t      *base_bench;
+
+// Baseline event worker.
+static void base_thread(void *ignored) {
+    (void)ignored;
+    while (1) {
+        bsp_event_t event;
+        xQueueReceive(base_incoming, &event, portMAX_DELAY);
+        bench_cb(&event, base_bench);
+        xQueueSend(base_outgoing, &event, 0);
+    }
+}
+
+// Add an event to the baseline queue.
+static bool base_queue(bsp_event_t *event) {
+    return xQueueSend(base_incoming, event, 0) == pdTRUE;
+}
+
+// Add multiple events to the baseline queue, stopping at the first that does not fit.
+static size_t base_queue_many(bsp_event_t *events, size_t events_len) {
+    size_t i;
+    for (i = 0; i < events_len && base_queue(&events[i]); i++);
+    return i;
+}
+
+// Wait for at least one event on the baseline queue, then take up to `max` pending events.
+static size_t base_wait_many(bsp_event_t *events_out, size_t max, uint64_t wait_ms) {
+    if (!max || xQueueReceive(base_outgoing, &events_out[0], pdMS_TO_TICKS(wait_ms)) != pdTRUE) {
+        return 0;
+    }
+    size_t count = 1;
+    while (count < max && xQueueReceive(base_outgoing, &events_out[count], 0) == pdTRUE) {
+        count++;
+    }
+    return count;
+}
+#endif
+
+// Event paths to compare.
+static bench_path_t const paths[BENCH_PATHS] = {
+    {"ring", bsp_event_queue, bsp_event_queue_many, bsp_event_wait_many},
+#if CONFIG_BSP_EVENT_BENCH_BASELINE
+    {"two-queue", base_queue, base_queue_many, base_wait_many},
+#endif
+};
+
+// Run the benchmark workload through one event path.
+// Events that don't fit in the queue count as lost, like they would for a real producer.
+static void bench_run(bench_path_t const *path, bench_t *bench) {
+    // One event at a time.
+    bench->cb_samples = &bench->samples[SAMPLE_DISPATCH];
+    for (size_t i = 0; i < BENCH_ITERATIONS; i++) {
+        bsp_event_t event = bench_event();
+        bool        sent  = path->queue(&event);
+        sample_add(&bench->samples[SAMPLE_PUSH], event.input.timestamp);
+        bench->sent++;
+        if (sent && path->wait_many(&event, 1, BENCH_TIMEOUT_MS)) {
+            sample_add(&bench->samples[SAMPLE_CONSUME], event.input.timestamp);
+        } else {
+            bench->lost++;
+        }
+    }
+
+    // Bursts of events, read in batches.
+    bench->cb_samples = &bench->samples[SAMPLE_BURST_DISPATCH];
+    for (size_t i = 0; i + BENCH_BURST <= BENCH_ITERATIONS; i += BENCH_BURST) {
+        bsp_event_t events[BENCH_BURST];
+        for (size_t j = 0; j < BENCH_BURST; j++) {
+            events[j] = bench_event();
+        }
+        size_t sent      = path->queue_many(events, BENCH_BURST);
+        size_t burst_len = 0;
+        while (burst_len < sent) {
+            size_t count = path->wait_many(events, BENCH_BURST, BENCH_TIMEOUT_MS);
+            if (!count) {
+                break;
+            }
+            for (size_t j = 0; j < count; j++) {
+                sample_add(&bench->samples[SAMPLE_BURST_CONSUME], events[j].input.timestamp);
+            }
+            burst_len += count;
+        }
+        bench->sent += BENCH_BURST;
+        bench->lost += BENCH_BURST - burst_len;
+    }
+}
+
+
+
+// Benchmark the event queue: the cost of queueing an event, and the latency until it is dispatched to the
+// callbacks and read by a consumer, both one event at a time and in bursts.
+// With `CONFIG_BSP_EVENT_BENCH_BASELINE`, the same workload also runs through the old two-queue event path.
+// Must run before any devices are registered, as it consumes all events.
+void bsp_event_bench() {
+    bench_t   benches[BENCH_PATHS] = {0};
+    uint32_t *buf                  = malloc(BENCH_PATHS * SAMPLE_KINDS * BENCH_ITERATIONS * sizeof(uint32_t));
+    if (!buf) {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+    for (size_t i = 0; i < BENCH_PATHS; i++) {
+        for (size_t kind = 0; kind < SAMPLE_KINDS; kind++) {
+            benches[i].samples[kind].us = buf + (i * SAMPLE_KINDS + kind) * BENCH_ITERATIONS;
+        }
+    }
+
+    bsp_cb_handle_t cb = bsp_event_add_callback(BSP_EVENT_ANY, bench_cb, &benches[0]);
+    if (!cb) {
+        ESP_LOGE(TAG, "Failed to add callback");
+        free(buf);
+        return;
+    }
+    bench_run(&paths[0], &benches[0]);
+    bsp_event_remove_callback(cb);
+
+#if CONFIG_BSP_EVENT_BENCH_BASELINE
+    TaskHandle_t base_task = NULL;
+    base_bench             = &benches[1];
+    base_incoming          = xQueueCreate(8, sizeof(bsp_event_t));
+    base_outgoing          = xQueueCreate(32, sizeof(bsp_event_t));
+    if (base_incoming && base_outgoing &&
+        xTaskCreate(base_thread, "bsp_bench_base", 8192, NULL, tskIDLE_PRIORITY, &base_task) == pdPASS) {
+        bench_run(&paths[1], &benches[1]);
+    } else {
+        ESP_LOGE(TAG, "Failed to start the two-queue baseline");
+    }
+    if (base_task) {
+        vTaskDelete(base_task);
+    }
+    if (base_incoming) {
+        vQueueDelete(base_incoming);
+    }
+    if (base_outgoing) {
+        vQueueDelete(base_outgoing);
+    }
+#endif
+
+    for (sample_kind_t kind = 0; kind < SAMPLE_KINDS; kind++) {
+        report(kind, paths, benches);
+    }
+    for (size_t i = 0; i < BENCH_PATHS; i++) {
+        if (benches[i].lost) {
+            ESP_LOGW(TAG, "%s: lost %zu of %zu events", paths[i].name, benches[i].lost, benches[i].sent);
+        }
+    }
+
+    // The benchmark events should not count towards the input latency statistics.
+    bsp_latency_reset();
+    free(buf);
+}
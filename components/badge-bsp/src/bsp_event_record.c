@@ -0,0 +1,302 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp_event_record.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sdkconfig.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#endif
+
+
+
+// Recording file magic.
+#define RECORD_MAGIC   "BSPEVREC"
+// Recording file format version.
+#define RECORD_VERSION 1
+// Number of records buffered between the event thread and the writer thread.
+#define RECORD_BUF_LEN CONFIG_BSP_EVENT_RECORD_BUF_LEN
+// Maximum time the event thread waits for space in `record_buf` in milliseconds.
+#define RECORD_WAIT_MS CONFIG_BSP_EVENT_RECORD_WAIT_MS
+// Number of records the writer thread writes at once.
+#define RECORD_BATCH   16
+// Stack size of the writer thread; file systems need a fair amount.
+#define RECORD_STACK   4096
+
+// Recording file header.
+typedef struct {
+    // Magic; `RECORD_MAGIC`.
+    char     magic[8];
+    // File format version.
+    uint32_t version;
+    // Size of one record, to detect recordings of a different build.
+    uint32_t record_size;
+} record_header_t;
+
+// Recorded event.
+typedef struct {
+    // Time since the start of the recording in microseconds.
+    int64_t     offset_us;
+    // Event.
+    bsp_event_t event;
+} record_t;
+
+// Protects the recording state.
+static pthread_mutex_t record_mtx  = PTHREAD_MUTEX_INITIALIZER;
+// Signalled when records are buffered or the recording stops.
+static pthread_cond_t  record_cond  = PTHREAD_COND_INITIALIZER;
+// Signalled when the writer thread makes space in `record_buf`.
+static pthread_cond_t  record_space = PTHREAD_COND_INITIALIZER;
+// File being recorded to.
+static FILE           *record_fd;
+// Path of the file being recorded to; deleted if the recording fails.
+static char           *record_path;
+// Start time of the recording.
+static int64_t         record_start;
+// Recording callback handle.
+static bsp_cb_handle_t record_cb;
+// Writer thread handle.
+static pthread_t       record_thread;
+// Whether the writer thread should keep running.
+static bool            record_running;
+// Records not yet written to the file.
+static record_t        record_buf[RECORD_BUF_LEN];
+// Index of the oldest record in `record_buf`.
+static size_t          record_head;
+// Number of records in `record_buf`.
+static size_t          record_len;
+// Whether an event could not be recorded; the recording is incomplete and gets deleted.
+static bool            record_failed;
+
+
+
+// Get monotonic time in microseconds; the same clock as input event timestamps on the badge.
+static int64_t record_now() {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+// Sleep for some time in microseconds.
+static void record_sleep(int64_t us) {
+    while (us > 0) {
+        useconds_t part = us > 1000000 ? 1000000 : us;
+        usleep(part);
+        us -= part;
+    }
+}
+
+// Compute the `pthread_cond_timedwait` deadline `ms` milliseconds from now.
+static struct timespec record_deadline(uint32_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec  += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+// Event callback that buffers events for the writer thread.
+// Runs on the event thread; if the buffer is full it holds up the event queue for at most `RECORD_WAIT_MS`,
+// so producers see backpressure, then fails the recording rather than leaving events out.
+static void record_callback(bsp_event_t const *event, void *cookie) {
+    (void)cookie;
+    int64_t offset = record_now() - record_start;
+    pthread_mutex_lock(&record_mtx);
+    if (record_len >= RECORD_BUF_LEN && !record_failed) {
+        struct timespec deadline = record_deadline(RECORD_WAIT_MS);
+        while (record_len >= RECORD_BUF_LEN && !record_failed &&
+               pthread_cond_timedwait(&record_space, &record_mtx, &deadline) == 0);
+    }
+    if (record_failed) {
+        // The recording is lost already.
+    } else if (record_len < RECORD_BUF_LEN) {
+        record_buf[(record_head + record_len) % RECORD_BUF_LEN] = (record_t){
+            .offset_us = offset,
+            .event     = *event,
+        };
+        record_len++;
+        pthread_cond_signal(&record_cond);
+    } else {
+        record_failed = true;
+    }
+    pthread_mutex_unlock(&record_mtx);
+}
+
+// Writer thread that moves buffered records to the file.
+static void *record_writer(void *arg) {
+    (void)arg;
+    record_t batch[RECORD_BATCH];
+    pthread_mutex_lock(&record_mtx);
+    while (record_running || record_len) {
+        if (!record_len) {
+            pthread_cond_wait(&record_cond, &record_mtx);
+            continue;
+        }
+        // Copy out as many contiguous records as fit in the batch.
+        size_t count = record_len;
+        if (count > RECORD_BUF_LEN - record_head) {
+            count = RECORD_BUF_LEN - record_head;
+        }
+        if (count > sizeof(batch) / sizeof(*batch)) {
+            count = sizeof(batch) / sizeof(*batch);
+        }
+        memcpy(batch, record_buf + record_head, count * sizeof(record_t));
+        record_head  = (record_head + count) % RECORD_BUF_LEN;
+        record_len  -= count;
+        pthread_cond_signal(&record_space);
+        pthread_mutex_unlock(&record_mtx);
+        bool written = fwrite(batch, sizeof(record_t), count, record_fd) == count;
+        pthread_mutex_lock(&record_mtx);
+        if (!written) {
+            record_failed = true;
+            pthread_cond_signal(&record_space);
+        }
+    }
+    pthread_mutex_unlock(&record_mtx);
+    return NULL;
+}
+
+
+
+// Start recording all BSP events with their timing to a file.
+bool bsp_event_record_start(char const *path) {
+    pthread_mutex_lock(&record_mtx);
+    if (record_fd) {
+        pthread_mutex_unlock(&record_mtx);
+        return false;
+    }
+    record_path = strdup(path);
+    if (!record_path) {
+        pthread_mutex_unlock(&record_mtx);
+        return false;
+    }
+    record_fd = fopen(path, "wb");
+    if (!record_fd) {
+        free(record_path);
+        record_path = NULL;
+        pthread_mutex_unlock(&record_mtx);
+        return false;
+    }
+    record_header_t header = {
+        .magic       = RECORD_MAGIC,
+        .version     = RECORD_VERSION,
+        .record_size = sizeof(record_t),
+    };
+    record_start   = record_now();
+    record_head    = 0;
+    record_len     = 0;
+    record_failed  = fwrite(&header, sizeof(header), 1, record_fd) != 1;
+    record_running = true;
+    pthread_mutex_unlock(&record_mtx);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, RECORD_STACK);
+    int res = pthread_create(&record_thread, &attr, record_writer, NULL);
+    pthread_attr_destroy(&attr);
+    if (res) {
+        pthread_mutex_lock(&record_mtx);
+        record_running = false;
+        fclose(record_fd);
+        record_fd = NULL;
+        remove(record_path);
+        free(record_path);
+        record_path = NULL;
+        pthread_mutex_unlock(&record_mtx);
+        return false;
+    }
+
+    // Run before all other callbacks so the timing is as accurate as possible.
+    record_cb = bsp_event_add_callback_prio(BSP_EVENT_ANY, record_callback, NULL, INT_MAX);
+    if (!record_cb) {
+        bsp_event_record_stop();
+        return false;
+    }
+    return true;
+}
+
+// Stop recording BSP events and close the file.
+// Returns false and deletes the file if any event could not be recorded, so incomplete recordings are never replayed.
+bool bsp_event_record_stop() {
+    if (record_cb) {
+        bsp_event_remove_callback(record_cb);
+        record_cb = NULL;
+    }
+    pthread_mutex_lock(&record_mtx);
+    if (!record_fd) {
+        pthread_mutex_unlock(&record_mtx);
+        return false;
+    }
+    // Let the writer thread flush what is left, then close the file.
+    record_running = false;
+    pthread_cond_signal(&record_cond);
+    pthread_mutex_unlock(&record_mtx);
+    pthread_join(record_thread, NULL);
+
+    pthread_mutex_lock(&record_mtx);
+    bool ok   = fclose(record_fd) == 0 && !record_failed;
+    record_fd = NULL;
+    if (!ok) {
+        remove(record_path);
+    }
+    free(record_path);
+    record_path = NULL;
+    pthread_mutex_unlock(&record_mtx);
+    return ok;
+}
+
+// Replay input events recorded with `bsp_event_record_start` through the event queue; blocks until done.
+// Other event types describe hardware state and are left out, so replays don't make apps act on a phantom SD card.
+// `speed_percent` of 100 keeps the original timing, 200 replays twice as fast; `BSP_REPLAY_SPEED_MAX` doesn't wait.
+// Events get their timestamp replaced by the time they are replayed.
+// Replayed events wait for space in the queue regardless of the overflow policy, so none are lost.
+bool bsp_event_replay(char const *path, uint32_t speed_percent) {
+    FILE *fd = fopen(path, "rb");
+    if (!fd) {
+        return false;
+    }
+    record_header_t header;
+    if (fread(&header, sizeof(header), 1, fd) != 1 || memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) ||
+        header.version != RECORD_VERSION || header.record_size != sizeof(record_t)) {
+        fclose(fd);
+        return false;
+    }
+
+    int64_t  start = record_now();
+    record_t record;
+    while (fread(&record, sizeof(record), 1, fd) == 1) {
+        if (record.event.type != BSP_EVENT_INPUT) {
+            continue;
+        }
+        if (speed_percent != BSP_REPLAY_SPEED_MAX) {
+            int64_t due = start + record.offset_us * 100 / speed_percent;
+            record_sleep(due - record_now());
+        }
+        record.event.input.timestamp = record_now();
+        // Replays must be deterministic, so wait for space instead of losing events.
+        if (!bsp_event_queue_wait(&record.event, BSP_EVENT_MAX_WAIT)) {
+            fclose(fd);
+            return false;
+        }
+    }
+
+    fclose(fd);
+    return true;
+}
@@ -0,0 +1,185 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp/init_graph.h"
+
+#include "bsp.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+static char const TAG[] = "bsp-init";
+
+
+
+// Event group bit set once all steps have finished or the time budget ran out.
+#define DONE_BIT (1 << BSP_INIT_STEPS_MAX)
+
+// Per-step task argument.
+typedef struct {
+    // Step to run.
+    bsp_init_step_t const *step;
+    // Index of the step.
+    size_t                 index;
+} step_arg_t;
+
+// Event group with one bit per finished step.
+static EventGroupHandle_t init_group;
+// Steps being run.
+static step_arg_t         init_args[BSP_INIT_STEPS_MAX];
+// Number of steps being run.
+static size_t             init_len;
+// Number of steps not yet finished.
+static atomic_size_t      init_pending;
+// Whether background initialisation has been marked as finished.
+static atomic_bool        init_done;
+// Whether all steps finished before the time budget ran out; only valid once `DONE_BIT` is set.
+static atomic_bool        init_success;
+// Whether any step failed.
+static atomic_bool        init_failed;
+// Timer that enforces the time budget.
+static esp_timer_handle_t init_timer;
+
+
+
+// Send a `BSP_EVENT_INIT` event.
+static void init_event(char const *name, bool success, bool done) {
+    bsp_event_t event = {
+        .type = BSP_EVENT_INIT,
+        .init = {
+            .name      = name,
+            .success   = success,
+            .done      = done,
+            .timestamp = esp_timer_get_time(),
+        },
+    };
+    bsp_event_queue(&event);
+}
+
+// Mark all background initialisation as finished, unless that already happened.
+static void init_finish(bool success) {
+    if (atomic_exchange(&init_done, true)) {
+        return;
+    }
+    atomic_store(&init_success, success);
+    xEventGroupSetBits(init_group, DONE_BIT);
+    init_event(NULL, success, true);
+}
+
+// Called when the time budget runs out.
+static void init_budget_expired(void *ignored) {
+    (void)ignored;
+    if (atomic_load(&init_done)) {
+        return;
+    }
+    EventBits_t bits = xEventGroupGetBits(init_group);
+    for (size_t i = 0; i < init_len; i++) {
+        if (!(bits & (1 << i))) {
+            ESP_LOGW(TAG, "Step '%s' still running after %d ms", init_args[i].step->name, CONFIG_BSP_INIT_BUDGET_MS);
+        }
+    }
+    init_finish(false);
+}
+
+// Task that waits for the dependencies of a step, then runs it.
+static void init_step_task(void *arg_ptr) {
+    step_arg_t const      *arg  = arg_ptr;
+    bsp_init_step_t const *step = arg->step;
+
+    if (step->deps) {
+        xEventGroupWaitBits(init_group, step->deps, false, true, portMAX_DELAY);
+    }
+
+    int64_t start   = esp_timer_get_time();
+    bool    success = step->func();
+    int64_t time    = esp_timer_get_time() - start;
+    if (success) {
+        ESP_LOGI(TAG, "Step '%s' took %" PRId64 " ms", step->name, time / 1000);
+    } else {
+        ESP_LOGE(TAG, "Step '%s' failed after %" PRId64 " ms", step->name, time / 1000);
+        atomic_store(&init_failed, true);
+    }
+
+    xEventGroupSetBits(init_group, 1 << arg->index);
+    init_event(step->name, success, false);
+    if (atomic_fetch_sub(&init_pending, 1) == 1) {
+        esp_timer_stop(init_timer);
+        init_finish(!atomic_load(&init_failed));
+    }
+
+    vTaskDelete(NULL);
+}
+
+
+
+// Start running background initialisation steps in dependency order; does not wait for them to finish.
+// Each step gets its own task; steps whose dependencies have finished run in parallel.
+// Steps still running after `CONFIG_BSP_INIT_BUDGET_MS` are reported as failed.
+bool bsp_init_graph_run(bsp_init_step_t const *steps, size_t steps_len) {
+    if (init_group || steps_len > BSP_INIT_STEPS_MAX) {
+        return false;
+    }
+    init_group = xEventGroupCreate();
+    if (!init_group) {
+        return false;
+    }
+    if (!steps_len) {
+        init_finish(true);
+        return true;
+    }
+
+    esp_timer_create_args_t const timer_args = {
+        .callback = init_budget_expired,
+        .name     = "bsp_init_budget",
+    };
+    if (esp_timer_create(&timer_args, &init_timer) != ESP_OK) {
+        return false;
+    }
+    esp_timer_start_once(init_timer, CONFIG_BSP_INIT_BUDGET_MS * 1000LL);
+
+    init_len = steps_len;
+    atomic_store(&init_pending, steps_len);
+    for (size_t i = 0; i < steps_len; i++) {
+        init_args[i] = (step_arg_t){
+            .step  = &steps[i],
+            .index = i,
+        };
+        BaseType_t core = steps[i].core < 0 ? tskNO_AFFINITY : steps[i].core;
+        if (xTaskCreatePinnedToCore(init_step_task, steps[i].name, 4096, &init_args[i], 5, NULL, core) != pdPASS) {
+            ESP_LOGE(TAG, "Unable to start step '%s'", steps[i].name);
+            // Dependent steps will still wait for this one, so give up on the whole graph.
+            esp_timer_stop(init_timer);
+            init_finish(false);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Wait for background initialisation such as storage and radio to finish.
+// Returns true if it all finished successfully within both `wait_ms` and the time budget.
+bool bsp_init_wait(uint64_t wait_ms) {
+    if (!init_group) {
+        return false;
+    }
+    TickType_t ticks;
+    if (wait_ms > pdTICKS_TO_MS(portMAX_DELAY)) {
+        ticks = portMAX_DELAY;
+    } else {
+        ticks = pdMS_TO_TICKS(wait_ms);
+    }
+    if (!(xEventGroupWaitBits(init_group, DONE_BIT, false, true, ticks) & DONE_BIT)) {
+        return false;
+    }
+    return atomic_load(&init_success);
+}
+
+// Whether background initialisation has finished or run out of time, successfully or not; doesn't wait.
+bool bsp_init_done() {
+    return !init_group || (xEventGroupGetBits(init_group) & DONE_BIT);
+}
@@ -0,0 +1,134 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp_latency.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include <esp_timer.h>
+
+
+
+// Number of histogram buckets per power of 2; must be a power of 2.
+#define SUB_BUCKETS     4
+// Log2 of `SUB_BUCKETS`.
+#define SUB_BUCKET_BITS 2
+// Number of histogram buckets; enough for latencies up to 2^31 microseconds.
+#define BUCKETS         (SUB_BUCKETS * (32 - SUB_BUCKET_BITS))
+
+// Latency histogram of one stage.
+// Buckets are logarithmic with `SUB_BUCKETS` linear steps per power of 2.
+typedef struct {
+    // Number of samples per bucket.
+    atomic_uint buckets[BUCKETS];
+    // Total number of samples.
+    atomic_uint count;
+    // Maximum latency in microseconds.
+    atomic_uint max;
+} histogram_t;
+
+// Latency histograms per stage.
+static histogram_t histograms[BSP_LATENCY_STAGE_COUNT];
+// Input timestamp of the next frame.
+static _Atomic int64_t frame_input;
+
+
+
+// Get the histogram bucket for a latency.
+static int bucket_of(uint32_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    int exp = 31 - __builtin_clz(value);
+    int sub = (value >> (exp - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exp - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+// Get the largest latency that falls into a histogram bucket.
+static int64_t bucket_max(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int exp = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    int sub = bucket % SUB_BUCKETS;
+    return ((int64_t)(SUB_BUCKETS + sub + 1) << (exp - SUB_BUCKET_BITS)) - 1;
+}
+
+// Find the latency below which a fraction `num / den` of samples fall.
+static int64_t percentile(histogram_t *hist, uint32_t count, uint32_t num, uint32_t den) {
+    uint64_t rank = ((uint64_t)count * num + den - 1) / den;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        if (seen >= rank) {
+            return bucket_max(i);
+        }
+    }
+    return atomic_load_explicit(&hist->max, memory_order_relaxed);
+}
+
+
+
+// Record the latency of a stage for an input that happened at `input_timestamp`.
+// Safe to use from interrupt handlers.
+void bsp_latency_record(bsp_latency_stage_t stage, int64_t input_timestamp) {
+    if (stage < 0 || stage >= BSP_LATENCY_STAGE_COUNT || input_timestamp <= 0) {
+        return;
+    }
+    int64_t latency = esp_timer_get_time() - input_timestamp;
+    if (latency < 0) {
+        latency = 0;
+    } else if (latency > INT32_MAX) {
+        latency = INT32_MAX;
+    }
+
+    histogram_t *hist = &histograms[stage];
+    atomic_fetch_add_explicit(&hist->buckets[bucket_of(latency)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    uint32_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (latency > max &&
+           !atomic_compare_exchange_weak_explicit(&hist->max, &max, latency, memory_order_relaxed, memory_order_relaxed)
+    ) {
+        continue;
+    }
+}
+
+// Get the latency statistics of a stage.
+// Percentiles are accurate to within 25%.
+void bsp_latency_get(bsp_latency_stage_t stage, bsp_latency_stats_t *stats_out) {
+    *stats_out = (bsp_latency_stats_t){0};
+    if (stage < 0 || stage >= BSP_LATENCY_STAGE_COUNT) {
+        return;
+    }
+    histogram_t *hist = &histograms[stage];
+    stats_out->count  = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    stats_out->max_us = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    if (stats_out->count) {
+        stats_out->p50_us = percentile(hist, stats_out->count, 50, 100);
+        stats_out->p99_us = percentile(hist, stats_out->count, 99, 100);
+    }
+}
+
+// Reset the latency statistics of all stages.
+void bsp_latency_reset() {
+    for (int stage = 0; stage < BSP_LATENCY_STAGE_COUNT; stage++) {
+        histogram_t *hist = &histograms[stage];
+        for (int i = 0; i < BUCKETS; i++) {
+            atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&hist->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&hist->max, 0, memory_order_relaxed);
+    }
+}
+
+// Set the input timestamp of the next frame sent to the display, or 0 if it does not show the result of an input.
+// The display driver records `BSP_LATENCY_DISPLAY` once the frame has been sent.
+void bsp_latency_set_frame_input(int64_t input_timestamp) {
+    atomic_store(&frame_input, input_timestamp);
+}
+
+// Take the input timestamp set by `bsp_latency_set_frame_input`; used by display drivers.
+int64_t bsp_latency_take_frame_input() {
+    return atomic_exchange(&frame_input, 0);
+}
@@ -0,0 +1,48 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp/pool.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+static char const TAG[] = "bsp-pool";
+
+
+
+// Take a zeroed block from a pool; returns NULL if the pool is exhausted.
+void *bsp_pool_alloc(bsp_pool_t *pool) {
+    size_t index = pool->capacity;
+    taskENTER_CRITICAL(&pool->lock);
+    for (size_t i = 0; i < pool->capacity; i += 32) {
+        uint32_t free_bits = ~pool->used[i / 32];
+        if (free_bits && i + __builtin_ctz(free_bits) < pool->capacity) {
+            index                  = i + __builtin_ctz(free_bits);
+            pool->used[index / 32] |= 1u << (index % 32);
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&pool->lock);
+
+    if (index == pool->capacity) {
+        ESP_LOGE(TAG, "Pool %s exhausted (%zu blocks)", pool->name, pool->capacity);
+        return NULL;
+    }
+    void *block = (char *)pool->blocks + index * pool->block_size;
+    memset(block, 0, pool->block_size);
+    return block;
+}
+
+// Return a block to its pool; does nothing if `block` is NULL.
+void bsp_pool_free(bsp_pool_t *pool, void *block) {
+    if (!block) {
+        return;
+    }
+    size_t index = ((char *)block - (char *)pool->blocks) / pool->block_size;
+    assert(index < pool->capacity);
+    taskENTER_CRITICAL(&pool->lock);
+    pool->used[index / 32] &= ~(1u << (index % 32));
+    taskEXIT_CRITICAL(&pool->lock);
+}
@@ -0,0 +1,184 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp_device.h"
+#include "bsp/alloc_count.h"
+
+#include <stdatomic.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static char const TAG[] = "bsp-raw-input";
+
+
+
+// Number of records in each per-core raw input ring; must be a power of 2.
+#define RAW_RING_LEN 32
+
+// Raw input change recorded by an interrupt handler.
+typedef struct {
+    // Time at which the change happened.
+    int64_t             timestamp;
+    // Debouncing state, if any.
+    bsp_raw_debounce_t *debounce;
+    // Device ID.
+    uint32_t            dev_id;
+    // Raw input value or keyboard scan code.
+    int                 input;
+    // Device endpoint.
+    uint8_t             endpoint;
+    // Button is now pressed.
+    bool                pressed;
+} raw_record_t;
+
+// Single-producer single-consumer raw input ring; written by interrupt handlers on one CPU only.
+typedef struct {
+    // Next position to write.
+    atomic_uint  head;
+    // Next position to read.
+    atomic_uint  tail;
+    // Recorded changes.
+    raw_record_t records[RAW_RING_LEN];
+} raw_ring_t;
+
+// Raw input rings, one per CPU.
+static raw_ring_t          rings[portNUM_PROCESSORS];
+// Number of changes lost because a ring was full.
+static atomic_uint         raw_dropped;
+// Task that handles the recorded changes.
+static TaskHandle_t        raw_thread_handle;
+// Debounced inputs that need to be checked again once their lockout ends.
+static bsp_raw_debounce_t *pending_checks;
+
+
+
+// Report a debounced change to the BSP.
+static void raw_input_report(uint32_t dev_id, uint8_t endpoint, int input, bool pressed, int64_t timestamp) {
+    bsp_raw_button_t button = {
+        .input     = input,
+        .pressed   = pressed,
+        .timestamp = timestamp,
+    };
+    bsp_raw_button_batch(dev_id, endpoint, &button, 1);
+}
+
+// Handle a single recorded change.
+// Edges are reported immediately, after which the input ignores edges for the debounce time.
+// If the input changed during that time, its final level is reported when the time ends.
+static void raw_input_handle(raw_record_t const *rec) {
+    bsp_raw_debounce_t *db = rec->debounce;
+    if (db && db->time_us) {
+        db->dev_id         = rec->dev_id;
+        db->endpoint       = rec->endpoint;
+        db->input          = rec->input;
+        db->last           = rec->pressed;
+        db->last_timestamp = rec->timestamp;
+        if (rec->timestamp < db->lockout_until) {
+            if (!db->check_pending) {
+                db->check_pending = true;
+                db->next          = pending_checks;
+                pending_checks    = db;
+            }
+            return;
+        } else if (rec->pressed == db->reported) {
+            return;
+        }
+        db->reported      = rec->pressed;
+        db->lockout_until = rec->timestamp + db->time_us;
+    }
+    raw_input_report(rec->dev_id, rec->endpoint, rec->input, rec->pressed, rec->timestamp);
+}
+
+// Check debounced inputs whose lockout has ended.
+// Returns the time until the next lockout ends, or -1 if none are pending.
+static int64_t raw_input_check(int64_t now) {
+    int64_t              next = -1;
+    bsp_raw_debounce_t **cur  = &pending_checks;
+    while (*cur) {
+        bsp_raw_debounce_t *db = *cur;
+        if (db->lockout_until > now) {
+            if (next < 0 || db->lockout_until - now < next) {
+                next = db->lockout_until - now;
+            }
+            cur = &db->next;
+            continue;
+        }
+        *cur              = db->next;
+        db->check_pending = false;
+        if (db->last != db->reported) {
+            db->reported      = db->last;
+            db->lockout_until = now + db->time_us;
+            raw_input_report(db->dev_id, db->endpoint, db->input, db->last, db->last_timestamp);
+        }
+    }
+    return next;
+}
+
+// Raw input handler thread function.
+static void raw_input_thread(void *ignored) {
+    (void)ignored;
+    TickType_t ticks = portMAX_DELAY;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, ticks);
+
+        for (int i = 0; i < portNUM_PROCESSORS; i++) {
+            raw_ring_t *ring = &rings[i];
+            uint32_t    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            uint32_t    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            for (; tail != head; tail++) {
+                raw_input_handle(&ring->records[tail % RAW_RING_LEN]);
+            }
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        }
+
+        int64_t next = raw_input_check(esp_timer_get_time());
+        if (next < 0) {
+            ticks = portMAX_DELAY;
+        } else {
+            ticks = pdMS_TO_TICKS((next + 999) / 1000) ?: 1;
+        }
+
+        uint32_t dropped = atomic_exchange_explicit(&raw_dropped, 0, memory_order_relaxed);
+        if (dropped) {
+            ESP_LOGW(TAG, "%" PRIu32 " raw input changes dropped", dropped);
+        }
+    }
+}
+
+// Initialize the deferred raw input handler.
+void bsp_raw_input_init() {
+    xTaskCreate(raw_input_thread, "bsp_raw_input", 4096, NULL, CONFIG_BSP_EVENT_TASK_PRIORITY, &raw_thread_handle);
+    bsp_alloc_count_add_input_task(raw_thread_handle);
+}
+
+// Record a button press or release from an interrupt handler.
+// Translation and debouncing happen later in a task, so this takes constant time.
+void bsp_raw_button_deferred_from_isr(
+    uint32_t dev_id, uint8_t endpoint, int input, bool pressed, bsp_raw_debounce_t *debounce
+) {
+    int64_t     now  = esp_timer_get_time();
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    raw_ring_t *ring = &rings[xPortGetCoreID()];
+    uint32_t    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) < RAW_RING_LEN) {
+        ring->records[head % RAW_RING_LEN] = (raw_record_t){
+            .timestamp = now,
+            .debounce  = debounce,
+            .dev_id    = dev_id,
+            .input     = input,
+            .endpoint  = endpoint,
+            .pressed   = pressed,
+        };
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    } else {
+        atomic_fetch_add_explicit(&raw_dropped, 1, memory_order_relaxed);
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(raw_thread_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
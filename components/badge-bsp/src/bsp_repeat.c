@@ -0,0 +1,207 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "bsp_event.h"
+#include "bsp/alloc_count.h"
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+#include <string.h>
+
+
+
+// Period of one timer wheel tick in milliseconds.
+#define REPEAT_TICK_MS 10
+// Number of slots in the timer wheel; must be a power of 2.
+#define WHEEL_SLOTS    32
+// Maximum number of simultaneously repeating keys.
+#define REPEAT_MAX     CONFIG_BSP_INPUT_REPEAT_MAX
+
+// Add an event to the ring without applying the overflow policy or waking the event thread.
+bool bsp_event_queue_nowake(bsp_event_t const *event);
+// Wake the event thread after `bsp_event_queue_nowake`.
+void bsp_event_wake();
+
+// Repeating key.
+typedef struct {
+    // Whether this entry is in use.
+    bool        in_use;
+    // Next entry in the same wheel slot, or -1.
+    int8_t      next;
+    // Tick on which this key repeats next.
+    uint32_t    deadline;
+    // Repeat period in ticks.
+    uint32_t    period;
+    // Event to send on every repeat.
+    bsp_event_t event;
+} repeat_ent_t;
+
+// Spinlock that protects the timer wheel.
+static portMUX_TYPE  repeat_lock = portMUX_INITIALIZER_UNLOCKED;
+// Timer that drives the wheel; only armed while any key is repeating.
+static TimerHandle_t repeat_timer;
+// Whether the timer is currently armed.
+static bool          repeat_running;
+// Current timer wheel tick.
+static uint32_t      repeat_tick;
+// Number of entries in use.
+static size_t        repeat_active;
+// Repeating keys.
+static repeat_ent_t  repeat_ents[REPEAT_MAX];
+// First entry per wheel slot, or -1.
+static int8_t        wheel[WHEEL_SLOTS];
+
+
+
+// Convert milliseconds to wheel ticks, rounding up to at least one tick.
+static uint32_t ms_to_ticks(uint16_t ms) {
+    uint32_t ticks = (ms + REPEAT_TICK_MS - 1) / REPEAT_TICK_MS;
+    return ticks ?: 1;
+}
+
+// Add an entry to the wheel slot of its deadline.
+static void wheel_insert(int index) {
+    uint32_t slot           = repeat_ents[index].deadline % WHEEL_SLOTS;
+    repeat_ents[index].next = wheel[slot];
+    wheel[slot]             = index;
+}
+
+// Remove an entry from the wheel slot of its deadline.
+static void wheel_remove(int index) {
+    int8_t *cur = &wheel[repeat_ents[index].deadline % WHEEL_SLOTS];
+    while (*cur != index) {
+        cur = &repeat_ents[*cur].next;
+    }
+    *cur = repeat_ents[index].next;
+}
+
+// Remove an entry from the wheel and mark it as free.
+static void repeat_free(int index) {
+    wheel_remove(index);
+    repeat_ents[index].in_use = false;
+    repeat_active--;
+}
+
+// Find the entry for a key, or -1 if it isn't repeating.
+static int repeat_find(uint32_t dev_id, uint8_t endpoint, int raw_input, bool any_input) {
+    for (int i = 0; i < REPEAT_MAX; i++) {
+        bsp_input_event_t const *input = &repeat_ents[i].event.input;
+        if (repeat_ents[i].in_use && input->dev_id == dev_id && input->endpoint == endpoint &&
+            (any_input || input->raw_input == raw_input)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Arm the wheel timer from either task or interrupt context.
+static void repeat_arm() {
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        xTimerStartFromISR(repeat_timer, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTimerStart(repeat_timer, 0);
+    }
+}
+
+// Timer callback; advances the wheel by one tick and sends events for due keys.
+// Events are queued while holding `repeat_lock` so that a key release, which first stops the repeat,
+// can never be queued between a key's hold event being generated and being queued.
+static void repeat_timer_cb(TimerHandle_t timer) {
+    int64_t now    = esp_timer_get_time();
+    bool    queued = false;
+
+    taskENTER_CRITICAL(&repeat_lock);
+    repeat_tick++;
+    uint32_t slot = repeat_tick % WHEEL_SLOTS;
+    int      cur  = wheel[slot];
+    wheel[slot]   = -1;
+    while (cur >= 0) {
+        repeat_ent_t *ent  = &repeat_ents[cur];
+        int           next = ent->next;
+        if (ent->deadline == repeat_tick) {
+            // Due this tick; send the event and schedule the next repeat.
+            // If the queue is full, the hold event is dropped; it is redundant anyway.
+            ent->event.input.timestamp  = now;
+            queued                     |= bsp_event_queue_nowake(&ent->event);
+            ent->deadline              += ent->period;
+        }
+        wheel_insert(cur);
+        cur = next;
+    }
+    bool rearm = repeat_active > 0;
+    if (!rearm) {
+        repeat_running = false;
+    }
+    taskEXIT_CRITICAL(&repeat_lock);
+
+    if (rearm) {
+        xTimerStart(timer, 0);
+    }
+    if (queued) {
+        bsp_event_wake();
+    }
+}
+
+// Initialize the key repeat timer wheel.
+void bsp_repeat_init() {
+    memset(wheel, -1, sizeof(wheel));
+    repeat_timer = xTimerCreate("bsp_repeat", pdMS_TO_TICKS(REPEAT_TICK_MS) ?: 1, pdFALSE, NULL, repeat_timer_cb);
+    // Key repeat events are queued from the timer task.
+    bsp_alloc_count_add_input_task(xTimerGetTimerDaemonTaskHandle());
+}
+
+// Start repeating a key that was just pressed; replaces any other key repeating on the same endpoint.
+// May be called from interrupt context.
+void bsp_repeat_start(bsp_event_t const *event, uint16_t delay_ms, uint16_t period_ms) {
+    bool arm = false;
+
+    taskENTER_CRITICAL_SAFE(&repeat_lock);
+    int index = repeat_find(event->input.dev_id, event->input.endpoint, 0, true);
+    if (index >= 0) {
+        repeat_free(index);
+    }
+    for (index = 0; index < REPEAT_MAX && repeat_ents[index].in_use; index++) continue;
+    if (index < REPEAT_MAX) {
+        repeat_ent_t *ent     = &repeat_ents[index];
+        ent->in_use           = true;
+        ent->deadline         = repeat_tick + ms_to_ticks(delay_ms);
+        ent->period           = ms_to_ticks(period_ms);
+        ent->event            = *event;
+        ent->event.input.type = BSP_INPUT_EVENT_HOLD;
+        wheel_insert(index);
+        repeat_active++;
+        arm            = !repeat_running;
+        repeat_running = true;
+    }
+    taskEXIT_CRITICAL_SAFE(&repeat_lock);
+
+    if (arm) {
+        repeat_arm();
+    }
+}
+
+// Stop repeating a key that was just released.
+// May be called from interrupt context.
+void bsp_repeat_stop(uint32_t dev_id, uint8_t endpoint, int raw_input) {
+    taskENTER_CRITICAL_SAFE(&repeat_lock);
+    int index = repeat_find(dev_id, endpoint, raw_input, false);
+    if (index >= 0) {
+        repeat_free(index);
+    }
+    taskEXIT_CRITICAL_SAFE(&repeat_lock);
+}
+
+// Stop repeating all keys, e.g. because a modifier key changed.
+// May be called from interrupt context.
+void bsp_repeat_stop_all() {
+    taskENTER_CRITICAL_SAFE(&repeat_lock);
+    for (int i = 0; i < REPEAT_MAX; i++) {
+        if (repeat_ents[i].in_use) {
+            repeat_free(i);
+        }
+    }
+    taskEXIT_CRITICAL_SAFE(&repeat_lock);
+}
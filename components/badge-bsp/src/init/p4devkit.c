@@ -3,6 +3,7 @@
 
 #include "hardware/p4devkit.h"
 
+#include "bsp/init_graph.h"
 #include "bsp_device.h"
 
 
@@ -51,4 +52,6 @@ void bsp_platform_preinit() {
 void bsp_platform_init() {
     // Register BSP device tree.
     bsp_dev_register(&tree, true);
+    // No storage or radio to bring up in the background.
+    bsp_init_graph_run(NULL, 0);
 }
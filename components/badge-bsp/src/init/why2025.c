@@ -3,6 +3,7 @@
 
 #include "hardware/why2025.h"
 
+#include "bsp/init_graph.h"
 #include "bsp/why2025_coproc.h"
 
 #include <driver/sdmmc_host.h>
@@ -14,72 +15,8 @@ static char const TAG[] = "why2025";
 
 
 
-static bsp_input_devtree_t const input_tree = {
-    .common = {
-        .type = BSP_EP_INPUT_WHY2025_CH32,
-    },
-    .category           = BSP_INPUT_CAT_KEYBOARD,
-    .keymap             = &bsp_keymap_why2025,
-    .backlight_endpoint = 0,
-    .backlight_index    = 1,
-};
-
-static bsp_input_devtree_t const input2_tree = {
-    .common   = {
-        .type = BSP_EP_INPUT_GPIO,
-    },
-    .category = BSP_INPUT_CAT_GENERIC,
-    .pinmap   = &(bsp_pinmap_t const) {
-        .pins_len  = 1,
-        .pins      = (uint8_t const[]) {35},
-        .activelow = false,
-    },
-};
-
-static bsp_led_devtree_t const led_tree = {
-    .common   = {
-        .type = BSP_EP_LED_WHY2025_CH32,
-    },
-    .num_leds = 2,
-    .ledfmt   = {
-        .color = BSP_PIXFMT_16_GREY,
-    }
-};
-
-static bsp_display_devtree_t const disp_tree = {
-    .common = {
-        .type      = BSP_EP_DISP_ST7701,
-        .reset_pin = 0,
-    },
-    .pixfmt = {BSP_PIXFMT_16_565RGB, false},
-    .h_fp   = BSP_DSI_LCD_HFP,
-    .width  = BSP_DSI_LCD_H_RES,
-    .h_bp   = BSP_DSI_LCD_HBP,
-    .h_sync = BSP_DSI_LCD_HSYNC,
-    .v_fp   = BSP_DSI_LCD_VFP,
-    .height = BSP_DSI_LCD_V_RES,
-    .v_bp   = BSP_DSI_LCD_VBP,
-    .v_sync = BSP_DSI_LCD_VSYNC,
-    .backlight_endpoint = 0,
-    .backlight_index    = 0,
-    .orientation        = BSP_O_ROT_CW,
-};
-
-static bsp_devtree_t const tree = {
-    .input_count = 2,
-    .input_dev = (bsp_input_devtree_t const *const[]) {
-        &input_tree,
-        &input2_tree,
-    },
-    .led_count = 1,
-    .led_dev = (bsp_led_devtree_t const *const[]){
-        &led_tree,
-    },
-    .disp_count = 1,
-    .disp_dev   = (bsp_display_devtree_t const *const[]) {
-        &disp_tree,
-    },
-};
+// Device tree compiled from `devtrees/why2025.json`.
+extern bsp_devtree_compiled_t const bsp_devtree_why2025;
 
 
 
@@ -135,17 +72,18 @@ void bsp_platform_preinit() {
 }
 
 // Try to mount SDcard.
-static void bsp_mount_sdcard() {
+static bool bsp_mount_sdcard() {
     sdcard_host.slot                     = SDMMC_HOST_SLOT_0;
     esp_vfs_fat_mount_config_t mount_cfg = VFS_FAT_MOUNT_DEFAULT_CONFIG();
     esp_err_t res = esp_vfs_fat_sdmmc_mount("/sd", &sdcard_host, &why2025_sdcard_config, &mount_cfg, &sd_card);
     if (res) {
         ESP_LOGE(TAG, "SDcard mount error %s (%d)", esp_err_to_name(res), res);
     }
+    return res == ESP_OK;
 }
 
 // Try to mount internal FAT filesystem.
-static void bsp_mount_fatfs() {
+static bool bsp_mount_fatfs() {
     esp_vfs_fat_mount_config_t mount_cfg = VFS_FAT_MOUNT_DEFAULT_CONFIG();
     mount_cfg.format_if_mount_failed     = true;
     wl_handle_t wl_handle                = WL_INVALID_HANDLE;
@@ -155,23 +93,34 @@ static void bsp_mount_fatfs() {
     } else {
         ESP_LOGI(TAG, "FAT filesystem mounted");
     }
+    return res == ESP_OK;
 }
 
+// Enable C6; it is found on the SDIO bus in the background and reported with a `BSP_EVENT_RADIO` event.
+static bool bsp_start_c6() {
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sdmmc_host_init());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sdmmc_host_init_slot(SDMMC_HOST_SLOT_1, &why2025_sdio_config));
+    return ESP_ERROR_CHECK_WITHOUT_ABORT(bsp_c6_init()) == ESP_OK;
+}
+
+// Background initialisation steps.
+static bsp_init_step_t const init_steps[] = {
+    // Mount the SD card; also initialises the SDMMC host.
+    {"bsp_sdcard", bsp_mount_sdcard, 0, 0},
+    // Mount the internal FAT filesystem after the SD card; registering FAT drives isn't thread-safe.
+    {"bsp_fatfs", bsp_mount_fatfs, 1 << 0, 1},
+    // Start the C6 bring-up once the SD card is done with the SDMMC host.
+    {"bsp_c6", bsp_start_c6, 1 << 0, 0},
+};
+
 // Platform-specific BSP init code.
 void bsp_platform_init() {
+    // Power up the C6 early so it has time to boot.
     ESP_ERROR_CHECK_WITHOUT_ABORT(bsp_c6_control(true, true));
 
-    // Try to mount SDcard.
-    bsp_mount_sdcard();
-
-    // Enable C6.
-    ESP_ERROR_CHECK_WITHOUT_ABORT(sdmmc_host_init());
-    ESP_ERROR_CHECK_WITHOUT_ABORT(sdmmc_host_init_slot(SDMMC_HOST_SLOT_1, &why2025_sdio_config));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(bsp_c6_init());
-
-    // Try to mount internal FAT filesystem.
-    bsp_mount_fatfs();
+    // Register BSP device tree first so the display and input are available right away.
+    bsp_dev_register_compiled(&bsp_devtree_why2025);
 
-    // Register BSP device tree.
-    bsp_dev_register(&tree, true);
+    // Storage and radio continue in the background.
+    bsp_init_graph_run(init_steps, sizeof(init_steps) / sizeof(bsp_init_step_t));
 }
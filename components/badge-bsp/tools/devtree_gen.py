@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: MIT
+
+# Generates const device trees from the JSON device tree descriptions in `devtrees/`.
+# Besides the tree itself, this emits the drivers bound to every endpoint and the endpoint init order
+# so that registering the device with `bsp_dev_register_compiled` does no sorting or driver lookups.
+
+import argparse, json, os
+
+
+
+# Endpoint types in `bsp_ep_type_t` order: JSON key, devtree C type, endpoint type enum prefix.
+ep_types = [
+    ("input", "bsp_input_devtree_t",   "BSP_EP_INPUT_"),
+    ("led",   "bsp_led_devtree_t",     "BSP_EP_LED_"),
+    ("disp",  "bsp_display_devtree_t", "BSP_EP_DISP_"),
+    ("audio", "bsp_audio_devtree_t",   "BSP_EP_AUDIO_"),
+]
+
+# Drivers per endpoint type and endpoint type name; must match `bsp/drivers.h`.
+# Endpoint types without a driver yet map to None and get a NULL driver, like `bsp_dev_register` does.
+drivers = {
+    "input": {
+        "GPIO":         "bsp_drv_input_gpio",
+        "WHY2025_CH32": "bsp_drv_input_why2025ch32",
+    },
+    "led": {
+        "WS2812":       None,
+        "WHY2025_CH32": "bsp_drv_led_why2025ch32",
+    },
+    "disp": {
+        "ST7701":       "bsp_drv_disp_st7701",
+        "EK79007":      "bsp_drv_disp_ek79007",
+    },
+    "audio": {
+        "ES8156":       None,
+    },
+}
+
+# Fields specific to each endpoint type and how to convert them.
+ep_fields = {
+    "input": {
+        "category":           "input_cat",
+        "pinmap":             "pinmap",
+        "keymap":             "keymap",
+        "backlight_endpoint": "expr",
+        "backlight_index":    "expr",
+        "repeat_delay":       "expr",
+        "repeat_period":      "expr",
+    },
+    "led": {
+        "ledfmt":             "pixfmt",
+        "num_leds":           "expr",
+    },
+    "disp": {
+        "backlight_endpoint": "expr",
+        "backlight_index":    "expr",
+        "pixfmt":             "pixfmt",
+        "orientation":        "orient",
+        "h_fp":               "expr",
+        "width":              "expr",
+        "h_bp":               "expr",
+        "h_sync":             "expr",
+        "v_fp":               "expr",
+        "height":             "expr",
+        "v_bp":               "expr",
+        "v_sync":             "expr",
+    },
+    "audio": {},
+}
+
+# Fields in `bsp_devtree_common_t` besides the endpoint type.
+common_fields = {
+    "init_prio": "expr",
+    "reset_pin": "expr",
+    "addr":      "addr",
+}
+
+
+
+def load_devtree(path: str) -> dict:
+    fd = open(path, "r")
+    devtree = json.load(fd)
+    fd.close()
+    if "name" not in devtree:
+        devtree["name"] = os.path.splitext(os.path.basename(path))[0]
+    for ep_type, _, _ in ep_types:
+        for index, ep in enumerate(devtree.get(ep_type, [])):
+            where = f"{path}: {ep_type} endpoint {index}"
+            if ep.get("type") not in drivers[ep_type]:
+                raise ValueError(f"{where}: Unknown endpoint type {ep.get('type')}")
+            for field in ep:
+                if field != "type" and field not in ep_fields[ep_type] and field not in common_fields:
+                    raise ValueError(f"{where}: Unknown field {field}")
+    return devtree
+
+def c_expr(value) -> str:
+    if isinstance(value, bool):
+        return "true" if value else "false"
+    else:
+        return str(value)
+
+def c_field(kind: str, value, prefix: str) -> str:
+    if kind == "input_cat":
+        return f"BSP_INPUT_CAT_{value}"
+    elif kind == "orient":
+        return f"BSP_O_{value}"
+    elif kind == "keymap":
+        return f"&bsp_keymap_{value}"
+    elif kind == "pinmap":
+        return f"&{prefix}_pinmap"
+    elif kind == "pixfmt":
+        return f"{{BSP_PIXFMT_{value['color']}, {c_expr(value.get('reversed', False))}}}"
+    elif kind == "addr":
+        return f"{{BSP_BUS_{value['bus']}, {value.get('controller', 0)}, {value.get('device', 0)}}}"
+    else:
+        return c_expr(value)
+
+def write_fields(fd, fields: list[tuple[str, str]], indent: str):
+    width = max(len(name) for name, _ in fields)
+    for name, value in fields:
+        fd.write(f"{indent}.{name:{width}} = {value},\n")
+
+def gen_endpoint(fd, name: str, ep_type: str, ctype: str, enum_prefix: str, index: int, ep: dict) -> str:
+    prefix = f"{name}_{ep_type}{index}"
+    if "pinmap" in ep:
+        pinmap = ep["pinmap"]
+        fd.write(f"static uint8_t const {prefix}_pins[] = {{{', '.join(str(pin) for pin in pinmap['pins'])}}};\n")
+        pinmap_fields = [
+            ("activelow", c_expr(pinmap.get("activelow", False))),
+            ("pins_len",  str(len(pinmap["pins"]))),
+            ("pins",      f"{prefix}_pins"),
+        ]
+        if "debounce_ms" in pinmap:
+            if len(pinmap["debounce_ms"]) != len(pinmap["pins"]):
+                raise ValueError(f"{name}: {ep_type} endpoint {index} has a debounce time count that doesn't match the pin count")
+            fd.write(f"static uint16_t const {prefix}_debounce_ms[] = {{{', '.join(str(ms) for ms in pinmap['debounce_ms'])}}};\n")
+            pinmap_fields.append(("debounce_ms", f"{prefix}_debounce_ms"))
+        fd.write(f"static bsp_pinmap_t const {prefix}_pinmap = {{\n")
+        write_fields(fd, pinmap_fields, "    ")
+        fd.write("};\n")
+
+    fd.write(f"static {ctype} const {prefix} = {{\n")
+    fd.write("    .common = {\n")
+    common = [("type", enum_prefix + ep["type"])]
+    common += [(field, c_field(kind, ep[field], prefix)) for field, kind in common_fields.items() if field in ep]
+    write_fields(fd, common, "        ")
+    fd.write("    },\n")
+    fields = [(field, c_field(kind, ep[field], prefix)) for field, kind in ep_fields[ep_type].items() if field in ep]
+    if fields:
+        write_fields(fd, fields, "    ")
+    fd.write("};\n\n")
+    return prefix
+
+def gen_devtree(fd, devtree: dict):
+    name = devtree["name"]
+    fd.write(f"// {devtree.get('description', name)}.\n")
+
+    # Endpoint trees and the drivers bound to them.
+    tree_fields   = []
+    driver_fields = []
+    init_order    = []
+    for ep_type, ctype, enum_prefix in ep_types:
+        eps = devtree.get(ep_type, [])
+        if not eps:
+            continue
+        names = [gen_endpoint(fd, name, ep_type, ctype, enum_prefix, i, ep) for i, ep in enumerate(eps)]
+        fd.write(f"static {ctype} const *const {name}_{ep_type}_dev[] = {{\n")
+        for ep_name in names:
+            fd.write(f"    &{ep_name},\n")
+        fd.write("};\n")
+        fd.write(f"static bsp_driver_common_t const *const {name}_{ep_type}_drivers[] = {{\n")
+        for ep in eps:
+            driver = drivers[ep_type][ep["type"]]
+            fd.write(f"    &{driver}.common,\n" if driver else "    NULL,\n")
+        fd.write("};\n\n")
+        tree_fields   += [(f"{ep_type}_count", str(len(eps))), (f"{ep_type}_dev", f"{name}_{ep_type}_dev")]
+        driver_fields += [(f"[{enum_prefix[:-1]}]", f"{name}_{ep_type}_drivers")]
+        for i, ep in enumerate(eps):
+            init_order.append((ep.get("init_prio", 0), enum_prefix[:-1], i))
+
+    # Stable sort, so this matches the order `bsp_dev_register` would compute.
+    init_order.sort(key=lambda entry: entry[0])
+    fd.write(f"static bsp_ep_init_t const {name}_init_order[] = {{\n")
+    for prio, type_enum, i in init_order:
+        fd.write(f"    {{.type = {type_enum}, .endpoint = {i}, .init_prio = {prio}}},\n")
+    fd.write("};\n\n")
+
+    fd.write(f"bsp_devtree_compiled_t const bsp_devtree_{name} = {{\n")
+    fd.write("    .tree = &(bsp_devtree_t const){\n")
+    write_fields(fd, tree_fields, "        ")
+    fd.write("    },\n")
+    fd.write("    .drivers = {\n")
+    width = max(len(index) for index, _ in driver_fields)
+    for index, value in driver_fields:
+        fd.write(f"        {index:{width}} = {value},\n")
+    fd.write("    },\n")
+    fd.write(f"    .init_order     = {name}_init_order,\n")
+    fd.write(f"    .init_order_len = {len(init_order)},\n")
+    fd.write("};\n\n\n\n")
+
+def gen_devtrees(devtrees: list[dict], path: str):
+    fd = open(path, "w")
+    fd.write("// WARNING: This is a generated file, do not edit it!\n")
+    fd.write("// clang-format off\n")
+    fd.write("\n")
+    fd.write("#include \"bsp_devtree.h\"\n")
+    fd.write("\n")
+    fd.write("#include \"bsp/drivers.h\"\n")
+    for include in sorted(set(include for devtree in devtrees for include in devtree.get("includes", []))):
+        fd.write(f"#include \"{include}\"\n")
+    fd.write("\n")
+    fd.write("\n")
+    fd.write("\n")
+    for devtree in devtrees:
+        gen_devtree(fd, devtree)
+    fd.close()
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--output", action="store", required=True)
+    parser.add_argument("devtrees", action="store", nargs="+")
+    args = parser.parse_args()
+    devtrees = [load_devtree(path) for path in args.devtrees]
+    gen_devtrees(devtrees, args.output)
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: MIT
+
+# Generates precompiled keymap tables from the JSON keymap descriptions in `keymaps/`.
+# For every layout, this emits the scancode to input table as well as flat text, navigation and modifier key tables
+# so that translating a key event at runtime is just a couple of table lookups.
+
+import argparse, json, os
+
+
+
+# Number of modifier classes; must match `BSP_KEYMAP_CLASSES`.
+CLASSES     = 8
+# Modifier class bit for shift; must match `BSP_KEYMAP_CLASS_SHIFT`.
+CLASS_SHIFT = 1
+# Modifier class bit for caps lock; must match `BSP_KEYMAP_CLASS_CAPS`.
+CLASS_CAPS  = 2
+# Modifier class bit for function; must match `BSP_KEYMAP_CLASS_FN`.
+CLASS_FN    = 4
+
+# Keyboard buttons that produce printable text, with their unshifted and shifted characters.
+printable = {
+    "SPACE":        (' ',  ' '),
+    "KB_TILDA":     ('`',  '~'),
+    "KB_1":         ('1',  '!'),
+    "KB_2":         ('2',  '@'),
+    "KB_3":         ('3',  '#'),
+    "KB_4":         ('4',  '$'),
+    "KB_5":         ('5',  '%'),
+    "KB_6":         ('6',  '^'),
+    "KB_7":         ('7',  '&'),
+    "KB_8":         ('8',  '*'),
+    "KB_9":         ('9',  '('),
+    "KB_0":         ('0',  ')'),
+    "KB_MINUS":     ('-',  '_'),
+    "KB_EQUALS":    ('=',  '+'),
+    "KB_LBRAC":     ('[',  '{'),
+    "KB_RBRAC":     (']',  '}'),
+    "KB_BACKSLASH": ('\\', '|'),
+    "KB_SEMICOLON": (';',  ':'),
+    "KB_QUOTE":     ('\'', '"'),
+    "KB_COMMA":     (',',  '<'),
+    "KB_DOT":       ('.',  '>'),
+    "KB_SLASH":     ('/',  '?'),
+}
+
+# Modifier keys and their bit index in `bsp_input_event_t::modkeys`.
+modkey_index = {
+    "L_SHIFT":   0,
+    "R_SHIFT":   1,
+    "L_CTRL":    6,
+    "R_CTRL":    7,
+    "L_ALT":     8,
+    "R_ALT":     9,
+    "FUNCTION":  11,
+    "NUM_LK":    12,
+    "CAPS_LK":   13,
+    "SCROLL_LK": 15,
+}
+
+
+
+def load_keymap(path: str) -> dict:
+    fd = open(path, "r")
+    keymap = json.load(fd)
+    fd.close()
+    columns = keymap["columns"]
+    keys = []
+    for row in keymap["rows"]:
+        if len(row) != columns:
+            raise ValueError(f"{path}: Row {len(keys) // columns} has {len(row)} keys, expected {columns}")
+        keys += row
+    keymap["keys"] = keys
+    if "name" not in keymap:
+        keymap["name"] = os.path.splitext(os.path.basename(path))[0]
+    return keymap
+
+def key_text(key: str, cls: int) -> int:
+    shift = bool(cls & CLASS_SHIFT)
+    caps  = bool(cls & CLASS_CAPS)
+    fn    = bool(cls & CLASS_FN)
+    if key == "BACKSPACE":
+        return 0x7f if fn else ord('\b')
+    elif key == "DELETE":
+        return 0x7f
+    elif key == "ENTER":
+        return ord('\n')
+    elif key.startswith("KB_") and len(key) == 4 and key[3].isalpha():
+        return ord(key[3].lower() if shift == caps else key[3])
+    elif key in printable:
+        return ord(printable[key][shift])
+    else:
+        return 0
+
+def key_nav(key: str, shift: bool) -> str:
+    if key in ("ENTER", "NP_ENTER"):
+        return "ACCEPT"
+    elif key in ("BACKSPACE", "ESCAPE"):
+        return "BACK"
+    elif key == "TAB":
+        return "PREV" if shift else "NEXT"
+    else:
+        return key
+
+def c_char(value: int) -> str:
+    if value == 0:
+        return "0"
+    elif value == ord('\\') or value == ord('\''):
+        return f"'\\{chr(value)}'"
+    elif value == ord('\n'):
+        return "'\\n'"
+    elif value == ord('\b'):
+        return "'\\b'"
+    elif value < 0x20 or value >= 0x7f:
+        return f"0x{value:02x}"
+    else:
+        return f"'{chr(value)}'"
+
+def write_table(fd, ctype: str, name: str, rows: list[list[str]], columns: int):
+    width = max(len(entry) for row in rows for entry in row) + 1
+    fd.write(f"static {ctype} const {name}[] = {{\n")
+    for row in rows:
+        for i in range(0, len(row), columns):
+            fd.write("    " + " ".join(f"{entry + ',':{width}}" for entry in row[i:i+columns]).rstrip() + "\n")
+    fd.write("};\n\n")
+
+def gen_keymap(fd, keymap: dict):
+    name    = keymap["name"]
+    keys    = keymap["keys"]
+    columns = keymap["columns"]
+    for key in keys:
+        if key in modkey_index and key_text(key, 0):
+            raise ValueError(f"Modifier key {key} cannot produce text")
+
+    fd.write(f"// {keymap.get('description', name)}.\n")
+    write_table(fd, "uint16_t", f"{name}_keymap", [[f"BSP_INPUT_{key}" for key in keys]], columns)
+    write_table(fd, "char", f"{name}_text", [[c_char(key_text(key, cls)) for key in keys] for cls in range(CLASSES)], columns)
+    write_table(fd, "uint16_t", f"{name}_nav", [[f"BSP_INPUT_{key_nav(key, shift)}" for key in keys] for shift in (False, True)], columns)
+    write_table(fd, "int8_t", f"{name}_modkey", [[str(modkey_index.get(key, -1)) for key in keys]], columns)
+
+    fd.write(f"bsp_keymap_t const bsp_keymap_{name} = {{\n")
+    fd.write(f"    .max_scancode = {len(keys)},\n")
+    fd.write(f"    .keymap       = {name}_keymap,\n")
+    fd.write(f"    .name         = \"{name}\",\n")
+    fd.write(f"    .text         = {name}_text,\n")
+    fd.write(f"    .nav          = {name}_nav,\n")
+    fd.write(f"    .modkey       = {name}_modkey,\n")
+    fd.write("};\n\n\n\n")
+
+def gen_keymaps(keymaps: list[dict], path: str):
+    fd = open(path, "w")
+    fd.write("// WARNING: This is a generated file, do not edit it!\n")
+    fd.write("// clang-format off\n")
+    fd.write("\n")
+    fd.write("#include \"bsp_keymap.h\"\n")
+    fd.write("\n")
+    fd.write("#include \"bsp_input.h\"\n")
+    fd.write("\n")
+    fd.write("\n")
+    fd.write("\n")
+    for keymap in keymaps:
+        gen_keymap(fd, keymap)
+    fd.write("// Precompiled keyboard layouts.\n")
+    fd.write("bsp_keymap_t const *const bsp_keymaps[] = {\n")
+    for keymap in keymaps:
+        fd.write(f"    &bsp_keymap_{keymap['name']},\n")
+    fd.write("};\n")
+    fd.write("// Number of precompiled keyboard layouts.\n")
+    fd.write(f"size_t const bsp_keymaps_len = {len(keymaps)};\n")
+    fd.close()
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--output", action="store", required=True)
+    parser.add_argument("keymaps",  action="store", nargs="+")
+    args = parser.parse_args()
+    keymaps = [load_keymap(path) for path in args.keymaps]
+    gen_keymaps(keymaps, args.output)
@@ -135,7 +135,10 @@ static esp_err_t panel_ek79007_send_init_cmds(ek79007_panel_t *ek79007)
         // Send command
         ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_param(io, init_cmds[i].cmd, init_cmds[i].data, init_cmds[i].data_bytes),
                             TAG, "send command failed");
-        vTaskDelay(pdMS_TO_TICKS(init_cmds[i].delay_ms));
+        // Don't yield for commands that need no delay
+        if (init_cmds[i].delay_ms) {
+            vTaskDelay(pdMS_TO_TICKS(init_cmds[i].delay_ms));
+        }
     }
     ESP_LOGD(TAG, "send init commands success");
 
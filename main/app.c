@@ -3,13 +3,65 @@
 
 #include "app.h"
 
+#include "app_index.h"
 #include "appelf.h"
-#include "arrays.h"
+#include "arena.h"
+#include "bsp.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "meta_json.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 
 static char const TAG[] = "app";
 
+// Number of detected apps that can be waiting to be added to the apps list.
+#define SCAN_QUEUE_LEN   8
+// Stack size of the app source scan tasks.
+#define SCAN_STACK_SIZE  4096
+// Priority of the app source scan tasks; the same as the launcher, which yields to them while waiting for results.
+#define SCAN_PRIORITY    (tskIDLE_PRIORITY + 1)
+// Minimum chunk size of the per-source string arenas.
+#define ARENA_CHUNK_SIZE 1024
+// Initial capacity of the apps list.
+#define APP_LIST_MIN_CAP 16
+// Time the scan start task waits for background initialisation at once, so stopping detection never waits longer.
+#define SCAN_WAIT_MS     10
+
+// Message from an app source scan task.
+typedef struct {
+    // Source that sent this message.
+    app_source_t source;
+    // Source is done scanning; `gen` is valid instead of `app`.
+    bool         done;
+    // Generation of the source, if `done`.
+    uint32_t     gen;
+    // Detected app, if not `done`.
+    app_meta_t   app;
+} scan_msg_t;
+
+// App source description.
+typedef struct {
+    // Name for logging and the scan task.
+    char const *name;
+    // Directory that contains an app directory per app, or NULL for AppFS.
+    char const *root;
+} app_source_desc_t;
+
+// App sources.
+static app_source_desc_t const sources[APP_SOURCE_COUNT] = {
+    [APP_SOURCE_APPFS] = {"appfs", NULL},
+    [APP_SOURCE_INT]   = {"int", "/int/apps"},
+    [APP_SOURCE_SD]    = {"sd", "/sd/apps"},
+};
+
 
 
 // List of detected apps.
@@ -17,68 +69,312 @@ app_meta_t *app_list     = NULL;
 // Number of detected apps.
 size_t      app_list_len = 0;
 
+// Capacity of `app_list`.
+static size_t  app_list_cap;
+// Strings of the detected apps per source; each is only allocated from by its scan task.
+static arena_t app_arena[APP_SOURCE_COUNT] = {
+    ARENA_INIT(ARENA_CHUNK_SIZE),
+    ARENA_INIT(ARENA_CHUNK_SIZE),
+    ARENA_INIT(ARENA_CHUNK_SIZE),
+};
+// Detected apps from the scan tasks.
+static QueueHandle_t scan_queue;
+// App index the scan tasks take the apps of unchanged sources from.
+static app_index_t  *scan_index;
+// Generation of each source, as reported by the scan tasks.
+static uint32_t      scan_gen[APP_SOURCE_COUNT];
+// Number of scan tasks that haven't finished.
+static size_t        scan_running;
+// Whether each source is done scanning.
+static bool          scan_done[APP_SOURCE_COUNT];
+// Tells the scan tasks to stop early.
+static volatile bool scan_abort;
+
 
 
-// Clean up an app meta struct.
+// Clean up an app meta struct; its strings are freed with its source's arena.
 static void app_meta_del(app_meta_t app) {
-    free(app.id);
-    free(app.name);
-    free(app.main_path);
     if (app.icon_img) {
         pax_buf_destroy(app.icon_img);
     }
 }
 
-// Add an app to the list.
+// Add an app to the list after the apps of the same and earlier sources.
+// Scan tasks finish in any order, so this keeps the list order stable.
 static void app_add(app_meta_t app) {
-    if (array_len_insert(&app_list, sizeof(app_meta_t), &app_list_len, &app, app_list_len)) {
-        ESP_LOGI(TAG, "Registerred app '%s'", app.name);
-    } else {
-        app_meta_del(app);
+    if (app_list_len >= app_list_cap) {
+        // Grow geometrically so adding all apps takes linear time.
+        size_t      cap  = app_list_cap ? app_list_cap * 2 : APP_LIST_MIN_CAP;
+        app_meta_t *list = realloc(app_list, cap * sizeof(app_meta_t));
+        if (!list) {
+            ESP_LOGE(TAG, "Out of memory");
+            app_meta_del(app);
+            return;
+        }
+        app_list     = list;
+        app_list_cap = cap;
+    }
+    size_t index = app_list_len;
+    while (index && app_list[index - 1].source > app.source) {
+        index--;
     }
+    memmove(app_list + index + 1, app_list + index, (app_list_len - index) * sizeof(app_meta_t));
+    app_list[index] = app;
+    app_list_len++;
+    ESP_LOGI(TAG, "Registerred app '%s'", app.name);
 }
 
-// Read metadata.
-static app_meta_t app_read_metadata(char const *id) {
+// Create app metadata with only an ID.
+static app_meta_t app_new(arena_t *arena, char const *id) {
     return (app_meta_t){
-        .id        = strdup(id),
+        .id        = arena_strdup(arena, id),
         .name      = NULL,
         .desc      = NULL,
         .main_path = NULL,
+        .icon_path = NULL,
         .icon_img  = NULL,
     };
 }
 
-// Detect apps, updating `app_list` and `app_list_len`.
-void app_detect() {
-    app_list_clear();
-    ESP_LOGI(TAG, "Scanning for installed apps");
-    // Read AppFS apps.
+// Send a detected app to the launcher; cleans it up instead if the scan was aborted.
+static void scan_send(app_source_t source, app_meta_t app) {
+    app.source = source;
+    if (scan_abort) {
+        app_meta_del(app);
+        return;
+    }
+    scan_msg_t msg = {.source = source, .app = app};
+    xQueueSend(scan_queue, &msg, portMAX_DELAY);
+}
+
+// Scan AppFS for apps.
+static void scan_appfs() {
     appfs_handle_t fd = appfsNextEntry(APPFS_INVALID_FD);
-    while (fd != APPFS_INVALID_FD) {
+    while (fd != APPFS_INVALID_FD && !scan_abort) {
         char const *id;
         char const *name;
         appfsEntryInfoExt(fd, &id, &name, NULL, NULL);
-        app_meta_t meta      = app_read_metadata(id);
+        app_meta_t meta      = app_new(&app_arena[APP_SOURCE_APPFS], id);
         bool       is_appfs2 = appelf_appfs_detect(fd) == ESP_OK;
         meta.type            = is_appfs2 ? APP_TYPE_APPFS_ELF : APP_TYPE_APPFS_ESP;
         meta.appfs_fd        = fd;
         if (!meta.name) {
-            meta.name = strdup(name);
+            meta.name = arena_strdup(&app_arena[APP_SOURCE_APPFS], name);
         }
-        app_add(meta);
+        scan_send(APP_SOURCE_APPFS, meta);
         fd = appfsNextEntry(fd);
     }
 }
 
-// Clear the apps list.
+// Resolve a path relative to an app directory and copy it into the arena.
+static char *app_path(arena_t *arena, char const *dir, char const *path) {
+    if (path[0] == '/') {
+        return (char *)path;
+    }
+    char buf[APP_PATH_MAX];
+    if (snprintf(buf, sizeof(buf), "%s/%s", dir, path) >= (int)sizeof(buf)) {
+        return NULL;
+    }
+    return arena_strdup(arena, buf);
+}
+
+// Create the metadata of a filesystem app before reading its `meta.json`.
+static app_meta_t scan_dir_meta(arena_t *arena, char const *id) {
+    app_meta_t meta = app_new(arena, id);
+    meta.type       = APP_TYPE_RAM_ELF;
+    meta.appfs_fd   = APPFS_INVALID_FD;
+    return meta;
+}
+
+// Scan the app directories in a filesystem directory for apps.
+static void scan_dir(app_source_t source, char const *root) {
+    DIR *dir = opendir(root);
+    if (!dir) {
+        return;
+    }
+    arena_t       *arena = &app_arena[source];
+    char           app_dir[APP_PATH_MAX];
+    char           path[APP_PATH_MAX];
+    struct dirent *ent;
+    while (!scan_abort && (ent = readdir(dir))) {
+        if (ent->d_type != DT_DIR || ent->d_name[0] == '.' ||
+            snprintf(app_dir, sizeof(app_dir), "%s/%s", root, ent->d_name) >= (int)sizeof(app_dir) ||
+            snprintf(path, sizeof(path), "%s/" APP_META_FILE, app_dir) >= (int)sizeof(path)) {
+            continue;
+        }
+        app_meta_t meta = scan_dir_meta(arena, ent->d_name);
+        FILE      *fd   = fopen(path, "rb");
+        if (fd) {
+            if (!meta_json_parse(fd, arena, &meta)) {
+                // Don't use fields from before the error; the app is still detected by its executable.
+                meta = scan_dir_meta(arena, ent->d_name);
+            }
+            fclose(fd);
+        }
+
+        // Apps are directories with an ELF executable in them, which `meta.json` may point elsewhere.
+        meta.main_path = app_path(arena, app_dir, meta.main_path ?: APP_MAIN_FILE);
+        if (!meta.id || !meta.main_path || appelf_vfs_detect(meta.main_path) != ESP_OK) {
+            continue;
+        }
+        struct stat st;
+        if (meta.icon_path) {
+            meta.icon_path = app_path(arena, app_dir, meta.icon_path);
+        } else if (snprintf(path, sizeof(path), "%s/" APP_ICON_FILE, app_dir) < (int)sizeof(path) &&
+                   !stat(path, &st)) {
+            meta.icon_path = arena_strdup(arena, path);
+        }
+        scan_send(source, meta);
+    }
+    closedir(dir);
+}
+
+// App source scan task.
+static void scan_task(void *arg) {
+    app_source_t source = (app_source_t)(uintptr_t)arg;
+    char const  *root   = sources[source].root;
+    uint32_t     gen    = root ? app_index_dir_gen(root) : app_index_appfs_gen();
+    if (app_index_source_valid(scan_index, source, gen)) {
+        // Unchanged since the index was saved.
+        size_t count = 0;
+        for (size_t i = 0; i < app_index_len(scan_index) && !scan_abort; i++) {
+            app_meta_t meta;
+            if (app_index_get(scan_index, i, source, &app_arena[source], &meta)) {
+                scan_send(source, meta);
+                count++;
+            }
+        }
+        ESP_LOGI(TAG, "Loaded %zu %s apps from the index", count, sources[source].name);
+    } else if (root) {
+        ESP_LOGI(TAG, "Scanning for %s apps", sources[source].name);
+        scan_dir(source, root);
+    } else {
+        ESP_LOGI(TAG, "Scanning for %s apps", sources[source].name);
+        scan_appfs();
+    }
+    scan_msg_t msg = {.source = source, .done = true, .gen = gen};
+    xQueueSend(scan_queue, &msg, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+// Task that waits for the filesystems to be mounted, then loads the app index and starts the scan tasks.
+// Sends a done message for every source it could not start a scan task for.
+static void scan_start_task(void *arg) {
+    (void)arg;
+    // Bounded by the BSP's background initialisation time budget; `scan_stop` waits for this task, so check often.
+    while (!scan_abort && !bsp_init_done()) {
+        bsp_init_wait(SCAN_WAIT_MS);
+    }
+    if (!scan_abort) {
+        scan_index = app_index_load();
+    }
+    for (int i = 0; i < APP_SOURCE_COUNT; i++) {
+        void *arg = (void *)(uintptr_t)i;
+        if (scan_abort) {
+            // Detection was stopped while waiting; skip the scan.
+        } else if (xTaskCreate(scan_task, sources[i].name, SCAN_STACK_SIZE, arg, SCAN_PRIORITY, NULL) == pdPASS) {
+            continue;
+        } else {
+            ESP_LOGE(TAG, "Failed to start %s app scan", sources[i].name);
+        }
+        scan_msg_t msg = {.source = i, .done = true};
+        xQueueSend(scan_queue, &msg, portMAX_DELAY);
+    }
+    vTaskDelete(NULL);
+}
+
+// Stop the scan tasks and wait for them to finish; they check `scan_abort` often, so this doesn't take long.
+static void scan_stop() {
+    scan_abort = true;
+    while (scan_running) {
+        scan_msg_t msg;
+        xQueueReceive(scan_queue, &msg, portMAX_DELAY);
+        if (msg.done) {
+            scan_running--;
+        } else {
+            app_meta_del(msg.app);
+        }
+    }
+    scan_abort = false;
+    app_index_free(scan_index);
+    scan_index = NULL;
+}
+
+
+
+// Detect apps, updating `app_list` and `app_list_len`.
+void app_detect() {
+    app_detect_start();
+    while (app_detect_step()) {
+        vTaskDelay(1);
+    }
+}
+
+// Start detecting apps incrementally in background tasks; clears the apps list.
+// Sources that didn't change since the app index was saved are read from the index instead.
+void app_detect_start() {
+    app_list_clear();
+    memset(scan_done, 0, sizeof(scan_done));
+    if (!scan_queue) {
+        scan_queue = xQueueCreate(SCAN_QUEUE_LEN, sizeof(scan_msg_t));
+        if (!scan_queue) {
+            ESP_LOGE(TAG, "Out of memory");
+            return;
+        }
+    }
+    // `/int` and `/sd` are mounted in the background, so only touch them once that is done.
+    if (xTaskCreate(scan_start_task, "app_scan", SCAN_STACK_SIZE, NULL, SCAN_PRIORITY, NULL) == pdPASS) {
+        scan_running = APP_SOURCE_COUNT;
+    } else {
+        ESP_LOGE(TAG, "Failed to start app scan");
+    }
+}
+
+// Add apps found so far to the apps list; returns false when all sources are done.
+bool app_detect_step() {
+    if (!scan_running) {
+        return false;
+    }
+    // Never block; the caller decides when to give the scan tasks the CPU.
+    // Takes at most a queue's worth of results so a fast scan can't hold up the caller.
+    scan_msg_t msg;
+    for (int i = 0; i < SCAN_QUEUE_LEN && xQueueReceive(scan_queue, &msg, 0); i++) {
+        if (!msg.done) {
+            app_add(msg.app);
+            continue;
+        }
+        scan_gen[msg.source]  = msg.gen;
+        scan_done[msg.source] = true;
+        if (!--scan_running) {
+            break;
+        }
+    }
+    if (scan_running) {
+        return true;
+    }
+    // Remember the result so the next detection can skip unchanged sources.
+    app_index_save(scan_index, scan_gen);
+    app_index_free(scan_index);
+    scan_index = NULL;
+    return false;
+}
+
+// Whether a source is done scanning, so its apps in the apps list are complete.
+bool app_detect_source_done(app_source_t source) {
+    return scan_done[source];
+}
+
+// Clear the apps list; stops detection if it is still running.
+// Keeps the list's memory for the next detection.
 void app_list_clear() {
+    scan_stop();
     for (size_t i = 0; i < app_list_len; i++) {
         app_meta_del(app_list[i]);
     }
-    free(app_list);
-    app_list     = NULL;
     app_list_len = 0;
+    for (int i = 0; i < APP_SOURCE_COUNT; i++) {
+        arena_reset(&app_arena[i]);
+    }
 }
 
 // Start an app.
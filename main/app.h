@@ -5,8 +5,34 @@
 
 #include "pax_gfx.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 
 
+
+// Maximum length of app file paths.
+#define APP_PATH_MAX  128
+// App metadata file in filesystem app directories.
+#define APP_META_FILE "meta.json"
+// App executable in filesystem app directories.
+#define APP_MAIN_FILE "main.elf"
+// App icon in filesystem app directories.
+#define APP_ICON_FILE "icon.png"
+
+
+
+// Places apps are detected in.
+typedef enum {
+    // AppFS partition.
+    APP_SOURCE_APPFS,
+    // `/int/apps` on the internal FAT filesystem.
+    APP_SOURCE_INT,
+    // `/sd/apps` on the SD card.
+    APP_SOURCE_SD,
+    // Number of app sources.
+    APP_SOURCE_COUNT,
+} app_source_t;
+
 // Application types.
 typedef enum {
     // AppFS ESP-IDF firmware.
@@ -23,20 +49,24 @@ typedef enum {
 
 // Application metadata.
 typedef struct {
+    // Source the app was detected in.
+    app_source_t source;
     // Application type.
-    app_type_t type;
+    app_type_t   type;
     // Application slug / ID.
-    char      *id;
+    char        *id;
     // Display name.
-    char      *name;
+    char        *name;
     // Description.
-    char      *desc;
+    char        *desc;
     // Main binary / executable path.
-    char      *main_path;
+    char        *main_path;
     // AppFS handle.
-    int        appfs_fd;
+    int          appfs_fd;
+    // App icon path, if any.
+    char        *icon_path;
     // App icon, if any.
-    pax_buf_t *icon_img;
+    pax_buf_t   *icon_img;
 } app_meta_t;
 
 
@@ -48,6 +78,13 @@ extern size_t      app_list_len;
 
 // Detect apps, updating `app_list` and `app_list_len`.
 void app_detect();
+// Start detecting apps incrementally in background tasks; clears the apps list.
+// Sources that didn't change since the app index was saved are read from the index instead.
+void app_detect_start();
+// Add apps found so far to the apps list without blocking; returns false when all sources are done.
+bool app_detect_step();
+// Whether a source is done scanning, so its apps in the apps list are complete.
+bool app_detect_source_done(app_source_t source);
 // Clear the apps list.
 void app_list_clear();
 // Start an app.
@@ -0,0 +1,375 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "app_index.h"
+
+#include "app.h"
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <appfs.h>
+#include <esp_log.h>
+
+static char const TAG[] = "app_index";
+
+
+
+// App index file; uses 8.3 names so it works without FAT long file name support.
+#define INDEX_PATH        "/int/apps.idx"
+// Temporary file the index is written to before replacing `INDEX_PATH`.
+#define INDEX_TMP_PATH    "/int/apps.tmp"
+// App index magic; "AIDX".
+#define INDEX_MAGIC       0x58444941
+// App index format version.
+#define INDEX_VERSION     3
+// Maximum number of apps in an index; bounds the allocation made for a corrupt header.
+#define INDEX_MAX_APPS    1024
+// Maximum size of the string table of an index.
+#define INDEX_MAX_STRINGS (INDEX_MAX_APPS * 1024)
+// String offset that means there is no string.
+#define NO_STR            UINT32_MAX
+
+// App index file header; followed by `count` entries and then the string table.
+typedef struct {
+    // Magic; `INDEX_MAGIC`.
+    uint32_t magic;
+    // Format version; `INDEX_VERSION`.
+    uint16_t version;
+    // Size of an entry, to detect files from a different build.
+    uint16_t entry_size;
+    // Generation of each app source the index was saved for.
+    uint32_t gen[APP_SOURCE_COUNT];
+    // Bit mask of the sources the index has the apps of; the apps of other sources didn't fit.
+    uint32_t sources;
+    // Number of entries.
+    uint32_t count;
+    // Size of the string table.
+    uint32_t strings_size;
+} index_header_t;
+
+// App index entry; strings are stored as offsets into the string table.
+typedef struct {
+    // Source the app was detected in.
+    uint32_t source;
+    // Application type.
+    uint32_t type;
+    // AppFS handle.
+    int32_t  appfs_fd;
+    // Application slug / ID.
+    uint32_t id;
+    // Display name.
+    uint32_t name;
+    // Description.
+    uint32_t desc;
+    // Main binary / executable path.
+    uint32_t main_path;
+    // Icon image path.
+    uint32_t icon_path;
+} index_entry_t;
+
+// Loaded app index.
+struct app_index {
+    // File header.
+    index_header_t header;
+    // Entries.
+    index_entry_t *entries;
+    // String table.
+    char const    *strings;
+};
+
+
+
+// Add a byte sequence to an FNV-1a hash.
+static uint32_t fnv1a(uint32_t hash, void const *data, size_t len) {
+    uint8_t const *ptr = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ ptr[i]) * 16777619;
+    }
+    return hash;
+}
+
+// Add a string, including its terminator, to an FNV-1a hash.
+static uint32_t fnv1a_str(uint32_t hash, char const *str) {
+    return str ? fnv1a(hash, str, strlen(str) + 1) : fnv1a(hash, "", 1);
+}
+
+// Add the modification time and size of a file to an FNV-1a hash.
+static uint32_t fnv1a_stat(uint32_t hash, char const *path) {
+    struct stat st;
+    if (stat(path, &st)) {
+        return fnv1a(hash, "", 1);
+    }
+    int64_t mtime = st.st_mtime;
+    int64_t size  = st.st_size;
+    hash          = fnv1a(hash, &mtime, sizeof(mtime));
+    return fnv1a(hash, &size, sizeof(size));
+}
+
+// Copy a string from the string table into the arena.
+static char *index_str(arena_t *arena, char const *strings, uint32_t off) {
+    return off == NO_STR ? NULL : arena_strdup(arena, strings + off);
+}
+
+// Add a string to the string table, or only measure it if `strings` is NULL.
+static uint32_t index_put_str(char *strings, uint32_t *size, char const *str) {
+    if (!str) {
+        return NO_STR;
+    }
+    uint32_t off = *size;
+    size_t   len = strlen(str) + 1;
+    if (strings) {
+        memcpy(strings + off, str, len);
+    }
+    *size += len;
+    return off;
+}
+
+
+
+// Compute the generation of the AppFS apps; changes whenever an app is installed, updated or removed.
+// Only uses the AppFS metadata that is cached in RAM, so this does not read flash.
+uint32_t app_index_appfs_gen() {
+    uint32_t       hash = 2166136261;
+    appfs_handle_t fd   = appfsNextEntry(APPFS_INVALID_FD);
+    while (fd != APPFS_INVALID_FD) {
+        char const *id;
+        char const *name;
+        uint16_t    version = 0;
+        int         size    = 0;
+        appfsEntryInfoExt(fd, &id, &name, &version, &size);
+        hash = fnv1a(hash, &fd, sizeof(fd));
+        hash = fnv1a_str(hash, id);
+        hash = fnv1a_str(hash, name);
+        hash = fnv1a(hash, &version, sizeof(version));
+        hash = fnv1a(hash, &size, sizeof(size));
+        fd   = appfsNextEntry(fd);
+    }
+    return hash;
+}
+
+// Compute the generation of the app directories in `root` from their names and modification times.
+// Only stats the directories and the files apps are detected by, so this does not read any files.
+uint32_t app_index_dir_gen(char const *root) {
+    uint32_t hash = 2166136261;
+    DIR     *dir  = opendir(root);
+    if (!dir) {
+        return hash;
+    }
+    hash = fnv1a_stat(hash, root);
+    // FAT doesn't update the modification time of directories when their contents change,
+    // so the files apps are detected by are checked as well.
+    char           path[APP_PATH_MAX];
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (ent->d_type != DT_DIR || ent->d_name[0] == '.') {
+            continue;
+        }
+        hash = fnv1a_str(hash, ent->d_name);
+        snprintf(path, sizeof(path), "%s/%s", root, ent->d_name);
+        hash = fnv1a_stat(hash, path);
+        snprintf(path, sizeof(path), "%s/%s/" APP_META_FILE, root, ent->d_name);
+        hash = fnv1a_stat(hash, path);
+        snprintf(path, sizeof(path), "%s/%s/" APP_MAIN_FILE, root, ent->d_name);
+        hash = fnv1a_stat(hash, path);
+    }
+    closedir(dir);
+    return hash;
+}
+
+// Load the app index; returns NULL if it is missing or corrupt.
+app_index_t *app_index_load() {
+    FILE *fd = fopen(INDEX_PATH, "rb");
+    if (!fd) {
+        return NULL;
+    }
+    index_header_t header;
+    if (fread(&header, sizeof(header), 1, fd) != 1 || header.magic != INDEX_MAGIC ||
+        header.version != INDEX_VERSION || header.entry_size != sizeof(index_entry_t)) {
+        ESP_LOGW(TAG, "Ignoring invalid app index");
+        fclose(fd);
+        return NULL;
+    } else if (header.count > INDEX_MAX_APPS || header.strings_size > INDEX_MAX_STRINGS) {
+        ESP_LOGW(TAG, "Ignoring oversized app index");
+        fclose(fd);
+        return NULL;
+    }
+
+    // Read the entries and string table at once.
+    size_t       entries_size = header.count * sizeof(index_entry_t);
+    size_t       size         = entries_size + header.strings_size;
+    app_index_t *index        = malloc(sizeof(app_index_t) + size);
+    if (!index) {
+        fclose(fd);
+        return NULL;
+    }
+    index->header  = header;
+    index->entries = (index_entry_t *)(index + 1);
+    index->strings = (char const *)index->entries + entries_size;
+    bool ok        = fread(index->entries, 1, size, fd) == size;
+    fclose(fd);
+
+    // The string table must be terminated so every string in it is.
+    if (ok && header.strings_size && index->strings[header.strings_size - 1]) {
+        ok = false;
+    }
+    for (uint32_t i = 0; ok && i < header.count; i++) {
+        index_entry_t const *ent    = &index->entries[i];
+        uint32_t const       offs[] = {ent->id, ent->name, ent->desc, ent->main_path, ent->icon_path};
+        for (size_t j = 0; j < sizeof(offs) / sizeof(offs[0]); j++) {
+            if (offs[j] != NO_STR && offs[j] >= header.strings_size) {
+                ok = false;
+            }
+        }
+        if (ent->id == NO_STR || ent->source >= APP_SOURCE_COUNT) {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Ignoring corrupt app index");
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+// Clean up a loaded app index.
+void app_index_free(app_index_t *index) {
+    free(index);
+}
+
+// Whether the index has the apps of `source` at generation `gen`.
+bool app_index_source_valid(app_index_t const *index, app_source_t source, uint32_t gen) {
+    return index && (index->header.sources & (1 << source)) && index->header.gen[source] == gen;
+}
+
+// Number of apps in the index.
+size_t app_index_len(app_index_t const *index) {
+    return index ? index->header.count : 0;
+}
+
+// Get a copy of app `i` of the index with its strings in `arena` if it is from `source`.
+bool app_index_get(app_index_t const *index, size_t i, app_source_t source, arena_t *arena, app_meta_t *out) {
+    index_entry_t const *ent = &index->entries[i];
+    if (ent->source != source) {
+        return false;
+    }
+    *out = (app_meta_t){
+        .source    = ent->source,
+        .type      = ent->type,
+        .id        = index_str(arena, index->strings, ent->id),
+        .name      = index_str(arena, index->strings, ent->name),
+        .desc      = index_str(arena, index->strings, ent->desc),
+        .main_path = index_str(arena, index->strings, ent->main_path),
+        .icon_path = index_str(arena, index->strings, ent->icon_path),
+        .appfs_fd  = ent->appfs_fd,
+    };
+    return true;
+}
+
+// Save `app_list` as the app index for source generations `gen`.
+// Sources are added in order while they fit within the limits `app_index_load` accepts; the rest are left out.
+// Doesn't write anything if `prev`, the index loaded before detection, already has the same sources and generations.
+bool app_index_save(app_index_t const *prev, uint32_t const gen[APP_SOURCE_COUNT]) {
+    // Measure the apps and string table per source; `app_list` is sorted by source.
+    uint32_t sources      = 0;
+    uint32_t count        = 0;
+    uint32_t strings_size = 0;
+    size_t   pos          = 0;
+    for (int source = 0; source < APP_SOURCE_COUNT; source++) {
+        size_t   start          = pos;
+        uint32_t source_strings = 0;
+        for (; pos < app_list_len && app_list[pos].source == source; pos++) {
+            index_put_str(NULL, &source_strings, app_list[pos].id);
+            index_put_str(NULL, &source_strings, app_list[pos].name);
+            index_put_str(NULL, &source_strings, app_list[pos].desc);
+            index_put_str(NULL, &source_strings, app_list[pos].main_path);
+            index_put_str(NULL, &source_strings, app_list[pos].icon_path);
+        }
+        if (count + (pos - start) > INDEX_MAX_APPS || strings_size + source_strings > INDEX_MAX_STRINGS) {
+            ESP_LOGW(TAG, "Too many apps to index source %d; it will be scanned every time", source);
+            continue;
+        }
+        sources      |= 1 << source;
+        count        += pos - start;
+        strings_size += source_strings;
+    }
+
+    bool changed = !prev || prev->header.sources != sources;
+    for (int source = 0; source < APP_SOURCE_COUNT; source++) {
+        changed |= (sources & (1 << source)) && !app_index_source_valid(prev, source, gen[source]);
+    }
+    if (!changed) {
+        ESP_LOGD(TAG, "App index is up to date");
+        return true;
+    }
+
+    // Build the whole file in memory so it is written at once.
+    index_header_t header = {
+        .magic        = INDEX_MAGIC,
+        .version      = INDEX_VERSION,
+        .entry_size   = sizeof(index_entry_t),
+        .sources      = sources,
+        .count        = count,
+        .strings_size = strings_size,
+    };
+    memcpy(header.gen, gen, sizeof(header.gen));
+    size_t entries_size = count * sizeof(index_entry_t);
+    size_t size         = sizeof(header) + entries_size + strings_size;
+    char  *buf          = malloc(size);
+    if (!buf) {
+        ESP_LOGE(TAG, "Out of memory");
+        return false;
+    }
+    memcpy(buf, &header, sizeof(header));
+    index_entry_t *entries = (index_entry_t *)(buf + sizeof(header));
+    char          *strings = buf + sizeof(header) + entries_size;
+    strings_size           = 0;
+    count                  = 0;
+    for (size_t i = 0; i < app_list_len; i++) {
+        if (!(sources & (1 << app_list[i].source))) {
+            continue;
+        }
+        entries[count++] = (index_entry_t){
+            .source    = app_list[i].source,
+            .type      = app_list[i].type,
+            .appfs_fd  = app_list[i].appfs_fd,
+            .id        = index_put_str(strings, &strings_size, app_list[i].id),
+            .name      = index_put_str(strings, &strings_size, app_list[i].name),
+            .desc      = index_put_str(strings, &strings_size, app_list[i].desc),
+            .main_path = index_put_str(strings, &strings_size, app_list[i].main_path),
+            .icon_path = index_put_str(strings, &strings_size, app_list[i].icon_path),
+        };
+    }
+
+    // Write to a temporary file first so a power loss can't leave a truncated index behind.
+    FILE *fd = fopen(INDEX_TMP_PATH, "wb");
+    if (!fd) {
+        ESP_LOGW(TAG, "Cannot write app index");
+        free(buf);
+        return false;
+    }
+    bool ok = fwrite(buf, 1, size, fd) == size;
+    ok      = !fclose(fd) && ok;
+    free(buf);
+    if (!ok) {
+        // Keep the old index; it is still valid for the sources that didn't change.
+        ESP_LOGW(TAG, "Cannot write app index");
+        unlink(INDEX_TMP_PATH);
+        return false;
+    }
+    // FAT can't rename over an existing file.
+    unlink(INDEX_PATH);
+    if (rename(INDEX_TMP_PATH, INDEX_PATH)) {
+        ESP_LOGW(TAG, "Cannot write app index");
+        unlink(INDEX_TMP_PATH);
+        return false;
+    }
+    ESP_LOGI(TAG, "Saved %" PRIu32 " apps to the index", count);
+    return true;
+}
@@ -0,0 +1,39 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "app.h"
+#include "arena.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Loaded app index.
+typedef struct app_index app_index_t;
+
+
+
+// Compute the generation of the AppFS apps; changes whenever an app is installed, updated or removed.
+// Only uses the AppFS metadata that is cached in RAM, so this does not read flash.
+uint32_t     app_index_appfs_gen();
+// Compute the generation of the app directories in `root` from their names and modification times.
+// Only stats the directories and the files apps are detected by, so this does not read any files.
+uint32_t     app_index_dir_gen(char const *root);
+// Load the app index; returns NULL if it is missing or corrupt.
+app_index_t *app_index_load();
+// Clean up a loaded app index.
+void         app_index_free(app_index_t *index);
+// Whether the index has the apps of `source` at generation `gen`.
+bool         app_index_source_valid(app_index_t const *index, app_source_t source, uint32_t gen);
+// Number of apps in the index.
+size_t       app_index_len(app_index_t const *index);
+// Get a copy of app `i` of the index with its strings in `arena` if it is from `source`.
+bool         app_index_get(app_index_t const *index, size_t i, app_source_t source, arena_t *arena, app_meta_t *out);
+// Save `app_list` as the app index for source generations `gen`.
+// Sources are added in order while they fit within the limits `app_index_load` accepts; the rest are left out.
+// Doesn't write anything if `prev`, the index loaded before detection, already has the same sources and generations.
+bool         app_index_save(app_index_t const *prev, uint32_t const gen[APP_SOURCE_COUNT]);
@@ -0,0 +1,131 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// Arena chunk.
+struct arena_chunk {
+    // Previously allocated chunk.
+    arena_chunk_t *next;
+    // Capacity of `data`.
+    size_t         cap;
+    // Number of bytes of `data` in use.
+    size_t         used;
+    // Chunk data.
+    _Alignas(max_align_t) char data[];
+};
+
+
+
+// Add a chunk with room for at least `min_size` bytes and copy the string being built into it.
+static bool arena_grow(arena_t *arena, size_t min_size) {
+    size_t cap = arena->chunk_size;
+    while (cap < min_size) {
+        cap *= 2;
+    }
+    arena_chunk_t *chunk = malloc(sizeof(arena_chunk_t) + cap);
+    if (!chunk) {
+        return false;
+    }
+    chunk->next = arena->head;
+    chunk->cap  = cap;
+    chunk->used = 0;
+    if (arena->str_len) {
+        // Move the partial string; its old copy is wasted until the next reset.
+        memcpy(chunk->data, arena->head->data + arena->head->used - arena->str_len, arena->str_len);
+        arena->head->used -= arena->str_len;
+        chunk->used        = arena->str_len;
+    }
+    arena->head = chunk;
+    return true;
+}
+
+
+
+// Allocate `size` bytes aligned to `align`, which must be a power of two; returns NULL if out of memory.
+void *arena_alloc(arena_t *arena, size_t size, size_t align) {
+    arena_chunk_t *chunk = arena->head;
+    size_t         off   = chunk ? (chunk->used + align - 1) & ~(align - 1) : 0;
+    if (!chunk || off > chunk->cap || size > chunk->cap - off) {
+        if (!arena_grow(arena, size + align)) {
+            return NULL;
+        }
+        chunk = arena->head;
+        off   = (chunk->used + align - 1) & ~(align - 1);
+    }
+    chunk->used = off + size;
+    return chunk->data + off;
+}
+
+// Copy a string into the arena; returns NULL if out of memory or if `str` is NULL.
+char *arena_strdup(arena_t *arena, char const *str) {
+    if (!str) {
+        return NULL;
+    }
+    size_t len = strlen(str) + 1;
+    char  *out = arena_alloc(arena, len, 1);
+    if (out) {
+        memcpy(out, str, len);
+    }
+    return out;
+}
+
+// Append a character to the string being built; returns false if out of memory.
+bool arena_putc(arena_t *arena, char c) {
+    arena_chunk_t *chunk = arena->head;
+    if (!chunk || chunk->used >= chunk->cap) {
+        if (!arena_grow(arena, arena->str_len * 2 + 1)) {
+            return false;
+        }
+        chunk = arena->head;
+    }
+    chunk->data[chunk->used++] = c;
+    arena->str_len++;
+    return true;
+}
+
+// Terminate the string being built and get it; returns NULL if out of memory.
+char *arena_str_end(arena_t *arena) {
+    if (!arena_putc(arena, 0)) {
+        arena_str_abort(arena);
+        return NULL;
+    }
+    char *str      = arena->head->data + arena->head->used - arena->str_len;
+    arena->str_len = 0;
+    return str;
+}
+
+// Discard the string being built.
+void arena_str_abort(arena_t *arena) {
+    if (arena->head) {
+        arena->head->used -= arena->str_len;
+    }
+    arena->str_len = 0;
+}
+
+// Free everything allocated from the arena; keeps the first chunk for reuse.
+void arena_reset(arena_t *arena) {
+    arena_chunk_t *chunk = arena->head;
+    while (chunk && chunk->next) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    if (chunk) {
+        chunk->used = 0;
+    }
+    arena->head    = chunk;
+    arena->str_len = 0;
+}
+
+// Free everything allocated from the arena, including the first chunk.
+void arena_free(arena_t *arena) {
+    arena_reset(arena);
+    free(arena->head);
+    arena->head = NULL;
+}
@@ -0,0 +1,44 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+// Arena chunk.
+typedef struct arena_chunk arena_chunk_t;
+
+// Arena allocator; everything allocated from it is freed at once by `arena_reset`.
+// Not thread-safe; every task should use its own arena.
+// Nothing else may be allocated from the arena while a string is being built with `arena_putc`.
+typedef struct {
+    // Most recently allocated chunk; allocations are made from this one.
+    arena_chunk_t *head;
+    // Minimum size of new chunks.
+    size_t         chunk_size;
+    // Length of the string being built with `arena_putc`.
+    size_t         str_len;
+} arena_t;
+
+// Initializer for an empty `arena_t` with a minimum chunk size of `chunk_size_`.
+#define ARENA_INIT(chunk_size_) {.head = NULL, .chunk_size = (chunk_size_), .str_len = 0}
+
+
+
+// Allocate `size` bytes aligned to `align`, which must be a power of two; returns NULL if out of memory.
+void *arena_alloc(arena_t *arena, size_t size, size_t align);
+// Copy a string into the arena; returns NULL if out of memory or if `str` is NULL.
+char *arena_strdup(arena_t *arena, char const *str);
+// Append a character to the string being built; returns false if out of memory.
+bool  arena_putc(arena_t *arena, char c);
+// Terminate the string being built and get it; returns NULL if out of memory.
+char *arena_str_end(arena_t *arena);
+// Discard the string being built.
+void  arena_str_abort(arena_t *arena);
+// Free everything allocated from the arena; keeps the first chunk for reuse.
+void  arena_reset(arena_t *arena);
+// Free everything allocated from the arena, including the first chunk.
+void  arena_free(arena_t *arena);
@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: MIT
+
+#include "ch32_update.h"
+
+#include "bsp/why2025_coproc.h"
+#include "ch32v203prog.h"
+#include "hardware/why2025.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <nvs.h>
+#include <sdkconfig.h>
+
+#if CONFIG_BSP_SUPPORT_WHY2025_COPROC
+
+static char const TAG[] = "ch32";
+
+// Number of attempts at reading the CH32 version.
+#define VERSION_ATTEMPTS      4
+// Delay before the first retry of reading the CH32 version; doubles with every retry.
+#define VERSION_RETRY_MS      10
+// Number of consecutive boots the version may fail to read before the CH32 is reprogrammed anyway.
+#define MAX_UNREADABLE_BOOTS  2
+// NVS namespace for the installed firmware information.
+#define NVS_NAMESPACE         "ch32"
+// NVS key of the CRC32 of the installed firmware.
+#define NVS_KEY_CRC           "fw_crc"
+// NVS key of the number of consecutive boots the version could not be read.
+#define NVS_KEY_UNREADABLE    "unreadable"
+
+
+
+extern uint8_t const ch32_firmware_start[] asm("_binary_ch32_firmware_bin_start");
+extern uint8_t const ch32_firmware_end[] asm("_binary_ch32_firmware_bin_end");
+
+
+
+// Read the CH32 version, retrying with exponential backoff on I²C errors.
+static esp_err_t read_version(uint16_t *version) {
+    esp_err_t res   = ESP_FAIL;
+    uint32_t  delay = VERSION_RETRY_MS;
+    for (int attempt = 0; attempt < VERSION_ATTEMPTS; attempt++) {
+        if (attempt) {
+            ESP_LOGW(TAG, "Unable to read CH32 version (%s), retrying in %" PRIu32 " ms", esp_err_to_name(res), delay);
+            vTaskDelay(pdMS_TO_TICKS(delay) ?: 1);
+            delay *= 2;
+        }
+        res = bsp_ch32_version(version);
+        if (res == ESP_OK) {
+            break;
+        }
+    }
+    return res;
+}
+
+// Program the bundled firmware into the CH32 and record its CRC32 once the CH32 reports the expected version.
+// Returns whether the new firmware is running.
+static bool program_firmware(nvs_handle_t nvs, uint32_t crc) {
+    size_t len = ch32_firmware_end - ch32_firmware_start;
+    ESP_LOGI(TAG, "Programming CH32 (%zu bytes)", len);
+
+    rvswd_handle_t handle = {
+        .swdio = 22,
+        .swclk = 23,
+    };
+    int64_t start   = esp_timer_get_time();
+    bool    success = ch32_program(&handle, ch32_firmware_start, len);
+    int64_t time    = esp_timer_get_time() - start;
+    if (!success) {
+        ESP_LOGE(TAG, "Programming CH32 failed");
+        return false;
+    }
+    ESP_LOGI(
+        TAG,
+        "Programming CH32 took %" PRId64 ".%03" PRId64 " s (%" PRId64 " bytes/s)",
+        time / 1000000,
+        time / 1000 % 1000,
+        time ? (int64_t)len * 1000000 / time : 0
+    );
+
+    // Only trust the new firmware once it answers; otherwise the next boot tries again.
+    uint16_t  version = 0xffff;
+    esp_err_t res     = read_version(&version);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Unable to read CH32 version after programming (%s)", esp_err_to_name(res));
+        return false;
+    } else if (version != BSP_CH32_VERSION) {
+        ESP_LOGE(
+            TAG,
+            "CH32 version 0x%04" PRIx16 " after programming (expected %04" PRIx16 ")",
+            version,
+            BSP_CH32_VERSION
+        );
+        return false;
+    }
+
+    if (nvs) {
+        nvs_set_u32(nvs, NVS_KEY_CRC, crc);
+        nvs_set_u8(nvs, NVS_KEY_UNREADABLE, 0);
+    }
+    return true;
+}
+
+
+
+// Check the CH32 firmware and reprogram it if it differs from the bundled image.
+// Restarts the ESP32-P4 after reprogramming; returns if no reprogramming was needed or it failed.
+void ch32_update_check() {
+    uint32_t crc = esp_rom_crc32_le(0, ch32_firmware_start, ch32_firmware_end - ch32_firmware_start);
+
+    // Information about the installed firmware; missing if it was programmed by something else.
+    nvs_handle_t nvs = 0;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Unable to open NVS; installed firmware unknown");
+        nvs = 0;
+    }
+    uint32_t installed_crc = 0;
+    uint8_t  unreadable    = 0;
+    bool     have_crc      = nvs && nvs_get_u32(nvs, NVS_KEY_CRC, &installed_crc) == ESP_OK;
+    if (nvs) {
+        nvs_get_u8(nvs, NVS_KEY_UNREADABLE, &unreadable);
+    }
+
+    int64_t   start   = esp_timer_get_time();
+    uint16_t  version = 0xffff;
+    esp_err_t res     = read_version(&version);
+    ESP_LOGD(TAG, "Reading CH32 version took %" PRId64 " us", esp_timer_get_time() - start);
+
+    bool reprogram;
+    if (res != ESP_OK) {
+        // Don't reflash for what may be a transient I²C error if the bundled firmware is already installed.
+        reprogram = !have_crc || installed_crc != crc || unreadable >= MAX_UNREADABLE_BOOTS;
+        ESP_LOGW(TAG, "Unable to read CH32 version (%s)", esp_err_to_name(res));
+        if (!reprogram) {
+            ESP_LOGW(TAG, "Bundled CH32 firmware already installed; not reprogramming");
+            nvs_set_u8(nvs, NVS_KEY_UNREADABLE, unreadable + 1);
+        }
+    } else if (version != BSP_CH32_VERSION) {
+        ESP_LOGI(
+            TAG,
+            "CH32 version 0x%04" PRIx16 " too %s (expected %04" PRIx16 ")",
+            version,
+            version < BSP_CH32_VERSION ? "old" : "new",
+            BSP_CH32_VERSION
+        );
+        reprogram = true;
+    } else if (have_crc && installed_crc != crc) {
+        ESP_LOGI(TAG, "CH32 version 0x%04" PRIx16 " but firmware CRC differs", version);
+        reprogram = true;
+    } else {
+        ESP_LOGI(TAG, "CH32 version 0x%04" PRIx16, version);
+        reprogram = false;
+        if (nvs && !have_crc) {
+            // Installed by something else, but with the right version; trust it.
+            nvs_set_u32(nvs, NVS_KEY_CRC, crc);
+        }
+        if (nvs && unreadable) {
+            nvs_set_u8(nvs, NVS_KEY_UNREADABLE, 0);
+        }
+    }
+
+    if (reprogram && program_firmware(nvs, crc)) {
+        if (nvs) {
+            nvs_commit(nvs);
+            nvs_close(nvs);
+        }
+        esp_restart();
+    }
+    if (nvs) {
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
+
+#endif
@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Check the CH32 firmware and reprogram it if it differs from the bundled image.
+// Restarts the ESP32-P4 after reprogramming; returns if no reprogramming was needed or it failed.
+void ch32_update_check();
@@ -0,0 +1,137 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "jobs.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static char const TAG[] = "jobs";
+
+
+
+// Run queue; jobs take turns in this order.
+static job_t *jobs_head;
+// Next job to run a step of; NULL to start at the head.
+static job_t *jobs_cursor;
+
+
+
+// Remove a job from the run queue; returns false if it wasn't in it.
+static bool job_unlink(job_t *job) {
+    job_t **link = &jobs_head;
+    while (*link && *link != job) {
+        link = &(*link)->next;
+    }
+    if (!*link) {
+        return false;
+    }
+    *link = job->next;
+    if (jobs_cursor == job) {
+        jobs_cursor = job->next;
+    }
+    job->next = NULL;
+    return true;
+}
+
+
+
+// Add a job to the run queue; the job must stay valid until it finishes or is cancelled.
+void job_start(job_t *job) {
+    if (job_running(job)) {
+        return;
+    }
+    job_t **link = &jobs_head;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    job->next = NULL;
+    *link     = job;
+    ESP_LOGD(TAG, "Started job %s", job->name);
+}
+
+// Remove a job from the run queue if it is running and call its done callback.
+void job_cancel(job_t *job) {
+    if (!job_unlink(job)) {
+        return;
+    }
+    ESP_LOGD(TAG, "Cancelled job %s", job->name);
+    if (job->done) {
+        job->done(job, true);
+    }
+}
+
+// Whether a job is in the run queue.
+bool job_running(job_t const *job) {
+    for (job_t const *cur = jobs_head; cur; cur = cur->next) {
+        if (cur == job) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether any jobs are in the run queue.
+bool jobs_pending() {
+    return jobs_head != NULL;
+}
+
+// Run job steps round-robin until `deadline` (in `esp_timer_get_time` microseconds) or until all jobs are waiting.
+// Always runs at least one step so jobs make progress even when frames are over budget.
+// Returns true if any job marked itself dirty, meaning the GUI needs to be redrawn.
+bool jobs_run(int64_t deadline) {
+    bool   dirty   = false;
+    // Number of jobs in a row that were waiting.
+    size_t waiting = 0;
+    while (jobs_head) {
+        job_t    *job = jobs_cursor ?: jobs_head;
+        jobs_cursor   = job->next;
+        job_res_t res = job->step(job);
+        if (res == JOB_DONE) {
+            job_unlink(job);
+            ESP_LOGD(TAG, "Finished job %s", job->name);
+            if (job->done) {
+                job->done(job, false);
+            }
+        }
+        dirty      |= job->dirty;
+        job->dirty  = false;
+        waiting     = res == JOB_WAIT ? waiting + 1 : 0;
+
+        size_t count = 0;
+        for (job_t const *cur = jobs_head; cur; cur = cur->next) {
+            count++;
+        }
+        if (waiting >= count || esp_timer_get_time() >= deadline) {
+            break;
+        }
+    }
+    return dirty;
+}
+
+// Describe the progress of the running jobs in at most `cap` bytes; returns false if there are no jobs.
+bool jobs_status(char *buf, size_t cap) {
+    if (!jobs_head) {
+        return false;
+    }
+    job_t const *job = jobs_head;
+    if (job->progress_max) {
+        snprintf(buf, cap, "%s %" PRIu32 "%%", job->name, job->progress * 100 / job->progress_max);
+    } else {
+        snprintf(buf, cap, "%s...", job->name);
+    }
+    size_t others = 0;
+    for (job_t const *cur = job->next; cur; cur = cur->next) {
+        others++;
+    }
+    if (others) {
+        size_t len = strlen(buf);
+        snprintf(buf + len, cap - len, " (+%zu)", others);
+    }
+    return true;
+}
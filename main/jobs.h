@@ -0,0 +1,66 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// Launcher background job.
+typedef struct job job_t;
+
+// Result of a job step.
+typedef enum {
+    // The job is finished.
+    JOB_DONE,
+    // The job did some work and has more to do.
+    JOB_MORE,
+    // The job has more to do but is waiting for something else; lets `jobs_run` end the slice early.
+    JOB_WAIT,
+} job_res_t;
+
+// Do a small, bounded amount of work without blocking.
+typedef job_res_t (*job_step_t)(job_t *job);
+// Called when a job finishes or is cancelled.
+typedef void (*job_done_t)(job_t *job, bool cancelled);
+
+// Launcher background job.
+// Jobs are resumable state machines that run on the launcher main loop in slices between frames.
+struct job {
+    // Job name, for logging.
+    char const *name;
+    // Step function.
+    job_step_t  step;
+    // Optional done callback.
+    job_done_t  done;
+    // Cookie for the step and done callbacks.
+    void       *cookie;
+    // Progress so far, in units of the job's choosing.
+    uint32_t    progress;
+    // Total amount of work, or 0 if unknown.
+    uint32_t    progress_max;
+    // Set by the step and done callbacks when they changed the GUI; cleared by `jobs_run`.
+    bool        dirty;
+    // Next job in the run queue.
+    job_t      *next;
+};
+
+
+
+// Add a job to the run queue; the job must stay valid until it finishes or is cancelled.
+void job_start(job_t *job);
+// Remove a job from the run queue if it is running and call its done callback.
+void job_cancel(job_t *job);
+// Whether a job is in the run queue.
+bool job_running(job_t const *job);
+// Whether any jobs are in the run queue.
+bool jobs_pending();
+// Run job steps round-robin until `deadline` (in `esp_timer_get_time` microseconds) or until all jobs are waiting.
+// Always runs at least one step so jobs make progress even when frames are over budget.
+// Returns true if any job marked itself dirty, meaning the GUI needs to be redrawn.
+bool jobs_run(int64_t deadline);
+// Describe the progress of the running jobs in at most `cap` bytes; returns false if there are no jobs.
+bool jobs_status(char *buf, size_t cap);
@@ -6,15 +6,18 @@
 #include "appfs.h"
 #include "arrays.h"
 #include "bsp.h"
-#include "bsp/why2025_coproc.h"
+#include "bsp_alloc_count.h"
 #include "bsp_device.h"
 #include "bsp_pax.h"
-#include "ch32v203prog.h"
+#include "ch32_update.h"
+#include "jobs.h"
 #include "menus/root.h"
 #include "pax_gfx.h"
 #include "pax_gui.h"
 
+#include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <esp_app_desc.h>
 #include <esp_err.h>
@@ -24,21 +27,42 @@
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <nvs_flash.h>
 #include <sys/stat.h>
 
 char const TAG[] = "main";
 
-#define MAX_MENU_DEPTH 16
-
+#define MAX_MENU_DEPTH  16
+#define MAX_EVENTS      16
+// Frame period while background jobs are running; jobs get what drawing and events leave of it.
+#define FRAME_PERIOD_US 33333
+
+#if CONFIG_BSP_ALLOC_COUNT
+// Start checking that the BSP doesn't allocate.
+#define ALLOC_CHECK_START()       bsp_alloc_count_start()
+// Warn if anything allocated since `ALLOC_CHECK_START`.
+#define ALLOC_CHECK_END(what)     alloc_check_end(what)
+// Start checking that the BSP's input tasks don't allocate.
+#define ALLOC_CHECK_INPUT_START() ((void)bsp_alloc_count_input())
+// Warn if the BSP's input tasks allocated since the last check.
+#define ALLOC_CHECK_INPUT(what)   alloc_check_input(what)
+#else
+#define ALLOC_CHECK_START()       ((void)0)
+#define ALLOC_CHECK_END(what)     ((void)0)
+#define ALLOC_CHECK_INPUT_START() ((void)0)
+#define ALLOC_CHECK_INPUT(what)   ((void)0)
+#endif
 
 
-extern uint8_t const ch32_firmware_start[] asm("_binary_ch32_firmware_bin_start");
-extern uint8_t const ch32_firmware_end[] asm("_binary_ch32_firmware_bin_end");
 
 // Current GUI root element.
 static pgui_elem_t *gui;
 // GUI top bar.
 static pgui_elem_t *top_bar;
+// GUI top bar background job status.
+static pgui_elem_t *top_status;
+// Text of `top_status`.
+static char         top_status_buf[48];
 // GUI bottom bar.
 static pgui_elem_t *bottom_bar;
 // Global framebuffer.
@@ -56,6 +80,24 @@ static bool         menu_change = true;
 
 
 
+#if CONFIG_BSP_ALLOC_COUNT
+// Warn if anything allocated since `bsp_alloc_count_start`; display updates and input events shouldn't.
+static void alloc_check_end(char const *what) {
+    uint32_t allocs = bsp_alloc_count_stop();
+    if (allocs) {
+        ESP_LOGW(TAG, "%s made %" PRIu32 " heap allocations", what, allocs);
+    }
+}
+
+// Warn if the BSP's input tasks allocated since the last check; they read input, run callbacks and repeat keys.
+static void alloc_check_input(char const *what) {
+    uint32_t allocs = bsp_alloc_count_input();
+    if (allocs) {
+        ESP_LOGW(TAG, "%s made %" PRIu32 " heap allocations", what, allocs);
+    }
+}
+#endif
+
 // Set current screen.
 static void menu_enable(menu_entry_t menu) {
     if (menu.hide_top) {
@@ -97,40 +139,52 @@ void menu_pop() {
     }
 }
 
+// Replace the current menu screen without closing it.
+void menu_replace(menu_entry_t menu) {
+    if (menu_stack_len) {
+        menu_stack[menu_stack_len - 1] = menu;
+    } else {
+        root_menu = menu;
+    }
+    menu_change = true;
+}
+
+// Run background jobs until the frame deadline and show their progress in the top bar.
+// Returns true if the jobs or their status text changed the GUI.
+static bool run_jobs(int64_t deadline) {
+    if (!jobs_pending()) {
+        return false;
+    }
+    bool dirty                          = jobs_run(deadline);
+    char status[sizeof(top_status_buf)] = "";
+    jobs_status(status, sizeof(status));
+    if (strcmp(status, top_status_buf)) {
+        strcpy(top_status_buf, status);
+        pgui_set_text(top_status, top_status_buf);
+        dirty = true;
+    }
+    // Block for a tick so lower-priority tasks, including the idle task, still get to run.
+    vTaskDelay(1);
+    return dirty;
+}
+
 
 
 void app_main(void) {
     esp_err_t res;
     bsp_preinit();
 
-#if CONFIG_BSP_SUPPORT_WHY2025_COPROC
-    // Read CH32 version.
-    uint16_t version = 0xffff;
-    res              = bsp_ch32_version(&version);
-    if (res) {
-        ESP_LOGW(TAG, "Unable to read CH32 version");
-    } else if (version != BSP_CH32_VERSION) {
-        ESP_LOGI(
-            TAG,
-            "CH32 version 0x%04" PRIx16 " too %s (expected %04" PRIx16 ")",
-            version,
-            version < BSP_CH32_VERSION ? "old" : "new",
-            BSP_CH32_VERSION
-        );
-    } else {
-        ESP_LOGI(TAG, "CH32 version 0x%04" PRIx16, version);
+    // Initialize NVS; erase it if it is full or was formatted by a newer version.
+    res = nvs_flash_init();
+    if (res == ESP_ERR_NVS_NO_FREE_PAGES || res == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_flash_erase());
+        res = nvs_flash_init();
     }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(res);
 
-    // Program the CH32 if there is a mismatch.
-    if (res || version != BSP_CH32_VERSION) {
-        ESP_LOGI(TAG, "Programming CH32");
-        rvswd_handle_t handle = {
-            .swdio = 22,
-            .swclk = 23,
-        };
-        ch32_program(&handle, ch32_firmware_start, ch32_firmware_end - ch32_firmware_start);
-        esp_restart();
-    }
+#if CONFIG_BSP_SUPPORT_WHY2025_COPROC
+    // Make sure the CH32 runs the bundled firmware.
+    ch32_update_check();
 #endif
 
     // Initialize the hardware.
@@ -176,7 +230,7 @@ void app_main(void) {
     pgui_set_row_growable(gui, 2, false);
     {
         // Create top bar.
-        top_bar = pgui_new_grid2(2, 1);
+        top_bar = pgui_new_grid2(3, 1);
         pgui_set_variant(top_bar, PGUI_VARIANT_PANEL);
         pgui_enable_flags(top_bar, PGUI_FLAG_NOBORDER | PGUI_FLAG_NOSEPARATOR | PGUI_FLAG_NOROUNDING);
         pgui_child_replace(gui, 0, top_bar);
@@ -187,10 +241,15 @@ void app_main(void) {
             pgui_set_halign(top_left, PAX_ALIGN_BEGIN);
             pgui_child_replace(top_bar, 0, top_left);
 
+            // Background job progress.
+            top_status = pgui_new_text(top_status_buf);
+            pgui_set_variant(top_status, PGUI_VARIANT_PANEL);
+            pgui_child_replace(top_bar, 1, top_status);
+
             pgui_elem_t *top_right = pgui_new_text("42%");
             pgui_set_variant(top_right, PGUI_VARIANT_PANEL);
             pgui_set_halign(top_right, PAX_ALIGN_END);
-            pgui_child_replace(top_bar, 1, top_right);
+            pgui_child_replace(top_bar, 2, top_right);
         }
 
         // Create bottom bar.
@@ -205,13 +264,21 @@ void app_main(void) {
     // Set up the menu screens.
     menu_root_init();
     menu_enable(root_menu);
+    ALLOC_CHECK_START();
     bsp_disp_backlight(1, 0, 255);
     bsp_input_backlight(1, 0, 127);
-
-    bool needs_draw   = true;
-    bool needs_redraw = false;
+    ALLOC_CHECK_END("LED update");
+
+    bool    needs_draw   = true;
+    bool    needs_redraw = false;
+    // Timestamp of the oldest input not yet shown on the display.
+    int64_t frame_input  = 0;
+    // Allocations while the BSP started up don't count.
+    ALLOC_CHECK_INPUT_START();
     while (true) {
-        bsp_event_t event;
+        bsp_event_t events[MAX_EVENTS];
+        size_t      events_len;
+        int64_t     frame_start = esp_timer_get_time();
         if (menu_change) {
             while (menu_stack_prev > menu_stack_len) {
                 menu_stack_prev--;
@@ -229,8 +296,13 @@ void app_main(void) {
             // Full re-draw required.
             pax_background(gfx, pgui_get_default_theme()->palette[PGUI_VARIANT_DEFAULT].bg_col);
             pgui_draw(gfx, gui, NULL);
+            bsp_latency_record(BSP_LATENCY_RENDER, frame_input);
+            bsp_latency_set_frame_input(frame_input);
+            frame_input = 0;
             ESP_LOGI(TAG, "Pre update");
+            ALLOC_CHECK_START();
             bsp_disp_update(1, 0, pax_buf_get_pixels(gfx));
+            ALLOC_CHECK_END("Display update");
             ESP_LOGI(TAG, "Post update");
             needs_draw   = false;
             needs_redraw = false;
@@ -238,33 +310,65 @@ void app_main(void) {
         } else if (needs_redraw) {
             // Partial re-draw required.
             pgui_redraw(gfx, gui, NULL);
+            bsp_latency_record(BSP_LATENCY_RENDER, frame_input);
+            bsp_latency_set_frame_input(frame_input);
+            frame_input = 0;
+            ALLOC_CHECK_START();
             bsp_disp_update(1, 0, pax_buf_get_pixels(gfx));
+            ALLOC_CHECK_END("Display update");
             needs_redraw = false;
         }
 
-        // Run all pending events.
-        uint64_t timeout = UINT64_MAX;
-        while (bsp_event_wait(&event, timeout)) {
-            // Convert BSP event to PGUI event.
-            pgui_event_t p_event = {
-                .type    = event.input.type,
-                .input   = event.input.nav_input,
-                .value   = event.input.text_input,
-                .modkeys = event.input.modkeys,
-            };
-            // Run event through GUI.
-            pgui_resp_t resp = pgui_event(pax_buf_get_dims(gfx), gui, NULL, p_event);
-            if (resp) {
-                // Mark as dirty.
-                if (resp == PGUI_RESP_CAPTURED_DIRTY) {
-                    needs_draw = true;
+        // Run all pending events; don't wait for them if background jobs need the rest of the frame.
+        // Only the delivery of events already queued is checked for allocations, not the blocking wait for new ones.
+        uint64_t timeout = jobs_pending() ? 0 : UINT64_MAX;
+        while (true) {
+            if (!timeout) {
+                ALLOC_CHECK_START();
+            }
+            events_len = bsp_event_wait_many(events, MAX_EVENTS, timeout);
+            if (!timeout) {
+                ALLOC_CHECK_END("Input event delivery");
+            }
+            if (!events_len) {
+                break;
+            }
+            // These events went through the BSP's input tasks before they got here.
+            ALLOC_CHECK_INPUT("Input handling in the BSP");
+            for (size_t i = 0; i < events_len; i++) {
+                if (events[i].type != BSP_EVENT_INPUT) {
+                    continue;
+                }
+                // Convert BSP event to PGUI event.
+                pgui_event_t p_event = {
+                    .type    = events[i].input.type,
+                    .input   = events[i].input.nav_input,
+                    .value   = events[i].input.text_input,
+                    .modkeys = events[i].input.modkeys,
+                };
+                // Run event through GUI.
+                pgui_resp_t resp = pgui_event(pax_buf_get_dims(gfx), gui, NULL, p_event);
+                bsp_latency_record(BSP_LATENCY_HANDLE, events[i].input.timestamp);
+                if (resp && !frame_input) {
+                    frame_input = events[i].input.timestamp;
+                }
+                if (resp) {
+                    // Mark as dirty.
+                    if (resp == PGUI_RESP_CAPTURED_DIRTY) {
+                        needs_draw = true;
+                    }
+                    needs_redraw = true;
+                } else if (p_event.input == PGUI_INPUT_BACK && p_event.type == PGUI_EVENT_TYPE_PRESS) {
+                    // Exit current screen and go back one level.
+                    menu_pop();
                 }
-                needs_redraw = true;
-            } else if (p_event.input == PGUI_INPUT_BACK && p_event.type == PGUI_EVENT_TYPE_PRESS) {
-                // Exit current screen and go back one level.
-                menu_pop();
             }
             timeout = 0;
         }
+
+        // Give background jobs the rest of the frame.
+        if (run_jobs(frame_start + FRAME_PERIOD_US)) {
+            needs_redraw = true;
+        }
     }
 }
@@ -29,3 +29,5 @@ void menu_set_root(menu_entry_t root);
 void menu_push(menu_entry_t menu);
 // Exit current menu screen.
 void menu_pop();
+// Replace the current menu screen without closing it.
+void menu_replace(menu_entry_t menu);
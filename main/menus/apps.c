@@ -4,38 +4,134 @@
 #include "menus/apps.h"
 
 #include "app.h"
+#include "jobs.h"
 #include "main.h"
 #include "pax_gui.h"
 
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 
-static pgui_elem_t *grid;
+
+// Menu root; holds `status` above a list of apps per source.
+static pgui_elem_t *root;
+// Detection progress text.
+static pgui_elem_t *status;
+// Text of `status`.
+static char         status_buf[48];
+// Whether the apps of each source are shown.
+static bool         shown[APP_SOURCE_COUNT];
+// App detection job.
+static job_t        detect_job;
 
 static void start_app_cb(pgui_elem_t *elem) {
-    app_start(pgui_get_userdata(elem));
+    // Apps of earlier sources may still be inserted before this one, so find it by its offset in its source.
+    uintptr_t    data   = (uintptr_t)pgui_get_userdata(elem);
+    app_source_t source = data % APP_SOURCE_COUNT;
+    size_t       index  = 0;
+    while (app_list[index].source != source) {
+        index++;
+    }
+    app_start(app_list + index + data / APP_SOURCE_COUNT);
 }
 
-void menu_apps_open() {
-    app_detect();
-    grid = pgui_new_grid2(1, app_list_len);
+// Show the apps of a source once it is done scanning; returns whether the menu changed.
+// Each source gets its own list, built once, so the lists shown so far and the selection in them stay as they are.
+static bool show_source(app_source_t source) {
+    if (shown[source] || !app_detect_source_done(source)) {
+        return false;
+    }
+    shown[source] = true;
+    size_t start  = 0;
+    while (start < app_list_len && app_list[start].source < source) {
+        start++;
+    }
+    size_t len = 0;
+    while (start + len < app_list_len && app_list[start + len].source == source) {
+        len++;
+    }
+    if (!len) {
+        return false;
+    }
+
+    pgui_elem_t *grid = pgui_new_grid2(1, len);
     pgui_enable_flags(grid, PGUI_FLAG_NOBACKGROUND | PGUI_FLAG_NOBORDER | PGUI_FLAG_NOSEPARATOR | PGUI_FLAG_NOPADDING);
-    pgui_set_pos2(grid, 200, 10);
-    for (size_t i = 0; i < app_list_len; i++) {
-        pgui_elem_t *button = pgui_new_button(NULL, start_app_cb);
+    for (size_t i = 0; i < len; i++) {
+        app_meta_t const *app    = &app_list[start + i];
+        pgui_elem_t      *button = pgui_new_button(NULL, start_app_cb);
         pgui_child_append(grid, button);
-        pgui_set_userdata(button, app_list + i);
+        pgui_set_userdata(button, (void *)(uintptr_t)(i * APP_SOURCE_COUNT + source));
         pgui_enable_flags(button, PGUI_FLAG_FIX_WIDTH | PGUI_FLAG_FIX_HEIGHT | PGUI_FLAG_NOPADDING);
         pgui_set_size2(button, 400, 38);
-        pgui_elem_t *name = pgui_new_text(app_list[i].name ?: app_list[i].id);
+        pgui_elem_t *name = pgui_new_text(app->name ?: app->id);
         pgui_child_append(button, name);
     }
+    pgui_child_replace(root, 1 + source, grid);
+    return true;
+}
+
+// Add the apps found so far to the list and show how many there are.
+static job_res_t detect_step(job_t *job) {
+    bool more    = app_detect_step();
+    bool changed = false;
+    for (app_source_t source = 0; source < APP_SOURCE_COUNT; source++) {
+        changed |= show_source(source);
+    }
+    if (changed) {
+        // Have the main loop lay out the new list; this happens at most once per source.
+        menu_replace((menu_entry_t){
+            .root     = root,
+            .on_close = (menu_close_t)menu_apps_close,
+        });
+    }
+    if (job->progress == app_list_len) {
+        return more ? JOB_WAIT : JOB_DONE;
+    }
+    job->progress = app_list_len;
+    job->dirty    = true;
+    snprintf(status_buf, sizeof(status_buf), "Scanning for apps... %zu found", app_list_len);
+    pgui_set_text(status, status_buf);
+    return more ? JOB_MORE : JOB_DONE;
+}
+
+// Replace the progress text with the number of apps once detection finishes.
+static void detect_done(job_t *job, bool cancelled) {
+    if (cancelled) {
+        return;
+    }
+    job->dirty = true;
+    snprintf(status_buf, sizeof(status_buf), "%zu apps found", app_list_len);
+    pgui_set_text(status, status_buf);
+}
+
+void menu_apps_open() {
+    // Show the menu right away and detect apps in the background.
+    root = pgui_new_grid2(1, 1 + APP_SOURCE_COUNT);
+    pgui_enable_flags(root, PGUI_FLAG_NOBACKGROUND | PGUI_FLAG_NOBORDER | PGUI_FLAG_NOSEPARATOR | PGUI_FLAG_NOPADDING);
+    pgui_set_pos2(root, 200, 10);
+    pgui_set_row_growable(root, 0, false);
+    snprintf(status_buf, sizeof(status_buf), "Scanning for apps...");
+    status = pgui_new_text(status_buf);
+    pgui_child_replace(root, 0, status);
+    memset(shown, 0, sizeof(shown));
+    detect_job = (job_t){
+        .name = "Scanning apps",
+        .step = detect_step,
+        .done = detect_done,
+    };
+    app_detect_start();
+    job_start(&detect_job);
     menu_push((menu_entry_t){
-        .root     = grid,
+        .root     = root,
         .on_close = (menu_close_t)menu_apps_close,
     });
 }
 
 void menu_apps_close() {
-    pgui_delete_recursive(grid);
+    job_cancel(&detect_job);
+    pgui_delete_recursive(root);
+    root   = NULL;
+    status = NULL;
     app_list_clear();
 }
@@ -0,0 +1,311 @@
+
+// SPDX-License-Identifier: MIT
+
+#include "meta_json.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+static char const TAG[] = "meta_json";
+
+
+
+// Size of the read buffer; the file is parsed as it is read, so this is all of it that is in memory at once.
+#define READ_BUF_SIZE 256
+// Maximum nesting depth of JSON values.
+#define MAX_DEPTH     16
+// Size of the buffer for object keys; longer keys never match a field.
+#define KEY_BUF_SIZE  16
+
+// Streaming JSON reader.
+typedef struct {
+    // File being parsed.
+    FILE   *fd;
+    // Read position in `buf`.
+    size_t  pos;
+    // Number of valid bytes in `buf`.
+    size_t  len;
+    // Read buffer.
+    char    buf[READ_BUF_SIZE];
+} reader_t;
+
+// Destination of a JSON string.
+typedef struct {
+    // Arena to build the string in, or NULL.
+    arena_t *arena;
+    // Buffer to store the string in if `arena` is NULL, or NULL to discard it.
+    char    *buf;
+    // Capacity of `buf`.
+    size_t   cap;
+    // Length of the string; `cap` if it didn't fit in `buf`.
+    size_t   len;
+} sink_t;
+
+// `meta.json` field and where it is stored.
+typedef struct {
+    // JSON key.
+    char const *key;
+    // Offset of the `char *` field in `app_meta_t`.
+    size_t      offset;
+} field_t;
+
+// `meta.json` fields stored in the app metadata; other fields are skipped.
+static field_t const fields[] = {
+    {"name", offsetof(app_meta_t, name)},
+    {"desc", offsetof(app_meta_t, desc)},
+    {"main", offsetof(app_meta_t, main_path)},
+    {"icon", offsetof(app_meta_t, icon_path)},
+};
+
+
+
+// Get the next character without consuming it; returns EOF at the end of the file.
+static int peek(reader_t *rd) {
+    if (rd->pos >= rd->len) {
+        rd->pos = 0;
+        rd->len = fread(rd->buf, 1, sizeof(rd->buf), rd->fd);
+        if (!rd->len) {
+            return EOF;
+        }
+    }
+    return (uint8_t)rd->buf[rd->pos];
+}
+
+// Consume the next character; returns EOF at the end of the file.
+static int next(reader_t *rd) {
+    int c = peek(rd);
+    if (c != EOF) {
+        rd->pos++;
+    }
+    return c;
+}
+
+// Skip whitespace and peek the next character.
+static int skip_ws(reader_t *rd) {
+    int c;
+    while ((c = peek(rd)) == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        rd->pos++;
+    }
+    return c;
+}
+
+// Skip whitespace and consume `expected`; returns false if it is another character.
+static bool expect(reader_t *rd, char expected) {
+    skip_ws(rd);
+    return next(rd) == expected;
+}
+
+// Add a character to a string sink; returns false if out of memory.
+static bool sink_putc(sink_t *sink, char c) {
+    if (sink->arena) {
+        return arena_putc(sink->arena, c);
+    } else if (sink->buf && sink->len < sink->cap - 1) {
+        sink->buf[sink->len++] = c;
+        sink->buf[sink->len]   = 0;
+    } else if (sink->buf) {
+        // Doesn't fit; make sure it doesn't compare equal to anything.
+        sink->len = sink->cap;
+    }
+    return true;
+}
+
+// Add a code point to a string sink as UTF-8; returns false if out of memory.
+static bool sink_put_utf8(sink_t *sink, uint32_t cp) {
+    if (cp < 0x80) {
+        return sink_putc(sink, cp);
+    } else if (cp < 0x800) {
+        return sink_putc(sink, 0xc0 | (cp >> 6)) && sink_putc(sink, 0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        return sink_putc(sink, 0xe0 | (cp >> 12)) && sink_putc(sink, 0x80 | ((cp >> 6) & 0x3f)) &&
+               sink_putc(sink, 0x80 | (cp & 0x3f));
+    } else {
+        return sink_putc(sink, 0xf0 | (cp >> 18)) && sink_putc(sink, 0x80 | ((cp >> 12) & 0x3f)) &&
+               sink_putc(sink, 0x80 | ((cp >> 6) & 0x3f)) && sink_putc(sink, 0x80 | (cp & 0x3f));
+    }
+}
+
+// Read the 4 hex digits of a `\u` escape; returns -1 if they are invalid.
+static int32_t read_hex4(reader_t *rd) {
+    int32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = next(rd);
+        if (c >= '0' && c <= '9') {
+            value = value * 16 + c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value = value * 16 + c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value = value * 16 + c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+// Parse a `\u` escape after the `u`, including the second half of a surrogate pair.
+static bool parse_unicode_escape(reader_t *rd, sink_t *sink) {
+    int32_t cp = read_hex4(rd);
+    if (cp < 0) {
+        return false;
+    } else if (cp >= 0xd800 && cp < 0xdc00) {
+        if (next(rd) != '\\' || next(rd) != 'u') {
+            return false;
+        }
+        int32_t low = read_hex4(rd);
+        if (low < 0xdc00 || low >= 0xe000) {
+            return false;
+        }
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+    } else if (cp >= 0xdc00 && cp < 0xe000) {
+        return false;
+    }
+    return sink_put_utf8(sink, cp);
+}
+
+// Parse a string after its opening quote, unescaping it into `sink`.
+static bool parse_string(reader_t *rd, sink_t *sink) {
+    while (true) {
+        int c = next(rd);
+        if (c == '"') {
+            return true;
+        } else if (c == EOF || c < 0x20) {
+            return false;
+        } else if (c != '\\') {
+            if (!sink_putc(sink, c)) {
+                return false;
+            }
+            continue;
+        }
+        c = next(rd);
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/': break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u':
+                if (!parse_unicode_escape(rd, sink)) {
+                    return false;
+                }
+                continue;
+            default: return false;
+        }
+        if (!sink_putc(sink, c)) {
+            return false;
+        }
+    }
+}
+
+// Skip a value of any type.
+static bool skip_value(reader_t *rd, int depth) {
+    if (depth > MAX_DEPTH) {
+        return false;
+    }
+    int    c    = skip_ws(rd);
+    sink_t sink = {0};
+    if (c == '"') {
+        rd->pos++;
+        return parse_string(rd, &sink);
+
+    } else if (c == '{' || c == '[') {
+        rd->pos++;
+        char close = c == '{' ? '}' : ']';
+        if (skip_ws(rd) == close) {
+            rd->pos++;
+            return true;
+        }
+        while (true) {
+            if (close == '}' && (!expect(rd, '"') || !parse_string(rd, &sink) || !expect(rd, ':'))) {
+                return false;
+            }
+            if (!skip_value(rd, depth + 1)) {
+                return false;
+            }
+            c = (skip_ws(rd), next(rd));
+            if (c == close) {
+                return true;
+            } else if (c != ',') {
+                return false;
+            }
+        }
+
+    } else {
+        // Number, `true`, `false` or `null`; these aren't used, so they are only checked loosely.
+        size_t len = 0;
+        while ((c = peek(rd)) == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+               c == 'E') {
+            rd->pos++;
+            len++;
+        }
+        return len > 0;
+    }
+}
+
+// Find the app metadata field for a key; returns NULL if it isn't stored.
+static char **find_field(app_meta_t *meta, char const *key) {
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (!strcmp(fields[i].key, key)) {
+            return (char **)((char *)meta + fields[i].offset);
+        }
+    }
+    return NULL;
+}
+
+// Parse the top-level object of `meta.json`.
+static bool parse_meta(reader_t *rd, arena_t *arena, app_meta_t *meta) {
+    if (!expect(rd, '{')) {
+        return false;
+    }
+    if (skip_ws(rd) == '}') {
+        rd->pos++;
+        return true;
+    }
+    while (true) {
+        char   key[KEY_BUF_SIZE] = "";
+        sink_t key_sink          = {.buf = key, .cap = sizeof(key)};
+        if (!expect(rd, '"') || !parse_string(rd, &key_sink) || !expect(rd, ':')) {
+            return false;
+        }
+        char **field = key_sink.len < sizeof(key) ? find_field(meta, key) : NULL;
+        if (field && skip_ws(rd) == '"') {
+            // Unescape straight into the arena.
+            rd->pos++;
+            sink_t sink = {.arena = arena};
+            if (!parse_string(rd, &sink)) {
+                arena_str_abort(arena);
+                return false;
+            }
+            *field = arena_str_end(arena);
+            if (!*field) {
+                return false;
+            }
+        } else if (!skip_value(rd, 1)) {
+            return false;
+        }
+        int c = (skip_ws(rd), next(rd));
+        if (c == '}') {
+            return true;
+        } else if (c != ',') {
+            return false;
+        }
+    }
+}
+
+
+
+// Parse an app's `meta.json`, storing the fields it has in `meta` and their strings in `arena`.
+// Fields the file doesn't have are left as they are.
+// Returns false if the file is not valid JSON or if out of memory.
+bool meta_json_parse(FILE *fd, arena_t *arena, app_meta_t *meta) {
+    reader_t rd = {.fd = fd};
+    if (!parse_meta(&rd, arena, meta) || skip_ws(&rd) != EOF) {
+        ESP_LOGW(TAG, "Invalid app metadata");
+        return false;
+    }
+    return true;
+}
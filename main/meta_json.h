@@ -0,0 +1,17 @@
+
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "app.h"
+#include "arena.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+
+
+// Parse an app's `meta.json`, storing the fields it has in `meta` and their strings in `arena`.
+// Fields the file doesn't have are left as they are.
+// Returns false if the file is not valid JSON or if out of memory.
+bool meta_json_parse(FILE *fd, arena_t *arena, app_meta_t *meta);
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: MIT
+
+// Host test for adding and removing BSP event callbacks while the event thread runs them.
+// Build and run from the repository root:
+//   B=components/badge-bsp; cc -std=gnu17 -O1 -g -Wall -fsanitize=address,undefined -pthread
+//      -Itools/bsp_event_host/include -I$B/pub_include -I$B/include tools/bsp_event_host/callback_test.c
+//      tools/bsp_event_host/freertos_host.c $B/src/bsp_event.c $B/src/bsp_pool.c $B/src/bsp_latency.c
+//      $B/src/bsp_alloc_count.c -o callback_test
+//   ./callback_test
+
+#include "bsp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+// Number of callbacks the churn thread adds per event type; enough to use up every callback list.
+#define CHURN_PER_TYPE 3
+// Number of event types including `BSP_EVENT_ANY`.
+#define CHURN_TYPES    (BSP_EVENT_TYPE_COUNT + 1)
+
+// Initialize the event queues.
+void bsp_event_queue_init();
+
+// Whether the slow callback is running.
+static atomic_bool     running;
+// Whether the slow callback returned.
+static atomic_bool     finished;
+// Whether the churn thread is done.
+static atomic_bool     churned;
+// Whether the slow callback had returned by the time the churn thread was done.
+static atomic_bool     churn_waited;
+// Callbacks added by the churn thread.
+static bsp_cb_handle_t churn_cbs[CHURN_TYPES][CHURN_PER_TYPE];
+
+
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                  \
+            exit(1);                                                                                                   \
+        }                                                                                                              \
+    } while (0)
+
+// Callback that does nothing.
+static void nop_cb(bsp_event_t const *event, void *cookie) {
+    (void)event;
+    (void)cookie;
+}
+
+// Queue an input event for the callbacks.
+static void send_event() {
+    bsp_event_t event = {.type = BSP_EVENT_INPUT, .input = {.type = BSP_INPUT_EVENT_HOLD}};
+    CHECK(bsp_event_queue(&event));
+}
+
+// Callback that takes its time, then adds and removes a callback itself.
+static void slow_cb(bsp_event_t const *event, void *cookie) {
+    (void)event;
+    (void)cookie;
+    atomic_store(&running, true);
+    vTaskDelay(50);
+    // Meanwhile, the churn thread used up every callback list; this can't wait for them to be reusable.
+    bsp_cb_handle_t cb = bsp_event_add_callback(BSP_EVENT_ANY, nop_cb, NULL);
+    if (cb) {
+        CHECK(bsp_event_remove_callback(cb));
+    }
+    atomic_store(&finished, true);
+    atomic_store(&running, false);
+}
+
+// Add callbacks while the slow callback runs; the lists they replace can't be reused until it returns.
+static void *churn_thread(void *ignored) {
+    (void)ignored;
+    for (int type = 0; type < CHURN_TYPES; type++) {
+        for (int i = 0; i < CHURN_PER_TYPE; i++) {
+            churn_cbs[type][i] = bsp_event_add_callback(type + BSP_EVENT_ANY, nop_cb, NULL);
+            CHECK(churn_cbs[type][i]);
+        }
+    }
+    atomic_store(&churn_waited, atomic_load(&finished));
+    atomic_store(&churned, true);
+    return NULL;
+}
+
+// A callback adding a callback while another task waits for free callback lists must not deadlock.
+static void test_add_in_callback() {
+    atomic_store(&finished, false);
+    bsp_cb_handle_t cb = bsp_event_add_callback(BSP_EVENT_INPUT, slow_cb, NULL);
+    CHECK(cb);
+    send_event();
+    while (!atomic_load(&running)) {
+        vTaskDelay(1);
+    }
+    pthread_t churn;
+    CHECK(pthread_create(&churn, NULL, churn_thread, NULL) == 0);
+    for (int i = 0; i < 5000 && !atomic_load(&churned); i++) {
+        vTaskDelay(1);
+    }
+    CHECK(atomic_load(&churned));
+    pthread_join(churn, NULL);
+    CHECK(atomic_load(&finished));
+    // The churn thread ran out of callback lists and had to wait for the slow callback.
+    CHECK(atomic_load(&churn_waited));
+    for (int type = 0; type < CHURN_TYPES; type++) {
+        for (int i = 0; i < CHURN_PER_TYPE; i++) {
+            CHECK(bsp_event_remove_callback(churn_cbs[type][i]));
+        }
+    }
+    CHECK(bsp_event_remove_callback(cb));
+    printf("add in callback: no deadlock with every callback list in use\n");
+}
+
+// Removing a callback while it runs must wait for it to return.
+static void test_remove_waits() {
+    atomic_store(&finished, false);
+    bsp_cb_handle_t cb = bsp_event_add_callback(BSP_EVENT_INPUT, slow_cb, NULL);
+    CHECK(cb);
+    send_event();
+    while (!atomic_load(&running)) {
+        vTaskDelay(1);
+    }
+    CHECK(bsp_event_remove_callback(cb));
+    CHECK(atomic_load(&finished));
+    CHECK(!bsp_event_remove_callback(cb));
+    printf("remove waits: callback finished before removal returned\n");
+}
+
+int main() {
+    bsp_event_queue_init();
+    test_add_in_callback();
+    test_remove_waits();
+    printf("All tests passed\n");
+    return 0;
+}
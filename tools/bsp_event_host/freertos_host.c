@@ -0,0 +1,231 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for the parts of FreeRTOS and ESP-IDF the BSP event queue uses, implemented on POSIX threads.
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+
+// Task: a thread with a notification counter.
+struct host_task {
+    pthread_t       thread;
+    TaskFunction_t  func;
+    void           *arg;
+    pthread_mutex_t mtx;
+    pthread_cond_t  cond;
+    uint32_t        notify;
+};
+
+// Semaphore; mutexes are binary semaphores that start out given.
+struct host_sem {
+    pthread_mutex_t mtx;
+    pthread_cond_t  cond;
+    uint32_t        count;
+};
+
+// Lock shared by all critical sections; they don't nest in the code built on the host.
+static pthread_mutex_t critical_mtx = PTHREAD_MUTEX_INITIALIZER;
+// Task of the current thread; created on demand for threads not started with `xTaskCreate`.
+static _Thread_local struct host_task *current_task;
+// Key that frees the tasks created for threads not started with `xTaskCreate`.
+static pthread_key_t                   adopted_key;
+static pthread_once_t                  adopted_once = PTHREAD_ONCE_INIT;
+
+
+
+// Get monotonic time in microseconds.
+int64_t esp_timer_get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void host_enter_critical() {
+    pthread_mutex_lock(&critical_mtx);
+}
+
+void host_exit_critical() {
+    pthread_mutex_unlock(&critical_mtx);
+}
+
+// Wait on a condition variable until `deadline`, or indefinitely if it is NULL; returns false on timeout.
+static bool cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *mtx, struct timespec const *deadline) {
+    if (!deadline) {
+        pthread_cond_wait(cond, mtx);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, mtx, deadline) != ETIMEDOUT;
+}
+
+// Compute the deadline `ticks` from now, or NULL for `portMAX_DELAY`.
+static struct timespec *deadline_of(TickType_t ticks, struct timespec *buf) {
+    if (ticks == portMAX_DELAY) {
+        return NULL;
+    }
+    clock_gettime(CLOCK_REALTIME, buf);
+    buf->tv_sec  += ticks / 1000;
+    buf->tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (buf->tv_nsec >= 1000000000) {
+        buf->tv_sec++;
+        buf->tv_nsec -= 1000000000;
+    }
+    return buf;
+}
+
+static struct host_task *task_new() {
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    pthread_mutex_init(&task->mtx, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    return task;
+}
+
+static void *task_main(void *arg) {
+    current_task = arg;
+    current_task->func(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(
+    TaskFunction_t func, char const *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle_out
+) {
+    (void)name;
+    (void)stack;
+    (void)prio;
+    struct host_task *task = task_new();
+    task->func             = func;
+    task->arg              = arg;
+    if (handle_out) {
+        *handle_out = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_main, task)) {
+        return pdFALSE;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+// Free the task created for a thread not started with `xTaskCreate` when it exits.
+static void task_adopted_free(void *task) {
+    free(task);
+}
+
+// Create the key that frees the tasks of threads not started with `xTaskCreate`.
+static void task_adopted_init() {
+    pthread_key_create(&adopted_key, task_adopted_free);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (!current_task) {
+        current_task = task_new();
+        pthread_once(&adopted_once, task_adopted_init);
+        pthread_setspecific(adopted_key, current_task);
+    }
+    return current_task;
+}
+
+TickType_t xTaskGetTickCount() {
+    return esp_timer_get_time() / 1000;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {.tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->mtx);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->mtx);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+    xTaskNotifyGive(task);
+    *woken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec   buf;
+    struct timespec  *deadline = deadline_of(ticks, &buf);
+    pthread_mutex_lock(&task->mtx);
+    while (!task->notify && cond_wait_ticks(&task->cond, &task->mtx, deadline));
+    uint32_t value = task->notify;
+    if (value) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->mtx);
+    return value;
+}
+
+void vTaskSetTimeOutState(TimeOut_t *timeout) {
+    timeout->start = xTaskGetTickCount();
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticks) {
+    if (*ticks == portMAX_DELAY) {
+        return pdFALSE;
+    }
+    TickType_t now     = xTaskGetTickCount();
+    TickType_t elapsed = now - timeout->start;
+    if (elapsed >= *ticks) {
+        *ticks = 0;
+        return pdTRUE;
+    }
+    *ticks         -= elapsed;
+    timeout->start  = now;
+    return pdFALSE;
+}
+
+static struct host_sem *sem_new(uint32_t count) {
+    struct host_sem *sem = calloc(1, sizeof(struct host_sem));
+    pthread_mutex_init(&sem->mtx, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = count;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return sem_new(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return sem_new(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    struct timespec  buf;
+    struct timespec *deadline = deadline_of(ticks, &buf);
+    pthread_mutex_lock(&sem->mtx);
+    while (!sem->count && ticks && cond_wait_ticks(&sem->cond, &sem->mtx, deadline));
+    BaseType_t res = sem->count ? pdTRUE : pdFALSE;
+    if (res) {
+        sem->count = 0;
+    }
+    pthread_mutex_unlock(&sem->mtx);
+    return res;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    pthread_mutex_lock(&sem->mtx);
+    BaseType_t res = sem->count ? pdFALSE : pdTRUE;
+    sem->count     = 1;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mtx);
+    return res;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken) {
+    *woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for ESP-IDF's placement attributes.
+
+#pragma once
+
+#include "sdkconfig.h"
+
+#define IRAM_ATTR
@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for ESP-IDF's heap capabilities; the BSP only uses them in heap hooks, which host builds leave out.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
@@ -0,0 +1,14 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for ESP-IDF's logging.
+
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGV(tag, fmt, ...) ((void)(tag))
@@ -0,0 +1,10 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for ESP-IDF's high resolution timer.
+
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time();
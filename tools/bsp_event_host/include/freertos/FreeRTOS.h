@@ -0,0 +1,43 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for the parts of FreeRTOS the BSP event queue uses, implemented on POSIX threads.
+// Ticks are milliseconds; there are no interrupts, so `xPortInIsrContext` is always false.
+
+#pragma once
+
+#include "sdkconfig.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      pdTRUE
+#define portMAX_DELAY               UINT32_MAX
+#define configTICK_RATE_HZ          1000
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(ms))
+#define pdTICKS_TO_MS(ticks)        ((uint32_t)(ticks))
+#define tskIDLE_PRIORITY            0
+#define portYIELD_FROM_ISR(woken)   ((void)(woken))
+
+// Spinlock; all critical sections share one lock on the host.
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void       host_enter_critical();
+void       host_exit_critical();
+#define taskENTER_CRITICAL(mux)      ((void)(mux), host_enter_critical())
+#define taskEXIT_CRITICAL(mux)       ((void)(mux), host_exit_critical())
+#define taskENTER_CRITICAL_SAFE(mux) taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_SAFE(mux)  taskEXIT_CRITICAL(mux)
+
+static inline BaseType_t xPortInIsrContext() {
+    return pdFALSE;
+}
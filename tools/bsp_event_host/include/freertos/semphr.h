@@ -0,0 +1,16 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for FreeRTOS semaphores; see `FreeRTOS.h`.
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t        xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken);
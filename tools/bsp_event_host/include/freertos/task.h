@@ -0,0 +1,28 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for FreeRTOS tasks; see `FreeRTOS.h`.
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// Timeout state for `xTaskCheckForTimeOut`.
+typedef struct {
+    TickType_t start;
+} TimeOut_t;
+
+BaseType_t   xTaskCreate(
+    TaskFunction_t func, char const *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle_out
+);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void         vTaskDelay(TickType_t ticks);
+BaseType_t   xTaskNotifyGive(TaskHandle_t task);
+void         vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+uint32_t     ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void         vTaskSetTimeOutState(TimeOut_t *timeout);
+BaseType_t   xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticks);
+TickType_t   xTaskGetTickCount();
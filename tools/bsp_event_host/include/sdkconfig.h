@@ -0,0 +1,14 @@
+
+// SPDX-License-Identifier: MIT
+
+// BSP event queue configuration for host builds; the defaults from the BSP's Kconfig.
+
+#pragma once
+
+#define CONFIG_BSP_EVENT_TASK_PRIORITY        10
+#define CONFIG_BSP_EVENT_QUEUE_DEPTH          32
+#define CONFIG_BSP_EVENT_OVERFLOW_DROP_OLDEST 1
+#define CONFIG_BSP_EVENT_BLOCK_TIMEOUT_MS     20
+#define CONFIG_BSP_EVENT_CALLBACK_MAX         8
+#define CONFIG_BSP_EVENT_RECORD_BUF_LEN       256
+#define CONFIG_BSP_EVENT_RECORD_WAIT_MS       100
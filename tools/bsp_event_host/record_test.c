@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: MIT
+
+// Host test for recording BSP events to a file and replaying them: recordings must not lose events, and must fail
+// instead of being incomplete.
+// Build and run from the repository root:
+//   B=components/badge-bsp; cc -std=gnu17 -O1 -g -Wall -fsanitize=address,undefined -pthread
+//      -Itools/bsp_event_host/include -I$B/pub_include -I$B/include tools/bsp_event_host/record_test.c
+//      tools/bsp_event_host/freertos_host.c $B/src/bsp_event.c $B/src/bsp_pool.c $B/src/bsp_latency.c
+//      $B/src/bsp_alloc_count.c $B/src/bsp_event_record.c -o record_test
+//   ./record_test
+
+#include "bsp.h"
+#include "bsp_event_record.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+// Number of events sent while recording.
+#define RECORD_COUNT 1000
+// Number of events sent while the recording file is stuck; more than fit in a pipe and the record buffer.
+#define STUCK_COUNT  5000
+
+// Initialize the event queues.
+void bsp_event_queue_init();
+
+// Whether the consumer should keep reading.
+static atomic_bool consuming;
+// Number of events the consumer read.
+static atomic_int  consumed;
+// Whether the consumer read the events in the order they were sent.
+static atomic_bool consumed_in_order;
+
+
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                  \
+            exit(1);                                                                                                   \
+        }                                                                                                              \
+    } while (0)
+
+// Read events like an app would; they are numbered by `raw_input`.
+static void *consumer_thread(void *ignored) {
+    (void)ignored;
+    bsp_event_t events[16];
+    while (atomic_load(&consuming)) {
+        size_t len = bsp_event_wait_many(events, 16, 10);
+        for (size_t i = 0; i < len; i++) {
+            int index = atomic_fetch_add(&consumed, 1);
+            if (events[i].input.raw_input != index) {
+                atomic_store(&consumed_in_order, false);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Start reading events.
+static pthread_t consumer_start() {
+    atomic_store(&consumed, 0);
+    atomic_store(&consumed_in_order, true);
+    atomic_store(&consuming, true);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, consumer_thread, NULL) == 0);
+    return thread;
+}
+
+// Wait for the consumer to read `count` events, then stop it.
+static void consumer_stop(pthread_t thread, int count) {
+    for (int i = 0; i < 5000 && atomic_load(&consumed) < count; i++) {
+        vTaskDelay(1);
+    }
+    atomic_store(&consuming, false);
+    pthread_join(thread, NULL);
+}
+
+// Send `count` numbered events, waiting for space so the event queue itself doesn't lose any.
+static void send_events(int count) {
+    for (int i = 0; i < count; i++) {
+        bsp_event_t event = {.type = BSP_EVENT_INPUT, .input = {.type = BSP_INPUT_EVENT_HOLD, .raw_input = i}};
+        CHECK(bsp_event_queue_wait(&event, 5000));
+    }
+}
+
+// Every event sent while recording must be in the recording, and a replay must deliver them all in order.
+static void test_record_replay(char const *path) {
+    pthread_t consumer = consumer_start();
+    CHECK(bsp_event_record_start(path));
+    send_events(RECORD_COUNT);
+    consumer_stop(consumer, RECORD_COUNT);
+    CHECK(atomic_load(&consumed) == RECORD_COUNT);
+    CHECK(bsp_event_record_stop());
+
+    consumer = consumer_start();
+    CHECK(bsp_event_replay(path, BSP_REPLAY_SPEED_MAX));
+    consumer_stop(consumer, RECORD_COUNT);
+    CHECK(atomic_load(&consumed) == RECORD_COUNT);
+    CHECK(atomic_load(&consumed_in_order));
+    printf("record and replay: %d of %d events replayed in order\n", atomic_load(&consumed), RECORD_COUNT);
+}
+
+// Open the reading end of a pipe, but don't read until told to.
+static void *stuck_reader(void *arg) {
+    char const *path = arg;
+    int         fd   = open(path, O_RDONLY);
+    CHECK(fd >= 0);
+    while (atomic_load(&consuming)) {
+        vTaskDelay(1);
+    }
+    char buf[4096];
+    while (read(fd, buf, sizeof(buf)) > 0);
+    close(fd);
+    return NULL;
+}
+
+// A recording that can't keep up must fail and not leave an incomplete file behind.
+static void test_record_stuck(char const *path) {
+    CHECK(mkfifo(path, 0600) == 0);
+    pthread_t consumer = consumer_start();
+    pthread_t reader;
+    CHECK(pthread_create(&reader, NULL, stuck_reader, (void *)path) == 0);
+    CHECK(bsp_event_record_start(path));
+    send_events(STUCK_COUNT);
+    // The event queue was held up, but nothing the consumer reads is lost.
+    consumer_stop(consumer, STUCK_COUNT);
+    CHECK(atomic_load(&consumed) == STUCK_COUNT);
+    CHECK(atomic_load(&consumed_in_order));
+    CHECK(!bsp_event_record_stop());
+    pthread_join(reader, NULL);
+    CHECK(access(path, F_OK) != 0);
+    printf("stuck recording: failed and removed\n");
+}
+
+int main() {
+    bsp_event_queue_init();
+    char dir[] = "/tmp/bsp_record_test.XXXXXX";
+    CHECK(mkdtemp(dir));
+    char path[64];
+    snprintf(path, sizeof(path), "%s/record.bin", dir);
+    test_record_replay(path);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/stuck.bin", dir);
+    test_record_stuck(path);
+    rmdir(dir);
+    printf("All tests passed\n");
+    return 0;
+}
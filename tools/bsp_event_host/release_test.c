@@ -0,0 +1,260 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host test for the BSP event queue's overflow handling: key releases must never be lost, so keys can't get stuck.
+// Build and run from the repository root:
+//   B=components/badge-bsp; cc -std=gnu17 -O1 -g -Wall -fsanitize=address,undefined -pthread
+//      -Itools/bsp_event_host/include -I$B/pub_include -I$B/include tools/bsp_event_host/release_test.c
+//      tools/bsp_event_host/freertos_host.c $B/src/bsp_event.c $B/src/bsp_pool.c $B/src/bsp_latency.c
+//      $B/src/bsp_alloc_count.c -o release_test
+//   ./release_test
+
+#include "bsp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// Number of keys used by the stress test.
+#define KEYS         16
+// Number of key events sent by the stress test.
+#define STRESS_COUNT 200000
+
+// Initialize the event queues.
+void bsp_event_queue_init();
+
+// Whether the event thread should wait in `gate_cb`.
+static atomic_bool     gate_closed;
+// Number of events the stress callback saw per key state change.
+static int             cb_pressed[KEYS];
+// Maximum time the stress callback stalls the event thread for, in microseconds; 0 to not stall.
+static atomic_int      stall_us;
+// Whether the stress consumer should keep reading.
+static atomic_bool     consuming;
+// Keys the stress consumer saw pressed.
+static int             consumer_seen[KEYS];
+
+
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                  \
+            exit(1);                                                                                                   \
+        }                                                                                                              \
+    } while (0)
+
+// Make a key event.
+static bsp_event_t key_event(int key, bsp_input_event_type_t type) {
+    return (bsp_event_t){
+        .type  = BSP_EVENT_INPUT,
+        .input = {
+            .type      = type,
+            .raw_input = key,
+        },
+    };
+}
+
+// Callback that holds up the event thread while `gate_closed` is set, so events pile up undispatched.
+static void gate_cb(bsp_event_t const *event, void *cookie) {
+    (void)event;
+    (void)cookie;
+    while (atomic_load(&gate_closed)) {
+        vTaskDelay(1);
+    }
+}
+
+// Callback that tracks key state as the callbacks see it and stalls the event thread at random.
+static void stress_cb(bsp_event_t const *event, void *cookie) {
+    (void)cookie;
+    int key = event->input.raw_input;
+    if (event->input.type == BSP_INPUT_EVENT_PRESS) {
+        CHECK(!cb_pressed[key]);
+        cb_pressed[key] = 1;
+    } else if (event->input.type == BSP_INPUT_EVENT_RELEASE) {
+        cb_pressed[key] = 0;
+    }
+    int stall = atomic_load(&stall_us);
+    if (stall && rand() % 64 == 0) {
+        struct timespec ts = {.tv_nsec = (rand() % stall) * 1000L};
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Track which keys a consumer sees pressed.
+static void track_keys(int *seen, bsp_event_t const *events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int key = events[i].input.raw_input;
+        if (events[i].input.type == BSP_INPUT_EVENT_PRESS) {
+            seen[key] = 1;
+        } else if (events[i].input.type == BSP_INPUT_EVENT_RELEASE) {
+            seen[key] = 0;
+        }
+    }
+}
+
+// Read all events from the queue; returns how many there were.
+static size_t drain(int *seen) {
+    size_t      total = 0;
+    bsp_event_t events[8];
+    size_t      count;
+    while ((count = bsp_event_wait_many(events, 8, 50))) {
+        track_keys(seen, events, count);
+        total += count;
+    }
+    return total;
+}
+
+// Fill the queue with undispatched presses, then check that their releases still fit.
+static void test_reserve() {
+    bsp_event_stats_t stats;
+    int               seen[CONFIG_BSP_EVENT_QUEUE_DEPTH] = {0};
+    bsp_event_reset_stats();
+    atomic_store(&gate_closed, true);
+    bsp_cb_handle_t cb = bsp_event_add_callback(BSP_EVENT_INPUT, gate_cb, NULL);
+    CHECK(cb);
+
+    // Each press keeps space for its release, so presses stop fitting when the queue is half full.
+    size_t presses = 0;
+    while (1) {
+        bsp_event_t event = key_event(presses, BSP_INPUT_EVENT_PRESS);
+        if (!bsp_event_queue(&event)) {
+            break;
+        }
+        presses++;
+    }
+    CHECK(presses == CONFIG_BSP_EVENT_QUEUE_DEPTH / 2);
+    // Neither do other events.
+    bsp_event_t event = key_event(0, BSP_INPUT_EVENT_HOLD);
+    CHECK(!bsp_event_queue(&event));
+    // The releases of the pressed keys all fit.
+    for (size_t key = 0; key < presses; key++) {
+        event = key_event(key, BSP_INPUT_EVENT_RELEASE);
+        CHECK(bsp_event_queue(&event));
+    }
+    // A release of a key never pressed has no space kept for it.
+    event = key_event(presses + 1, BSP_INPUT_EVENT_RELEASE);
+    CHECK(!bsp_event_queue(&event));
+    atomic_store(&gate_closed, false);
+
+    CHECK(drain(seen) == 2 * presses);
+    for (size_t key = 0; key < presses; key++) {
+        CHECK(!seen[key]);
+    }
+    bsp_event_get_stats(&stats);
+    CHECK(stats.lost_releases == 0);
+    CHECK(bsp_event_remove_callback(cb));
+    printf("reserve: %zu presses fit, their releases all delivered\n", presses);
+}
+
+// Fill the queue with dispatched events that no consumer reads, then check that dropping the oldest event to make
+// space never drops a release.
+static void test_drop_oldest() {
+    bsp_event_stats_t stats;
+    int               seen[3 * CONFIG_BSP_EVENT_QUEUE_DEPTH / 8] = {0};
+    bsp_event_reset_stats();
+    bsp_event_set_overflow(BSP_EVENT_OVERFLOW_DROP_OLDEST);
+    // Each key is pressed, repeats a few times and is released.
+    for (int i = 0; i < 3 * CONFIG_BSP_EVENT_QUEUE_DEPTH; i++) {
+        bsp_input_event_type_t type = i % 8 == 0 ? BSP_INPUT_EVENT_PRESS
+                                    : i % 8 == 7 ? BSP_INPUT_EVENT_RELEASE
+                                                 : BSP_INPUT_EVENT_HOLD;
+        bsp_event_t            event = key_event(i / 8, type);
+        bsp_event_queue(&event);
+        // Let the event thread dispatch everything so it can be dropped.
+        vTaskDelay(1);
+    }
+    bsp_event_get_stats(&stats);
+    CHECK(stats.dropped > 0);
+    CHECK(stats.lost_releases == 0);
+    drain(seen);
+    for (size_t key = 0; key < sizeof(seen) / sizeof(*seen); key++) {
+        CHECK(!seen[key]);
+    }
+    printf("drop oldest: no keys stuck, %u events dropped\n", (unsigned)stats.dropped);
+}
+
+// Stress test consumer: reads in bursts now and then, like a UI that is busy drawing.
+static void *stress_consumer(void *ignored) {
+    (void)ignored;
+    while (atomic_load(&consuming)) {
+        bsp_event_t events[8];
+        track_keys(consumer_seen, events, bsp_event_wait_many(events, 8, 0));
+        struct timespec ts = {.tv_nsec = (rand() % 100) * 1000L};
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+// Producer and consumer threads racing with a lagging event thread, under each overflow policy.
+// Every key a consumer saw pressed must be released in the end.
+static void test_stress(bsp_event_overflow_t policy, char const *name) {
+    bsp_event_stats_t stats;
+    bsp_event_reset_stats();
+    bsp_event_set_overflow(policy);
+    memset(cb_pressed, 0, sizeof(cb_pressed));
+    atomic_store(&stall_us, 200);
+    bsp_cb_handle_t cb = bsp_event_add_callback(BSP_EVENT_INPUT, stress_cb, NULL);
+    CHECK(cb);
+
+    pthread_t consumer;
+    memset(consumer_seen, 0, sizeof(consumer_seen));
+    atomic_store(&consuming, true);
+    CHECK(pthread_create(&consumer, NULL, stress_consumer, NULL) == 0);
+
+    int    pressed[KEYS] = {0};
+    size_t sent          = 0;
+    srand(1);
+    while (sent < STRESS_COUNT) {
+        int         key  = rand() % KEYS;
+        bsp_event_t event = key_event(key, pressed[key] ? (rand() % 2 ? BSP_INPUT_EVENT_HOLD : BSP_INPUT_EVENT_RELEASE)
+                                                        : BSP_INPUT_EVENT_PRESS);
+        pressed[key]      = event.input.type != BSP_INPUT_EVENT_RELEASE;
+        bsp_event_queue(&event);
+        sent++;
+    }
+    for (int key = 0; key < KEYS; key++) {
+        if (pressed[key]) {
+            bsp_event_t event = key_event(key, BSP_INPUT_EVENT_RELEASE);
+            bsp_event_queue(&event);
+        }
+    }
+    atomic_store(&stall_us, 0);
+    atomic_store(&consuming, false);
+    pthread_join(consumer, NULL);
+    drain(consumer_seen);
+    for (int key = 0; key < KEYS; key++) {
+        CHECK(!consumer_seen[key]);
+        CHECK(!cb_pressed[key]);
+    }
+    bsp_event_get_stats(&stats);
+    CHECK(stats.lost_releases == 0);
+    CHECK(bsp_event_remove_callback(cb));
+    printf(
+        "stress %s: enqueued %u, dropped %u, coalesced %u, blocked %u, lost releases %u\n",
+        name,
+        (unsigned)stats.enqueued,
+        (unsigned)stats.dropped,
+        (unsigned)stats.coalesced,
+        (unsigned)stats.blocked,
+        (unsigned)stats.lost_releases
+    );
+}
+
+int main() {
+    bsp_event_queue_init();
+    test_reserve();
+    test_drop_oldest();
+    test_stress(BSP_EVENT_OVERFLOW_DROP_OLDEST, "drop oldest");
+    test_stress(BSP_EVENT_OVERFLOW_DROP_NEWEST, "drop newest");
+    test_stress(BSP_EVENT_OVERFLOW_COALESCE, "coalesce");
+    test_stress(BSP_EVENT_OVERFLOW_BLOCK, "block");
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,8 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host stand-in for the PAX graphics header; `app.h` only needs the buffer type.
+
+#pragma once
+
+typedef struct pax_buf pax_buf_t;
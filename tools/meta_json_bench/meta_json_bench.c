@@ -0,0 +1,168 @@
+
+// SPDX-License-Identifier: MIT
+
+// Host benchmark and sanitizer check for the launcher's `meta.json` parser and string arenas.
+// Build and run from the repository root:
+//   cc -std=gnu17 -O2 -g -Wall -fsanitize=address,undefined -Itools/meta_json_bench/include -Imain
+//      tools/meta_json_bench/meta_json_bench.c main/meta_json.c main/arena.c -o meta_json_bench
+//   ./meta_json_bench [apps] [rounds]
+// Drop `-fsanitize` to get representative timings.
+
+#include "app.h"
+#include "arena.h"
+#include "meta_json.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+// Default number of synthetic apps per round.
+#define DEFAULT_APPS   5000
+// Default number of scan rounds.
+#define DEFAULT_ROUNDS 10
+// Chunk size of the string arena, as used by the launcher.
+#define CHUNK_SIZE     1024
+
+// Malformed files; the parser must reject these without reading out of bounds.
+static char const *const bad_json[] = {
+    "",
+    "{",
+    "{\"name\":",
+    "{\"name\":\"x\"",
+    "{\"name\":\"x\"} junk",
+    "{\"name\":\"\\uZZZZ\"}",
+    "{\"name\":\"\\ud800\"}",
+    "{\"x\":[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]}",
+    "[1]",
+    "{\"name\" \"x\"}",
+    "{\"name\":\"x\",}",
+};
+
+
+
+// Current time in nanoseconds.
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Write the `meta.json` of synthetic app `i` to `buf`; returns its length.
+static size_t make_json(char *buf, size_t cap, size_t i) {
+    int len = snprintf(
+        buf,
+        cap,
+        "{\n"
+        "    \"type\": \"AppFS2\",\n"
+        "    \"name\": \"Synthetic app %zu \\u00e9\\ud83d\\ude00\",\n"
+        "    \"desc\": \"Benchmark app number %zu with a description of typical length\",\n"
+        "    \"main\": \"bin/app%zu.elf\",\n"
+        "    \"icon\": \"icon.png\",\n"
+        "    \"version\": [1, 2, %zu],\n"
+        "    \"extra\": {\"nested\": [true, false, null, -1.5e3], \"long_unknown_key_name\": \"ignored\"}\n"
+        "}\n",
+        i,
+        i,
+        i,
+        i
+    );
+    return (size_t)len < cap ? (size_t)len : cap - 1;
+}
+
+// Parse `len` bytes of `json` into `meta`.
+static bool parse(char const *json, size_t len, arena_t *arena, app_meta_t *meta) {
+    // `fmemopen` can't open an empty buffer, so empty files are read from an empty read-only stream instead.
+    FILE *fd = len ? fmemopen((void *)json, len, "rb") : fopen("/dev/null", "rb");
+    if (!fd) {
+        perror("fmemopen");
+        exit(1);
+    }
+    bool ok = meta_json_parse(fd, arena, meta);
+    fclose(fd);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t apps   = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_APPS;
+    size_t rounds = argc > 2 ? strtoul(argv[2], NULL, 0) : DEFAULT_ROUNDS;
+    if (!apps || !rounds) {
+        fprintf(stderr, "Usage: %s [apps] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    // Generate the files up front so only parsing is timed.
+    size_t  stride = 512;
+    char   *files  = malloc(apps * stride);
+    size_t *lens   = malloc(apps * sizeof(size_t));
+    if (!files || !lens) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < apps; i++) {
+        lens[i]      = make_json(files + i * stride, stride, i);
+        total_bytes += lens[i];
+    }
+
+    arena_t     arena = ARENA_INIT(CHUNK_SIZE);
+    app_meta_t *list  = malloc(apps * sizeof(app_meta_t));
+    if (!list) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    uint64_t best = UINT64_MAX;
+    for (size_t round = 0; round < rounds; round++) {
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < apps; i++) {
+            list[i] = (app_meta_t){0};
+            if (!parse(files + i * stride, lens[i], &arena, &list[i])) {
+                fprintf(stderr, "App %zu failed to parse\n", i);
+                return 1;
+            }
+        }
+        uint64_t time = now_ns() - start;
+        if (time < best) {
+            best = time;
+        }
+
+        // Check the parsed fields, then free them all at once like `app_list_clear` does.
+        for (size_t i = 0; i < apps; i++) {
+            char expect[64];
+            snprintf(expect, sizeof(expect), "bin/app%zu.elf", i);
+            if (!list[i].name || !list[i].desc || !list[i].icon_path || !list[i].main_path ||
+                strcmp(list[i].main_path, expect) || strcmp(list[i].icon_path, "icon.png")) {
+                fprintf(stderr, "App %zu parsed wrong\n", i);
+                return 1;
+            }
+        }
+        arena_reset(&arena);
+    }
+
+    for (size_t i = 0; i < sizeof(bad_json) / sizeof(bad_json[0]); i++) {
+        app_meta_t meta = {0};
+        if (parse(bad_json[i], strlen(bad_json[i]), &arena, &meta)) {
+            fprintf(stderr, "Malformed file %zu was accepted\n", i);
+            return 1;
+        }
+        arena_reset(&arena);
+    }
+
+    printf(
+        "%zu apps, %zu bytes: best of %zu rounds %.3f ms, %.0f ns per app, %.1f MB/s\n",
+        apps,
+        total_bytes,
+        rounds,
+        best / 1e6,
+        (double)best / apps,
+        total_bytes * 1e3 / best
+    );
+    arena_free(&arena);
+    free(list);
+    free(lens);
+    free(files);
+    return 0;
+}